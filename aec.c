@@ -0,0 +1,257 @@
+/* aec.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "aec.h"
+#include "fft.h"
+
+#define AEC_DEFAULT_STEP   0.5f
+#define AEC_POWER_SMOOTH   0.9f    /* reference power estimate per bin */
+#define AEC_ERLE_SMOOTH    0.98f
+#define AEC_GEIGEL         0.5f    /* near end louder than this * far end is double talk */
+#define AEC_REG            1e3f    /* regularisation, in S16 units squared */
+
+struct aec {
+    unsigned int n;             /* block size */
+    unsigned int bins;          /* n + 1 complex bins of the 2n point FFT */
+    unsigned int partitions;
+    float step;
+    struct fft *fft;
+
+    float *xbuf;                /* previous and current reference block, 2n */
+    float *xhist;               /* partitions reference spectra, newest at xhead */
+    unsigned int xhead;
+    float *w;                   /* partitions filter spectra */
+    float *power;               /* bins */
+    float *spec;                /* scratch spectrum, 2n + 2 */
+    float *time;                /* scratch time domain, 2n */
+    float *ref_max;             /* peak |ref| of the last partitions blocks */
+    unsigned int constrain;     /* next partition to constrain */
+
+    float mic_energy;
+    float err_energy;
+    struct aec_stats stats;
+    unsigned long long cpu_us;
+};
+
+static unsigned long long aec_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct aec *aec_init(unsigned int block_size, unsigned int partitions,
+                     float step)
+{
+    struct aec *aec;
+    unsigned int spec_len;
+
+    if (!partitions)
+        return NULL;
+
+    aec = calloc(1, sizeof(*aec));
+    if (!aec)
+        return NULL;
+
+    aec->fft = fft_init(2 * block_size);
+    if (!aec->fft) {
+        free(aec);
+        return NULL;
+    }
+
+    aec->n = block_size;
+    aec->bins = block_size + 1;
+    aec->partitions = partitions;
+    aec->step = step > 0 ? step : AEC_DEFAULT_STEP;
+    spec_len = 2 * aec->bins;
+
+    aec->xbuf = calloc(2 * block_size, sizeof(float));
+    aec->xhist = calloc(partitions * spec_len, sizeof(float));
+    aec->w = calloc(partitions * spec_len, sizeof(float));
+    aec->power = calloc(aec->bins, sizeof(float));
+    aec->spec = calloc(spec_len, sizeof(float));
+    aec->time = calloc(2 * block_size, sizeof(float));
+    aec->ref_max = calloc(partitions, sizeof(float));
+    if (!aec->xbuf || !aec->xhist || !aec->w || !aec->power || !aec->spec ||
+        !aec->time || !aec->ref_max) {
+        aec_free(aec);
+        return NULL;
+    }
+
+    return aec;
+}
+
+void aec_free(struct aec *aec)
+{
+    if (!aec)
+        return;
+
+    fft_free(aec->fft);
+    free(aec->xbuf);
+    free(aec->xhist);
+    free(aec->w);
+    free(aec->power);
+    free(aec->spec);
+    free(aec->time);
+    free(aec->ref_max);
+    free(aec);
+}
+
+unsigned int aec_get_block_size(struct aec *aec)
+{
+    return aec->n;
+}
+
+/* Constrain one partition to a linear (not circular) convolution: back to the
+ * time domain, drop the second half of the taps, forward again. Doing one
+ * partition per block keeps the cost at a single FFT pair. */
+static void aec_constrain(struct aec *aec, float *w)
+{
+    unsigned int n = aec->n;
+
+    memcpy(aec->spec, w, 2 * aec->bins * sizeof(float));
+    fft_inverse(aec->fft, aec->spec, aec->time);
+    memset(aec->time + n, 0, n * sizeof(float));
+    fft_forward(aec->fft, aec->time, w);
+}
+
+void aec_process(struct aec *aec, const int16_t *mic, const int16_t *ref,
+                 int16_t *out)
+{
+    unsigned int n = aec->n, bins = aec->bins, spec_len = 2 * bins;
+    unsigned int p, k, i;
+    unsigned long long start = aec_cpu_ns(), elapsed;
+    float *x, *y = aec->spec, *e = aec->time;
+    float mic_max = 0, ref_max = 0, mic_energy = 0, err_energy = 0;
+    int double_talk;
+
+    /* newest reference block spectrum goes to the head of the history */
+    aec->xhead = (aec->xhead + aec->partitions - 1) % aec->partitions;
+    aec->ref_max[aec->xhead] = 0;
+    memmove(aec->xbuf, aec->xbuf + n, n * sizeof(float));
+    for (i = 0; i < n; i++) {
+        aec->xbuf[n + i] = ref[i];
+        if (abs(ref[i]) > aec->ref_max[aec->xhead])
+            aec->ref_max[aec->xhead] = abs(ref[i]);
+    }
+    x = aec->xhist + aec->xhead * spec_len;
+    fft_forward(aec->fft, aec->xbuf, x);
+
+    for (k = 0; k < bins; k++)
+        aec->power[k] = AEC_POWER_SMOOTH * aec->power[k] + (1 - AEC_POWER_SMOOTH) *
+            (x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1]);
+
+    /* echo estimate: Y = sum over partitions of W[p] * X[k - p] */
+    memset(y, 0, spec_len * sizeof(float));
+    for (p = 0; p < aec->partitions; p++) {
+        const float *xp = aec->xhist + ((aec->xhead + p) % aec->partitions) * spec_len;
+        const float *wp = aec->w + p * spec_len;
+        for (k = 0; k < bins; k++) {
+            y[2 * k] += wp[2 * k] * xp[2 * k] - wp[2 * k + 1] * xp[2 * k + 1];
+            y[2 * k + 1] += wp[2 * k] * xp[2 * k + 1] + wp[2 * k + 1] * xp[2 * k];
+        }
+    }
+    fft_inverse(aec->fft, y, e);
+
+    /* error = mic - last n samples of the estimate; e[0..n) becomes the
+     * zero padded error block for the update */
+    for (i = 0; i < n; i++) {
+        float d = mic[i];
+        float err = d - e[n + i];
+        int s = lrintf(err);
+
+        if (abs(mic[i]) > mic_max)
+            mic_max = abs(mic[i]);
+        mic_energy += d * d;
+        err_energy += err * err;
+
+        if (s > INT16_MAX)
+            s = INT16_MAX;
+        else if (s < INT16_MIN)
+            s = INT16_MIN;
+        out[i] = s;
+
+        e[n + i] = err;
+        e[i] = 0;
+    }
+
+    for (p = 0; p < aec->partitions; p++)
+        if (aec->ref_max[p] > ref_max)
+            ref_max = aec->ref_max[p];
+    double_talk = mic_max > AEC_GEIGEL * ref_max;
+
+    if (!double_talk && ref_max > 0) {
+        float *err = aec->spec;
+
+        fft_forward(aec->fft, e, err);
+        for (k = 0; k < bins; k++) {
+            float mu = aec->step / (aec->partitions * aec->power[k] + AEC_REG);
+            err[2 * k] *= mu;
+            err[2 * k + 1] *= mu;
+        }
+        /* W[p] += mu * conj(X[k - p]) * E */
+        for (p = 0; p < aec->partitions; p++) {
+            const float *xp = aec->xhist + ((aec->xhead + p) % aec->partitions) * spec_len;
+            float *wp = aec->w + p * spec_len;
+            for (k = 0; k < bins; k++) {
+                wp[2 * k] += xp[2 * k] * err[2 * k] + xp[2 * k + 1] * err[2 * k + 1];
+                wp[2 * k + 1] += xp[2 * k] * err[2 * k + 1] - xp[2 * k + 1] * err[2 * k];
+            }
+        }
+        aec_constrain(aec, aec->w + aec->constrain * spec_len);
+        aec->constrain = (aec->constrain + 1) % aec->partitions;
+    }
+
+    /* ERLE only means something while the far end is talking */
+    if (ref_max > 0 && !double_talk) {
+        aec->mic_energy = AEC_ERLE_SMOOTH * aec->mic_energy + mic_energy;
+        aec->err_energy = AEC_ERLE_SMOOTH * aec->err_energy + err_energy;
+        if (aec->err_energy > 0)
+            aec->stats.erle_db = 10 * log10f(aec->mic_energy / aec->err_energy);
+    }
+
+    elapsed = (aec_cpu_ns() - start) / 1000;
+    aec->cpu_us += elapsed;
+    aec->stats.blocks++;
+    if (elapsed > aec->stats.cpu_us_max)
+        aec->stats.cpu_us_max = elapsed;
+}
+
+void aec_get_stats(struct aec *aec, struct aec_stats *stats)
+{
+    *stats = aec->stats;
+    if (aec->stats.blocks)
+        stats->cpu_us_avg = aec->cpu_us / aec->stats.blocks;
+}
@@ -0,0 +1,73 @@
+/* aec.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef AEC_H
+#define AEC_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Acoustic echo canceller.
+ *
+ * Partitioned block frequency domain NLMS: the echo path is modelled by
+ * partitions filters of block_size taps each, updated in the frequency domain
+ * with overlap-save and 2 * block_size point FFTs. Adaptation freezes while
+ * near end speech dominates the reference (Geigel detector). Mono S16 only.
+ */
+
+struct aec;
+
+struct aec_stats {
+    float erle_db;              /* smoothed echo return loss enhancement */
+    unsigned int blocks;
+    unsigned int cpu_us_avg;    /* thread CPU time per aec_process() call */
+    unsigned int cpu_us_max;
+};
+
+/* step 0 picks the default */
+struct aec *aec_init(unsigned int block_size, unsigned int partitions,
+                     float step);
+void aec_free(struct aec *aec);
+unsigned int aec_get_block_size(struct aec *aec);
+
+/* Cancel one block: mic and ref are block_size samples of near end capture
+ * and of the time aligned far end reference. out may alias mic. */
+void aec_process(struct aec *aec, const int16_t *mic, const int16_t *ref,
+                 int16_t *out);
+
+void aec_get_stats(struct aec *aec, struct aec_stats *stats);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,329 @@
+/* archive.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <sys/eventfd.h>
+
+#include "archive.h"
+#include "wav.h"
+
+#define ARCHIVE_MAX_FRAMES  0x7fffffffU
+
+struct archive_file {
+    int fd;
+    unsigned int index;
+    uint32_t frames;
+    struct wav_rf64_header header;
+};
+
+struct archive {
+    char prefix[PATH_MAX];
+    unsigned int frame_bytes;
+    unsigned int limit;         /* frames per file */
+    unsigned int update;        /* frames between header rewrites */
+    unsigned int since_update;
+    unsigned int next_index;
+    struct wav_rf64_header header;
+
+    /* capture thread only */
+    struct archive_file cur;
+
+    /* handed over with the flags below; the background thread does its
+     * work on them under lock, which the capture thread only takes when
+     * it finds that work not done in time */
+    struct archive_file next;
+    struct archive_file retire;
+    volatile int next_ready;
+    volatile int retire_pending;
+    volatile int quit;
+    pthread_mutex_t lock;
+
+    int event;
+    pthread_t thread;
+};
+
+static int archive_write_header(struct archive_file *file)
+{
+    wav_rf64_set_frames(&file->header, file->frames);
+    if (pwrite(file->fd, &file->header, sizeof(file->header), 0) != sizeof(file->header))
+        return -errno;
+    return 0;
+}
+
+/* Create the next file and write it an empty, valid header; called with
+ * lock held */
+static int archive_prepare(struct archive *ar, struct archive_file *file)
+{
+    char name[PATH_MAX + 16];
+
+    file->index = ar->next_index;
+    file->frames = 0;
+    file->header = ar->header;
+    snprintf(name, sizeof(name), "%s-%04u.wav", ar->prefix, file->index);
+    file->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file->fd < 0) {
+        fprintf(stderr, "archive: unable to create '%s'\n", name);
+        return -errno;
+    }
+    if (archive_write_header(file) < 0 ||
+        lseek(file->fd, sizeof(file->header), SEEK_SET) < 0) {
+        fprintf(stderr, "archive: unable to write '%s'\n", name);
+        close(file->fd);
+        file->fd = -1;
+        return -EIO;
+    }
+    ar->next_index++;
+    return 0;
+}
+
+static void archive_finish(struct archive_file *file)
+{
+    if (archive_write_header(file) < 0)
+        fprintf(stderr, "archive: unable to finish file %u\n", file->index);
+    close(file->fd);
+    file->fd = -1;
+}
+
+static void *archive_thread(void *arg)
+{
+    struct archive *ar = arg;
+    struct pollfd pfd;
+    uint64_t count;
+
+    pfd.fd = ar->event;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        read(ar->event, &count, sizeof(count));
+
+        pthread_mutex_lock(&ar->lock);
+        if (ar->retire_pending) {
+            archive_finish(&ar->retire);
+            __sync_synchronize();
+            ar->retire_pending = 0;
+        }
+        if (!ar->next_ready && !ar->quit && archive_prepare(ar, &ar->next) == 0) {
+            __sync_synchronize();
+            ar->next_ready = 1;
+        }
+        pthread_mutex_unlock(&ar->lock);
+
+        if (ar->quit)
+            break;
+    }
+
+    return NULL;
+}
+
+static void archive_kick(struct archive *ar)
+{
+    uint64_t one = 1;
+
+    write(ar->event, &one, sizeof(one));
+}
+
+/* Switch to the pre-opened file and hand the full one to the background
+ * thread. Whatever it has not got round to is done here instead. */
+static int archive_rotate(struct archive *ar)
+{
+    int ret = 0;
+
+    if (!ar->next_ready || ar->retire_pending) {
+        pthread_mutex_lock(&ar->lock);
+        if (ar->retire_pending) {
+            archive_finish(&ar->retire);
+            ar->retire_pending = 0;
+        }
+        if (!ar->next_ready) {
+            fprintf(stderr, "archive: file %u was not ready in time\n", ar->next_index);
+            ret = archive_prepare(ar, &ar->next);
+            if (ret == 0)
+                ar->next_ready = 1;
+        }
+        pthread_mutex_unlock(&ar->lock);
+        if (ret < 0)
+            return ret;
+    }
+
+    __sync_synchronize();
+    ar->retire = ar->cur;
+    ar->cur = ar->next;
+    ar->since_update = 0;
+    __sync_synchronize();
+    ar->next_ready = 0;
+    ar->retire_pending = 1;
+    archive_kick(ar);
+    return 0;
+}
+
+int archive_write(struct archive *ar, const void *data, unsigned int frames)
+{
+    const uint8_t *src = data;
+    unsigned int n;
+    size_t bytes;
+    ssize_t ret;
+
+    while (frames) {
+        n = ar->limit - ar->cur.frames;
+        if (n > frames)
+            n = frames;
+
+        for (bytes = n * ar->frame_bytes; bytes; bytes -= ret, src += ret) {
+            ret = write(ar->cur.fd, src, bytes);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    ret = 0;
+                    continue;
+                }
+                return -errno;
+            }
+        }
+        ar->cur.frames += n;
+        frames -= n;
+
+        ar->since_update += n;
+        if (ar->since_update >= ar->update) {
+            ar->since_update = 0;
+            archive_write_header(&ar->cur);
+        }
+
+        if (ar->cur.frames == ar->limit) {
+            ret = archive_rotate(ar);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
+}
+
+struct archive *archive_open(const struct pcm_config *config, const char *prefix,
+                             unsigned int max_seconds, unsigned long long max_bytes)
+{
+    struct archive *ar;
+    sigset_t all, old;
+
+    if (!config || !prefix)
+        return NULL;
+
+    ar = calloc(1, sizeof(*ar));
+    if (!ar)
+        return NULL;
+
+    strncpy(ar->prefix, prefix, sizeof(ar->prefix) - 1);
+    wav_rf64_init(&ar->header, config->channels, config->rate,
+                  pcm_format_to_bits(config->format));
+    ar->frame_bytes = ar->header.block_align;
+    ar->update = config->rate;
+
+    ar->limit = ARCHIVE_MAX_FRAMES;
+    if (max_seconds && (unsigned long long)max_seconds * config->rate < ar->limit)
+        ar->limit = max_seconds * config->rate;
+    if (max_bytes && max_bytes / ar->frame_bytes < ar->limit)
+        ar->limit = max_bytes / ar->frame_bytes;
+    if (!ar->limit)
+        goto err_lock;
+
+    if (pthread_mutex_init(&ar->lock, NULL))
+        goto err_lock;
+    ar->event = eventfd(0, EFD_CLOEXEC);
+    if (ar->event < 0)
+        goto err_event;
+    if (archive_prepare(ar, &ar->cur) < 0)
+        goto err_file;
+
+    /* signals are for the capture thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (pthread_create(&ar->thread, NULL, archive_thread, ar)) {
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        goto err_thread;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    /* have the second file ready before the first is full */
+    archive_kick(ar);
+    return ar;
+
+err_thread:
+    close(ar->cur.fd);
+err_file:
+    close(ar->event);
+err_event:
+    pthread_mutex_destroy(&ar->lock);
+err_lock:
+    free(ar);
+    return NULL;
+}
+
+void archive_close(struct archive *ar)
+{
+    char name[PATH_MAX + 16];
+
+    if (!ar)
+        return;
+
+    archive_finish(&ar->cur);
+
+    ar->quit = 1;
+    __sync_synchronize();
+    archive_kick(ar);
+    pthread_join(ar->thread, NULL);
+
+    /* nothing was written to the one opened ahead */
+    if (ar->next_ready) {
+        close(ar->next.fd);
+        snprintf(name, sizeof(name), "%s-%04u.wav", ar->prefix, ar->next.index);
+        unlink(name);
+    }
+
+    close(ar->event);
+    pthread_mutex_destroy(&ar->lock);
+    free(ar);
+}
+
+unsigned int archive_get_files(struct archive *ar)
+{
+    return ar->cur.index + 1;
+}
@@ -0,0 +1,71 @@
+/* archive.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "asoundlib.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Continuous archive.
+ *
+ * Writes everything captured to <prefix>-<n>.wav, starting a new file every
+ * max_seconds of audio or max_bytes of data, whichever comes first, on an
+ * exact frame boundary so that the files put back to back are the stream.
+ * Files carry a wav_rf64_header (see wav.h), rewritten every second of
+ * audio, so a file is valid while it is being written and can grow past
+ * 4 GB. The next file is opened by a background thread ahead of time and
+ * the finished one is closed there too, so a rotation costs the capture
+ * thread no more than a write.
+ */
+
+struct archive;
+
+/* 0 for max_seconds or max_bytes is no limit on that; a file is rotated
+ * before its frame count could overflow 31 bits in any case */
+struct archive *archive_open(const struct pcm_config *config, const char *prefix,
+                             unsigned int max_seconds, unsigned long long max_bytes);
+/* Finish the file being written */
+void archive_close(struct archive *ar);
+
+/* Append frames of interleaved audio. Returns 0, or -errno if the data
+ * could not be written */
+int archive_write(struct archive *ar, const void *data, unsigned int frames);
+
+/* Number of files started so far */
+unsigned int archive_get_files(struct archive *ar);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
@@ -56,6 +56,11 @@ struct pcm;
                                    * restart the stream.
                                    */
 #define PCM_MONOTONIC  0x00000008 /* see pcm_get_htimestamp */
+#define PCM_NONINTERLEAVED 0x00000010 /* one buffer per channel: see
+                                       * pcm_writen, pcm_readn and
+                                       * pcm_mmap_begin
+                                       */
+#define PCM_STATS      0x00000020 /* see pcm_get_stats */
 
 /* PCM runtime states */
 #define	PCM_STATE_OPEN		0
@@ -120,6 +125,17 @@ enum pcm_param
     PCM_PARAM_BUFFER_SIZE,
     PCM_PARAM_BUFFER_BYTES,
     PCM_PARAM_TICK_TIME,
+
+    /* masks, see pcm_params_get_mask() */
+    PCM_PARAM_ACCESS,
+    PCM_PARAM_FORMAT,
+    PCM_PARAM_SUBFORMAT,
+};
+
+/* A set of ALSA values (SNDRV_PCM_FORMAT_*, SNDRV_PCM_ACCESS_*, ...), bit n
+ * of bits[n / 32] set when value n is supported */
+struct pcm_mask {
+    unsigned int bits[32 / sizeof(unsigned int)];
 };
 
 /* Mixer control types */
@@ -135,6 +151,17 @@ enum mixer_ctl_type {
     MIXER_CTL_TYPE_MAX,
 };
 
+/* Mixer control interfaces, as in the kernel's control ids */
+enum mixer_ctl_iface {
+    MIXER_CTL_IFACE_CARD,
+    MIXER_CTL_IFACE_HWDEP,
+    MIXER_CTL_IFACE_MIXER,
+    MIXER_CTL_IFACE_PCM,
+    MIXER_CTL_IFACE_RAWMIDI,
+    MIXER_CTL_IFACE_TIMER,
+    MIXER_CTL_IFACE_SEQUENCER,
+};
+
 /* Open and close a stream */
 struct pcm *pcm_open(unsigned int card, unsigned int device,
                      unsigned int flags, struct pcm_config *config);
@@ -149,6 +176,47 @@ unsigned int pcm_params_get_min(struct pcm_params *pcm_params,
                                 enum pcm_param param);
 unsigned int pcm_params_get_max(struct pcm_params *pcm_params,
                                 enum pcm_param param);
+/* Same as pcm_params_get(), through a capability cache file keyed by card
+ * id. The card and pcm info read from the control device must still match
+ * for a cached entry to be used, so the pcm node itself is only opened
+ * (and its constraints refined) the first time or after the hardware
+ * changed. NULL cache_path uses the default: $XDG_CACHE_HOME or
+ * ~/.cache/tinyalsa_pcm.cache (a fixed path on Android). A cache file is
+ * only trusted if it is owned by the effective user and not writable by
+ * group or others.
+ */
+struct pcm_params *pcm_params_get_cached(unsigned int card, unsigned int device,
+                                         unsigned int flags, const char *cache_path);
+
+/* Fits config to what the device supports before pcm_open(): the format
+ * if supported, else S16_LE, S32_LE or S24_LE, then the nearest channel
+ * count and rate, then periods making up latency_ms (config->period_count
+ * of them, 4 if 0), or the nearest to the asked period size and count when
+ * latency_ms is 0. config is updated to the choice; callers compare it with
+ * what they asked for to add conversion. The outcome goes in the capability
+ * cache at cache_path (as for pcm_params_get_cached()), so asking again on
+ * unchanged hardware doesn't open the pcm. Returns 0 or -errno.
+ */
+int pcm_negotiate_config(unsigned int card, unsigned int device, unsigned int flags,
+                         struct pcm_config *config, unsigned int latency_ms,
+                         const char *cache_path);
+
+/* A pcm stream, as found by pcm_get_devices() */
+struct pcm_device_info {
+    unsigned int card;
+    unsigned int device;
+    unsigned int flags;     /* PCM_OUT or PCM_IN */
+    char card_id[16];
+    char name[80];
+};
+
+/* Fills in up to max streams of every card, found through the control
+ * devices, and returns how many there are in all */
+int pcm_get_devices(struct pcm_device_info *devs, unsigned int max);
+
+/* NULL for params that are intervals; points into pcm_params */
+struct pcm_mask *pcm_params_get_mask(struct pcm_params *pcm_params,
+                                     enum pcm_param param);
 
 /* Set and get config */
 int pcm_get_config(struct pcm *pcm, struct pcm_config *config);
@@ -190,8 +258,28 @@ int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail,
 int pcm_write(struct pcm *pcm, const void *data, unsigned int count);
 int pcm_read(struct pcm *pcm, void *data, unsigned int count);
 
+/* As pcm_write() and pcm_read() for PCM_NONINTERLEAVED streams, which
+ * refuse those: data holds one buffer per channel and count is in frames.
+ */
+int pcm_writen(struct pcm *pcm, void **data, unsigned int count);
+int pcm_readn(struct pcm *pcm, void **data, unsigned int count);
+
+/* Where a channel lives in the mmap buffer, as ALSA describes it: sample n
+ * of the channel starts first + n * step bits past addr.
+ */
+struct pcm_channel_area {
+    void *addr;
+    unsigned int first;
+    unsigned int step;
+};
+
 /*
  * mmap() support.
+ * pcm_mmap_begin() returns the mmap buffer in areas, or for a
+ * PCM_NONINTERLEAVED stream an array of one struct pcm_channel_area per
+ * channel, which stays valid until pcm_close(). pcm_mmap_write() and
+ * pcm_mmap_read() on such a stream take planar data: all of channel 0's
+ * samples, then all of channel 1's, and so on.
  */
 int pcm_mmap_write(struct pcm *pcm, const void *data, unsigned int count);
 int pcm_mmap_read(struct pcm *pcm, void *data, unsigned int count);
@@ -211,6 +299,68 @@ int pcm_wait(struct pcm *pcm, int timeout);
  */
 int pcm_set_avail_min(struct pcm *pcm, int avail_min);
 
+/* Software gain on playback streams, applied by pcm_write() and
+ * pcm_mmap_write() as they copy, in 1/100 dB from PCM_GAIN_MUTE to 0. A
+ * change ramps sample by sample over ramp_frames, linearly in amplitude or
+ * in dB, so it needs no control writes and makes no clicks. Mute fades out
+ * and back to the gain without forgetting it. Interleaved S16, S24 and S32
+ * only; at unity the data is not touched. Call from the thread that writes.
+ */
+#define PCM_GAIN_MUTE   -9999999
+
+enum pcm_ramp {
+    PCM_RAMP_LINEAR,
+    PCM_RAMP_EXPONENTIAL,
+};
+
+int pcm_set_gain(struct pcm *pcm, int db, unsigned int ramp_frames,
+                 enum pcm_ramp ramp);
+int pcm_get_gain(struct pcm *pcm);
+int pcm_set_mute(struct pcm *pcm, int mute, unsigned int ramp_frames);
+/* frames until the current gain ramp ends */
+unsigned int pcm_get_ramp_frames(struct pcm *pcm);
+
+/* Statistics of a stream opened with PCM_STATS. The thread moving data
+ * updates them without locks and pcm_get_stats() may be called from any
+ * other; each counter reads whole, though not all at the same instant.
+ * Histograms are log-linear, 8 buckets per power of two, so any value is
+ * known to within 12.5%.
+ */
+#define PCM_STATS_BUCKETS   240
+
+enum pcm_stats_ioctl {
+    PCM_STATS_IOCTL_TRANSFER,       /* READI/WRITEI/READN/WRITEN_FRAMES */
+    PCM_STATS_IOCTL_SYNC_PTR,
+    PCM_STATS_IOCTL_PREPARE,
+    PCM_STATS_IOCTL_START,
+    PCM_STATS_IOCTL_DROP,
+    PCM_STATS_IOCTL_OTHER,
+    PCM_STATS_IOCTL_MAX,
+};
+
+struct pcm_histogram {
+    unsigned int count[PCM_STATS_BUCKETS];
+    unsigned int samples;
+    unsigned int max;
+    unsigned long long sum;
+};
+
+struct pcm_stats {
+    unsigned int ioctls[PCM_STATS_IOCTL_MAX];
+    unsigned int xruns;
+    struct pcm_histogram blocked;   /* us spent in a transfer or pcm_wait() */
+    struct pcm_histogram jitter;    /* us between wakeups off the audio moved */
+    struct pcm_histogram avail;     /* frames available at a wakeup */
+    struct pcm_histogram recovery;  /* us from an xrun to data moving again */
+};
+
+int pcm_get_stats(struct pcm *pcm, struct pcm_stats *stats);
+/* the value below which percentile % of the samples fall, at most max */
+unsigned int pcm_histogram_percentile(const struct pcm_histogram *hist,
+                                      double percentile);
+/* writes a summary of pcm_get_stats() to fd, not from a signal handler */
+int pcm_dump_stats(struct pcm *pcm, int fd);
+
 /*
  * MIXER API
  */
@@ -229,6 +379,14 @@ const char *mixer_get_name(struct mixer *mixer);
 unsigned int mixer_get_num_ctls(struct mixer *mixer);
 struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id);
 struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name);
+/* Controls sharing a name are told apart by their index, and controls of a
+ * PCM interface by device and subdevice as well. Name lookups are hashed. */
+struct mixer_ctl *mixer_get_ctl_by_name_and_index(struct mixer *mixer,
+                                                  const char *name,
+                                                  unsigned int index);
+struct mixer_ctl *mixer_get_ctl_by_id(struct mixer *mixer, enum mixer_ctl_iface iface,
+                                      unsigned int device, unsigned int subdevice,
+                                      const char *name, unsigned int index);
 
 /* Get info about mixer controls */
 const char *mixer_ctl_get_name(struct mixer_ctl *ctl);
@@ -245,6 +403,33 @@ const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl,
  */
 void mixer_ctl_update(struct mixer_ctl *ctl);
 
+/* Control change events
+ *
+ * Once subscribed, every change the driver reports (including those made
+ * through this mixer) is queued for mixer_read_event(). mixer_get_fd()
+ * can be polled for POLLIN along with other fds; call mixer_read_event()
+ * until it returns 0 before polling again, as other mixer calls may have
+ * already moved pending events into the queue. mixer_wait_event() returns
+ * 1 when events are ready, 0 on timeout (ms, -1 blocks).
+ */
+#define MIXER_EVENT_VALUE   0x1     /* the values changed */
+#define MIXER_EVENT_INFO    0x2     /* the range, item names etc. changed */
+#define MIXER_EVENT_ADD     0x4     /* a control appeared */
+#define MIXER_EVENT_REMOVE  0x8     /* the control went away */
+#define MIXER_EVENT_LOST    0x10    /* the queue overflowed, re-read everything */
+
+struct mixer_event {
+    unsigned int mask;          /* MIXER_EVENT_* */
+    struct mixer_ctl *ctl;      /* NULL for controls added after mixer_open() */
+    char name[44];
+    unsigned int index;
+};
+
+int mixer_subscribe_events(struct mixer *mixer, int subscribe);
+int mixer_get_fd(struct mixer *mixer);
+int mixer_wait_event(struct mixer *mixer, int timeout);
+int mixer_read_event(struct mixer *mixer, struct mixer_event *event);
+
 /* Set and get mixer controls */
 int mixer_ctl_get_percent(struct mixer_ctl *ctl, unsigned int id);
 int mixer_ctl_set_percent(struct mixer_ctl *ctl, unsigned int id, int percent);
@@ -253,12 +438,44 @@ int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id);
 int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count);
 int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value);
 int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count);
+/* The first count values as mixer_ctl_get_value() returns them, in one read.
+ * Setting writes them in one go, keeping the values after count. */
+int mixer_ctl_get_values(struct mixer_ctl *ctl, int *values, unsigned int count);
+int mixer_ctl_set_values(struct mixer_ctl *ctl, const int *values, unsigned int count);
 int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string);
 
+/* Apply a scenario file (see mixer.c) in one go. The file is checked in
+ * full first; then only controls whose values differ are written, and if a
+ * write fails the ones already written are put back. A line too long to
+ * read returns -E2BIG, other parse errors -EINVAL, with stats->line set. */
+struct mixer_scenario_stats {
+    unsigned int controls;      /* controls in the file */
+    unsigned int writes;        /* ELEM_WRITE ioctls issued */
+    unsigned int elapsed_us;
+    unsigned int line;          /* line of a parse error, else 0 */
+    const char *failed;         /* control whose write failed, else NULL */
+};
+
+int mixer_apply_scenario(struct mixer *mixer, const char *path,
+                         struct mixer_scenario_stats *stats);
+
 /* Determe range of integer mixer controls */
 int mixer_ctl_get_range_min(struct mixer_ctl *ctl);
 int mixer_ctl_get_range_max(struct mixer_ctl *ctl);
 
+/* Volume in dB, in 1/100 dB, for integer controls that describe their
+ * scale with a dB TLV; -EINVAL for the others. Setting picks the nearest
+ * step and applies it to every value. A ramp moves every value to db over
+ * duration_ms on a background thread, stepping every 10 ms; a new ramp on
+ * the same control replaces the old one, and mixer_close() stops them. */
+#define MIXER_CTL_DB_MUTE   -9999999
+
+int mixer_ctl_get_db_range(struct mixer_ctl *ctl, int *min_db, int *max_db);
+int mixer_ctl_get_db(struct mixer_ctl *ctl, unsigned int id, int *db);
+int mixer_ctl_set_db(struct mixer_ctl *ctl, int db);
+int mixer_ctl_ramp_db(struct mixer_ctl *ctl, int db, unsigned int duration_ms);
+void mixer_wait_ramps(struct mixer *mixer);
+
 #if defined(__cplusplus)
 }  /* extern "C" */
 #endif
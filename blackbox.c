@@ -0,0 +1,446 @@
+/* blackbox.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+#include "blackbox.h"
+#include "wav.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB         0x0004U
+#endif
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB         0x40000
+#endif
+
+#define BLACKBOX_HUGE_SIZE  (2 * 1024 * 1024)
+#define BLACKBOX_CHUNK      4096    /* frames copied out at a time */
+
+struct blackbox {
+    struct blackbox_shared *shared;
+    uint8_t *data;
+    size_t map_size;
+    int fd;
+    int event;
+    int sock;
+    struct sockaddr_un addr;
+    char prefix[PATH_MAX];
+    unsigned int window;
+    uint8_t *bounce;
+    struct wav_header header;
+    pthread_t thread;
+    volatile int pending;
+    volatile int quit;
+    volatile unsigned int saves;
+};
+
+static int blackbox_memfd(unsigned int flags)
+{
+#ifdef SYS_memfd_create
+    return syscall(SYS_memfd_create, "blackbox", MFD_CLOEXEC |
+                   (flags & BLACKBOX_HUGEPAGE ? MFD_HUGETLB : 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Map the ring, trying the requested backing first and falling back to
+ * plain anonymous memory */
+static int blackbox_map(struct blackbox *bb, size_t size, unsigned int flags)
+{
+    size_t huge = (size + BLACKBOX_HUGE_SIZE - 1) & ~(size_t)(BLACKBOX_HUGE_SIZE - 1);
+    void *map = MAP_FAILED;
+
+    if ((flags & BLACKBOX_MEMFD) && (flags & BLACKBOX_HUGEPAGE)) {
+        bb->fd = blackbox_memfd(flags);
+        if (bb->fd >= 0 && ftruncate(bb->fd, huge) == 0)
+            map = mmap(NULL, huge, PROT_READ | PROT_WRITE, MAP_SHARED, bb->fd, 0);
+        if (map != MAP_FAILED) {
+            size = huge;
+        } else if (bb->fd >= 0) {
+            close(bb->fd);
+            bb->fd = -1;
+        }
+    }
+    if (map == MAP_FAILED && (flags & BLACKBOX_MEMFD)) {
+        bb->fd = blackbox_memfd(0);
+        if (bb->fd >= 0 && ftruncate(bb->fd, size) == 0)
+            map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, bb->fd, 0);
+        if (map == MAP_FAILED && bb->fd >= 0) {
+            close(bb->fd);
+            bb->fd = -1;
+        }
+    }
+
+    if (map == MAP_FAILED && (flags & BLACKBOX_HUGEPAGE)) {
+        map = mmap(NULL, huge, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED)
+            size = huge;
+    }
+    if (map == MAP_FAILED)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    /* fault every page in now rather than in the capture thread */
+    memset(map, 0, size);
+    bb->shared = map;
+    bb->data = (uint8_t *)(bb->shared + 1);
+    bb->map_size = size;
+    return 0;
+}
+
+/*
+ * Copy frames [end - frames, end) out of the ring into the next file. Each
+ * chunk is copied to the bounce buffer and only written out once reserve
+ * shows the capture thread had not started overwriting it by the time the
+ * copy was done; if it had, skip ahead to what is still intact.
+ */
+static void blackbox_save(struct blackbox *bb, uint32_t end, unsigned int frames)
+{
+    struct blackbox_shared *shared = bb->shared;
+    unsigned int ring = shared->ring_frames;
+    unsigned int slack = (ring - bb->window) / 2;
+    unsigned int saved = 0, lost = 0, slot, n;
+    char name[PATH_MAX + 16];
+    uint32_t pos, head;
+    FILE *file;
+
+    if (frames > shared->filled)
+        frames = shared->filled;
+    pos = end - frames;
+
+    snprintf(name, sizeof(name), "%s-%u.wav", bb->prefix, bb->saves);
+    file = fopen(name, "wb");
+    if (!file) {
+        fprintf(stderr, "blackbox: unable to create '%s'\n", name);
+        return;
+    }
+    fseek(file, sizeof(struct wav_header), SEEK_SET);
+
+    while (pos != end) {
+        slot = pos % ring;
+        n = end - pos;
+        if (n > BLACKBOX_CHUNK)
+            n = BLACKBOX_CHUNK;
+        if (n > ring - slot)
+            n = ring - slot;
+        memcpy(bb->bounce, bb->data + slot * shared->frame_bytes, n * shared->frame_bytes);
+
+        __sync_synchronize();
+        head = shared->reserve;
+        if (head - pos > ring) {
+            /* lapped: restart half the slack ahead of the writer */
+            if ((int32_t)(end - (head - ring + slack)) <= 0) {
+                lost += end - pos;
+                break;
+            }
+            lost += head - ring + slack - pos;
+            pos = head - ring + slack;
+            continue;
+        }
+
+        if (fwrite(bb->bounce, shared->frame_bytes, n, file) != n) {
+            fprintf(stderr, "blackbox: error writing '%s'\n", name);
+            break;
+        }
+        saved += n;
+        pos += n;
+    }
+
+    wav_header_set_frames(&bb->header, saved);
+    fseek(file, 0, SEEK_SET);
+    fwrite(&bb->header, sizeof(struct wav_header), 1, file);
+    fclose(file);
+
+    bb->saves++;
+    if (lost)
+        fprintf(stderr, "blackbox: saved %u frames to '%s', %u overwritten before "
+                "they could be saved\n", saved, name, lost);
+    else
+        fprintf(stderr, "blackbox: saved %u frames to '%s'\n", saved, name);
+}
+
+/* "save" or "save <seconds>" */
+static void blackbox_command(struct blackbox *bb)
+{
+    char cmd[64];
+    unsigned int frames = bb->window;
+    ssize_t n;
+
+    n = recv(bb->sock, cmd, sizeof(cmd) - 1, MSG_DONTWAIT);
+    if (n <= 0)
+        return;
+    cmd[n] = 0;
+
+    if (strncmp(cmd, "save", 4) != 0) {
+        fprintf(stderr, "blackbox: unknown command '%s'\n", cmd);
+        return;
+    }
+    if (cmd[4] == ' ' && atoi(cmd + 5) > 0 &&
+        (unsigned int)atoi(cmd + 5) * bb->shared->rate < frames)
+        frames = atoi(cmd + 5) * bb->shared->rate;
+
+    blackbox_save(bb, bb->shared->written, frames);
+}
+
+static void *blackbox_thread(void *arg)
+{
+    struct blackbox *bb = arg;
+    struct pollfd pfd[2];
+    uint64_t count;
+
+    pfd[0].fd = bb->event;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = bb->sock;
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        if (poll(pfd, bb->sock >= 0 ? 2 : 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            read(bb->event, &count, sizeof(count));
+            if (bb->pending) {
+                bb->pending = 0;
+                __sync_synchronize();
+                blackbox_save(bb, bb->shared->written, bb->window);
+            }
+            if (bb->quit)
+                break;
+        }
+        if (bb->sock >= 0 && (pfd[1].revents & POLLIN))
+            blackbox_command(bb);
+    }
+
+    return NULL;
+}
+
+static int blackbox_listen(struct blackbox *bb, const char *path)
+{
+    if (strlen(path) >= sizeof(bb->addr.sun_path))
+        return -ENAMETOOLONG;
+
+    bb->sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (bb->sock < 0)
+        return -errno;
+
+    bb->addr.sun_family = AF_UNIX;
+    strcpy(bb->addr.sun_path, path);
+    unlink(path);
+    if (bind(bb->sock, (struct sockaddr *)&bb->addr, sizeof(bb->addr)) < 0) {
+        close(bb->sock);
+        bb->sock = -1;
+        return -errno;
+    }
+    return 0;
+}
+
+struct blackbox *blackbox_open(const struct pcm_config *config, unsigned int seconds,
+                               const char *prefix, const char *socket_path,
+                               unsigned int flags)
+{
+    struct blackbox *bb;
+    unsigned int frame_bytes, need, ring;
+    sigset_t all, old;
+
+    if (!config || !seconds || !prefix)
+        return NULL;
+
+    bb = calloc(1, sizeof(*bb));
+    if (!bb)
+        return NULL;
+    bb->fd = -1;
+    bb->event = -1;
+    bb->sock = -1;
+
+    frame_bytes = config->channels * (pcm_format_to_bits(config->format) >> 3);
+    bb->window = seconds * config->rate;
+    /* room for the capture thread to run ahead while a window is saved,
+     * rounded up to a power of two so that slot n % ring carries on
+     * without a jump when the 32 bit counters wrap */
+    need = bb->window + (bb->window / 4 > config->rate ? bb->window / 4 : config->rate);
+    if (need > 0x80000000U)
+        goto err_map;
+    for (ring = 1; ring < need; ring <<= 1)
+        ;
+
+    if (blackbox_map(bb, sizeof(struct blackbox_shared) + (size_t)ring * frame_bytes,
+                     flags) < 0) {
+        fprintf(stderr, "blackbox: unable to allocate %u frames\n", ring);
+        goto err_map;
+    }
+    bb->shared->version = BLACKBOX_VERSION;
+    bb->shared->channels = config->channels;
+    bb->shared->rate = config->rate;
+    bb->shared->format = config->format;
+    bb->shared->frame_bytes = frame_bytes;
+    bb->shared->ring_frames = ring;
+    __sync_synchronize();
+    bb->shared->magic = BLACKBOX_MAGIC;
+
+    strncpy(bb->prefix, prefix, sizeof(bb->prefix) - 1);
+    wav_header_init(&bb->header, config->channels, config->rate,
+                    pcm_format_to_bits(config->format));
+
+    bb->bounce = malloc(BLACKBOX_CHUNK * frame_bytes);
+    bb->event = eventfd(0, EFD_CLOEXEC);
+    if (!bb->bounce || bb->event < 0)
+        goto err_fds;
+
+    if (socket_path && blackbox_listen(bb, socket_path) < 0) {
+        fprintf(stderr, "blackbox: unable to listen on '%s'\n", socket_path);
+        goto err_fds;
+    }
+
+    /* signals are for the capture thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (pthread_create(&bb->thread, NULL, blackbox_thread, bb)) {
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        goto err_thread;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    return bb;
+
+err_thread:
+    if (bb->sock >= 0) {
+        close(bb->sock);
+        unlink(bb->addr.sun_path);
+    }
+err_fds:
+    if (bb->event >= 0)
+        close(bb->event);
+    free(bb->bounce);
+    munmap(bb->shared, bb->map_size);
+    if (bb->fd >= 0)
+        close(bb->fd);
+err_map:
+    free(bb);
+    return NULL;
+}
+
+void blackbox_close(struct blackbox *bb)
+{
+    uint64_t one = 1;
+
+    if (!bb)
+        return;
+
+    bb->quit = 1;
+    __sync_synchronize();
+    write(bb->event, &one, sizeof(one));
+    pthread_join(bb->thread, NULL);
+
+    if (bb->sock >= 0) {
+        close(bb->sock);
+        unlink(bb->addr.sun_path);
+    }
+    close(bb->event);
+    free(bb->bounce);
+    munmap(bb->shared, bb->map_size);
+    if (bb->fd >= 0)
+        close(bb->fd);
+    free(bb);
+}
+
+void blackbox_write(struct blackbox *bb, const void *data, unsigned int frames)
+{
+    struct blackbox_shared *shared = bb->shared;
+    unsigned int ring = shared->ring_frames;
+    const uint8_t *src = data;
+    uint32_t pos = shared->written;
+    unsigned int slot, n;
+
+    while (frames) {
+        slot = pos % ring;
+        n = frames < ring - slot ? frames : ring - slot;
+
+        /* announce the overwrite before the first byte of it */
+        shared->reserve = pos + n;
+        __sync_synchronize();
+        memcpy(bb->data + slot * shared->frame_bytes, src, n * shared->frame_bytes);
+        __sync_synchronize();
+        shared->written = pos + n;
+        if (shared->filled < ring)
+            shared->filled = shared->filled + n < ring ? shared->filled + n : ring;
+
+        src += n * shared->frame_bytes;
+        pos += n;
+        frames -= n;
+    }
+}
+
+int blackbox_trigger(struct blackbox *bb)
+{
+    uint64_t one = 1;
+    int saved_errno = errno;
+    int ret = 0;
+
+    bb->pending = 1;
+    __sync_synchronize();
+    if (write(bb->event, &one, sizeof(one)) < 0)
+        ret = -errno;
+    errno = saved_errno;
+    return ret;
+}
+
+int blackbox_get_fd(struct blackbox *bb)
+{
+    return bb->fd;
+}
+
+unsigned int blackbox_get_saves(struct blackbox *bb)
+{
+    return bb->saves;
+}
@@ -0,0 +1,113 @@
+/* blackbox.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include "asoundlib.h"
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Black box recorder.
+ *
+ * Keeps the last seconds of capture in a ring allocated up front, and on a
+ * trigger saves them to <prefix>-<n>.wav. The capture thread only copies
+ * into the ring and bumps a counter: it never takes a lock, allocates or
+ * waits. The saving is done by a background thread, which copies the window
+ * out of the ring while it keeps being written and checks each piece was not
+ * overwritten in the meantime, so a save never stalls capture; if the disk
+ * is so slow that capture laps it, the oldest part of the window is lost and
+ * reported.
+ *
+ * A save is triggered by blackbox_trigger(), which is async-signal-safe, or
+ * by a datagram "save" (or "save <seconds>" for a shorter window) sent to the
+ * unix socket given at open.
+ */
+
+struct blackbox;
+
+#define BLACKBOX_MAGIC   0x58424b42 /* "BKBX" */
+#define BLACKBOX_VERSION 1
+
+/* Layout of the ring: this header followed by ring_frames frames of audio.
+ * Frame n lives in slot n % ring_frames. The writer moves reserve past the
+ * frames it is about to overwrite before touching them, and written once
+ * they are in place; filled is the number of valid frames, up to the ring
+ * size. Counters are 32 bit and compared with wrap-safe differences;
+ * ring_frames is a power of two, so n % ring_frames stays continuous when
+ * they wrap.
+ */
+struct blackbox_shared {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t rate;
+    uint32_t format;
+    uint32_t frame_bytes;
+    uint32_t ring_frames;
+    volatile uint32_t reserve;
+    volatile uint32_t written;
+    volatile uint32_t filled;
+    uint32_t reserved[6];
+};
+
+/* Back the ring with a memfd (see blackbox_get_fd()) rather than anonymous
+ * memory, and try to use huge pages for it. Either falls back quietly. */
+#define BLACKBOX_MEMFD     0x00000001
+#define BLACKBOX_HUGEPAGE  0x00000002
+
+struct blackbox *blackbox_open(const struct pcm_config *config, unsigned int seconds,
+                               const char *prefix, const char *socket_path,
+                               unsigned int flags);
+/* Finishes a save in progress, then frees the ring */
+void blackbox_close(struct blackbox *bb);
+
+/* Capture thread: append frames of interleaved audio to the ring */
+void blackbox_write(struct blackbox *bb, const void *data, unsigned int frames);
+
+/* Save the window that ends at the newest frame written. Triggers that come
+ * in while a save is running are merged into one more save after it.
+ * Returns 0, or -errno if the writer could not be woken. */
+int blackbox_trigger(struct blackbox *bb);
+
+/* The memfd holding the ring (a struct blackbox_shared, then the audio), for
+ * a supervisor to map and recover the audio if we die; -1 if not a memfd */
+int blackbox_get_fd(struct blackbox *bb);
+
+/* Number of windows saved so far */
+unsigned int blackbox_get_saves(struct blackbox *bb);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
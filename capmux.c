@@ -0,0 +1,344 @@
+/* capmux.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "capmux.h"
+
+#define CAPMUX_MAGIC   0x584d4143 /* "CAMX" */
+#define CAPMUX_VERSION 1
+
+/* Shared memory layout: this header followed by periods * period_bytes of
+ * audio. write_seq counts published periods and doubles as the futex word
+ * readers sleep on; period n lives in slot n % periods. All counters are 32 bit
+ * so they can be updated atomically on every ARM core we ship on, and are
+ * compared with wrap-safe unsigned differences.
+ */
+struct capmux_shared {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t rate;
+    uint32_t format;
+    uint32_t period_size;
+    uint32_t period_bytes;
+    uint32_t periods;
+    volatile uint32_t alive;
+    volatile uint32_t write_seq;
+    uint32_t reserved[6];
+};
+
+struct capmux {
+    int fd;
+    char name[NAME_MAX];
+    size_t map_size;
+    struct capmux_shared *shared;
+    uint8_t *data;
+};
+
+struct capmux_reader {
+    size_t map_size;
+    struct capmux_shared *shared;
+    uint8_t *data;
+    uint32_t cursor;
+    unsigned int offset;
+    unsigned int overruns;
+};
+
+static void capmux_shm_name(char *buf, size_t size, const char *name)
+{
+    snprintf(buf, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static int futex(volatile uint32_t *addr, int op, uint32_t val,
+                 const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+struct capmux *capmux_create(const char *name, const struct pcm_config *config,
+                             unsigned int ring_periods)
+{
+    struct capmux *mux;
+    unsigned int period_bytes;
+
+    if (!name || !config || !ring_periods)
+        return NULL;
+
+    mux = calloc(1, sizeof(*mux));
+    if (!mux)
+        return NULL;
+
+    period_bytes = config->period_size * config->channels *
+        (pcm_format_to_bits(config->format) >> 3);
+    mux->map_size = sizeof(struct capmux_shared) + ring_periods * period_bytes;
+
+    capmux_shm_name(mux->name, sizeof(mux->name), name);
+    mux->fd = shm_open(mux->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mux->fd < 0) {
+        fprintf(stderr, "cannot create shared memory '%s'\n", mux->name);
+        goto err_open;
+    }
+
+    if (ftruncate(mux->fd, mux->map_size) < 0)
+        goto err_map;
+
+    mux->shared = mmap(NULL, mux->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       mux->fd, 0);
+    if (mux->shared == MAP_FAILED)
+        goto err_map;
+    mux->data = (uint8_t *)(mux->shared + 1);
+
+    mux->shared->version = CAPMUX_VERSION;
+    mux->shared->channels = config->channels;
+    mux->shared->rate = config->rate;
+    mux->shared->format = config->format;
+    mux->shared->period_size = config->period_size;
+    mux->shared->period_bytes = period_bytes;
+    mux->shared->periods = ring_periods;
+    mux->shared->write_seq = 0;
+    mux->shared->alive = 1;
+    __sync_synchronize();
+    /* readers refuse to attach until the header is complete */
+    mux->shared->magic = CAPMUX_MAGIC;
+
+    return mux;
+
+err_map:
+    close(mux->fd);
+    shm_unlink(mux->name);
+err_open:
+    free(mux);
+    return NULL;
+}
+
+void capmux_destroy(struct capmux *mux)
+{
+    if (!mux)
+        return;
+
+    mux->shared->alive = 0;
+    __sync_synchronize();
+    futex(&mux->shared->write_seq, FUTEX_WAKE, INT_MAX, NULL);
+
+    munmap(mux->shared, mux->map_size);
+    close(mux->fd);
+    shm_unlink(mux->name);
+    free(mux);
+}
+
+unsigned int capmux_get_period_bytes(struct capmux *mux)
+{
+    return mux->shared->period_bytes;
+}
+
+int capmux_publish(struct capmux *mux, const void *data)
+{
+    struct capmux_shared *shared = mux->shared;
+    uint32_t seq = shared->write_seq;
+
+    memcpy(mux->data + (seq % shared->periods) * shared->period_bytes, data,
+           shared->period_bytes);
+
+    /* make the period visible before the sequence that announces it */
+    __sync_synchronize();
+    shared->write_seq = seq + 1;
+
+    futex(&shared->write_seq, FUTEX_WAKE, INT_MAX, NULL);
+
+    return 0;
+}
+
+struct capmux_reader *capmux_attach(const char *name)
+{
+    struct capmux_reader *reader;
+    struct capmux_shared hdr;
+    char fn[NAME_MAX];
+    int fd;
+
+    if (!name)
+        return NULL;
+
+    capmux_shm_name(fn, sizeof(fn), name);
+    fd = shm_open(fn, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open capture mux '%s'\n", fn);
+        return NULL;
+    }
+
+    if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        hdr.magic != CAPMUX_MAGIC || hdr.version != CAPMUX_VERSION) {
+        fprintf(stderr, "capture mux '%s' is not ready\n", fn);
+        goto err_hdr;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (!reader)
+        goto err_hdr;
+
+    /* map read-only so a misbehaving consumer cannot corrupt the stream
+     * for the others */
+    reader->map_size = sizeof(struct capmux_shared) + hdr.periods * hdr.period_bytes;
+    reader->shared = mmap(NULL, reader->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (reader->shared == MAP_FAILED)
+        goto err_map;
+    reader->data = (uint8_t *)(reader->shared + 1);
+    close(fd);
+
+    /* start from the newest data, not from whatever is left in the ring */
+    reader->cursor = reader->shared->write_seq;
+    return reader;
+
+err_map:
+    free(reader);
+err_hdr:
+    close(fd);
+    return NULL;
+}
+
+void capmux_detach(struct capmux_reader *reader)
+{
+    if (!reader)
+        return;
+
+    munmap(reader->shared, reader->map_size);
+    free(reader);
+}
+
+int capmux_get_config(struct capmux_reader *reader, struct pcm_config *config)
+{
+    if (!reader || !config)
+        return -EINVAL;
+
+    memset(config, 0, sizeof(*config));
+    config->channels = reader->shared->channels;
+    config->rate = reader->shared->rate;
+    config->format = reader->shared->format;
+    config->period_size = reader->shared->period_size;
+    config->period_count = reader->shared->periods;
+    return 0;
+}
+
+unsigned int capmux_get_overruns(struct capmux_reader *reader)
+{
+    return reader->overruns;
+}
+
+static int capmux_wait(struct capmux_reader *reader, int timeout_ms)
+{
+    struct capmux_shared *shared = reader->shared;
+    struct timespec ts, *tsp = NULL;
+    uint32_t head;
+
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    for (;;) {
+        head = shared->write_seq;
+        if (head != reader->cursor)
+            return 0;
+        if (!shared->alive)
+            return -ENODEV;
+        /* EAGAIN: published between the check and the wait */
+        if (futex(&shared->write_seq, FUTEX_WAIT, head, tsp) < 0 && errno != EAGAIN)
+            return -errno;
+    }
+}
+
+int capmux_read(struct capmux_reader *reader, void *data, unsigned int count,
+                int timeout_ms)
+{
+    struct capmux_shared *shared = reader->shared;
+    uint32_t cursor = reader->cursor;
+    unsigned int offset = reader->offset;
+    uint8_t *dst = data;
+    uint32_t head;
+    unsigned int n;
+    int ret;
+
+    while (count) {
+        ret = capmux_wait(reader, timeout_ms);
+        if (ret < 0) {
+            /* give back what was copied: it is still in the ring, and the
+             * caller can repeat the read without losing it */
+            reader->cursor = cursor;
+            reader->offset = offset;
+            return ret;
+        }
+
+        head = shared->write_seq;
+        __sync_synchronize();
+        if (head - reader->cursor >= shared->periods)
+            goto overrun;
+
+        n = shared->period_bytes - reader->offset;
+        if (n > count)
+            n = count;
+        memcpy(dst, reader->data + (reader->cursor % shared->periods) *
+               shared->period_bytes + reader->offset, n);
+
+        /* the slot is rewritten as soon as the producer reaches
+         * cursor + periods, so check we copied it before that happened */
+        __sync_synchronize();
+        head = shared->write_seq;
+        if (head - reader->cursor >= shared->periods)
+            goto overrun;
+
+        dst += n;
+        count -= n;
+        reader->offset += n;
+        if (reader->offset == shared->period_bytes) {
+            reader->offset = 0;
+            reader->cursor++;
+        }
+    }
+
+    return 0;
+
+overrun:
+    reader->overruns += head - reader->cursor;
+    reader->cursor = head;
+    reader->offset = 0;
+    return -EPIPE;
+}
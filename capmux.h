@@ -0,0 +1,84 @@
+/* capmux.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef CAPMUX_H
+#define CAPMUX_H
+
+#include "asoundlib.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Capture multiplexer.
+ *
+ * Only one process can hold the capture PCM open. The producer (tinycapmux)
+ * reads it once and publishes every period into a shared memory ring. Any
+ * number of readers attach to the ring by name and follow it with their own
+ * cursor. The producer never waits for readers: a reader that falls more than
+ * a ring behind gets -EPIPE from capmux_read() and is resynced to the newest
+ * data.
+ */
+
+struct capmux;
+struct capmux_reader;
+
+/* Producer side */
+struct capmux *capmux_create(const char *name, const struct pcm_config *config,
+                             unsigned int ring_periods);
+void capmux_destroy(struct capmux *mux);
+int capmux_publish(struct capmux *mux, const void *data);
+unsigned int capmux_get_period_bytes(struct capmux *mux);
+
+/* Reader side */
+struct capmux_reader *capmux_attach(const char *name);
+void capmux_detach(struct capmux_reader *reader);
+int capmux_get_config(struct capmux_reader *reader, struct pcm_config *config);
+
+/* Read count bytes, blocking until they are published.
+ * Returns 0 on success, -EPIPE if the reader was overrun (the partially read
+ * data is dropped and the cursor moved to the newest period), -ETIMEDOUT if
+ * nothing was published within timeout_ms (-1 waits forever), -EINTR if a
+ * signal interrupted the wait, -ENODEV once the producer has gone away, or
+ * another negative errno if the wait itself failed.
+ * Every error but -EPIPE consumes nothing, so the read can be repeated. A
+ * producer that was killed never says it has gone: wait with a timeout and
+ * give up after a long silence.
+ */
+int capmux_read(struct capmux_reader *reader, void *data, unsigned int count,
+                int timeout_ms);
+
+/* Total number of periods this reader has lost to overruns */
+unsigned int capmux_get_overruns(struct capmux_reader *reader);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+/* convert.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "convert.h"
+
+/* input frames the interpolator looks back over */
+#define CONVERT_HISTORY 3
+
+struct convert {
+    struct convert_side in;
+    struct convert_side out;
+
+    /* rate conversion: the next output sits frac / out.rate past frame pos
+     * of work, which starts with CONVERT_HISTORY frames of the last call */
+    unsigned int pos;
+    unsigned int frac;
+    float *work;            /* out.channels per frame */
+    unsigned int work_frames;
+    float *frame;           /* one frame, when the rates match */
+};
+
+static const float convert_scale[] = {
+    [CONVERT_S16] = 32768.0f,
+    [CONVERT_S24_PACKED] = 8388608.0f,
+    [CONVERT_S24] = 8388608.0f,
+    [CONVERT_S32] = 2147483648.0f,
+};
+
+unsigned int convert_frame_bytes(const struct convert_side *side)
+{
+    switch (side->format) {
+    case CONVERT_S16:
+        return side->channels * 2;
+    case CONVERT_S24_PACKED:
+        return side->channels * 3;
+    default:
+        return side->channels * 4;
+    }
+}
+
+struct convert *convert_init(const struct convert_side *in,
+                             const struct convert_side *out)
+{
+    struct convert *cv;
+
+    if (!in->channels || !out->channels || !in->rate || !out->rate)
+        return NULL;
+
+    cv = calloc(1, sizeof(*cv));
+    if (!cv)
+        return NULL;
+
+    cv->frame = malloc(out->channels * sizeof(float));
+    if (!cv->frame) {
+        free(cv);
+        return NULL;
+    }
+
+    cv->in = *in;
+    cv->out = *out;
+    cv->pos = CONVERT_HISTORY;
+    return cv;
+}
+
+void convert_free(struct convert *cv)
+{
+    if (!cv)
+        return;
+
+    free(cv->work);
+    free(cv->frame);
+    free(cv);
+}
+
+unsigned int convert_max_out_frames(struct convert *cv, unsigned int in_frames)
+{
+    return (unsigned long long)in_frames * cv->out.rate / cv->in.rate + 2;
+}
+
+static float convert_read(enum convert_format format, const unsigned char *p)
+{
+    int32_t v;
+
+    switch (format) {
+    case CONVERT_S16:
+        v = *(const int16_t *)p;
+        break;
+    case CONVERT_S24_PACKED:
+        v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+        break;
+    case CONVERT_S24:
+        v = (int32_t)(*(const uint32_t *)p << 8) >> 8;
+        break;
+    default:
+        v = *(const int32_t *)p;
+        break;
+    }
+    return (float)v / convert_scale[format];
+}
+
+static void convert_write(enum convert_format format, unsigned char *p, float x)
+{
+    float scale = convert_scale[format];
+    double v = (double)x * scale;
+    int32_t s;
+
+    v = v < 0 ? v - 0.5 : v + 0.5;
+    if (v >= scale - 1)
+        v = scale - 1;
+    else if (v < -scale)
+        v = -scale;
+    s = (int32_t)v;
+
+    switch (format) {
+    case CONVERT_S16:
+        *(int16_t *)p = s;
+        break;
+    case CONVERT_S24_PACKED:
+        p[0] = s;
+        p[1] = s >> 8;
+        p[2] = s >> 16;
+        break;
+    default:
+        *(int32_t *)p = s;
+        break;
+    }
+}
+
+/* one frame of in to out.channels floats */
+static void convert_map(struct convert *cv, const unsigned char *in, float *out)
+{
+    unsigned int bytes = convert_frame_bytes(&cv->in) / cv->in.channels;
+    unsigned int ic = cv->in.channels, oc = cv->out.channels;
+    unsigned int c;
+
+    if (ic <= oc) {
+        for (c = 0; c < oc; c++)
+            out[c] = convert_read(cv->in.format, in + (c % ic) * bytes);
+        return;
+    }
+
+    for (c = 0; c < oc; c++)
+        out[c] = 0.0f;
+    for (c = 0; c < ic; c++)
+        out[c % oc] += convert_read(cv->in.format, in + c * bytes);
+    for (c = 0; c < oc; c++)
+        out[c] /= (ic / oc) + (c < ic % oc);
+}
+
+static float convert_hermite(float xm1, float x0, float x1, float x2, float t)
+{
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+unsigned int convert_process(struct convert *cv, const void *in,
+                             unsigned int in_frames, void *out)
+{
+    const unsigned char *src = in;
+    unsigned char *dst = out;
+    unsigned int in_bytes = convert_frame_bytes(&cv->in);
+    unsigned int out_bytes = convert_frame_bytes(&cv->out);
+    unsigned int oc = cv->out.channels, sample = out_bytes / oc;
+    unsigned int f, c, n = 0, total;
+    float *w;
+
+    if (cv->in.rate == cv->out.rate) {
+        for (f = 0; f < in_frames; f++) {
+            convert_map(cv, src + f * in_bytes, cv->frame);
+            for (c = 0; c < oc; c++)
+                convert_write(cv->out.format, dst + f * out_bytes + c * sample,
+                              cv->frame[c]);
+        }
+        return in_frames;
+    }
+
+    total = CONVERT_HISTORY + in_frames;
+    if (total > cv->work_frames) {
+        w = realloc(cv->work, total * oc * sizeof(float));
+        if (!w)
+            return 0;
+        /* a new buffer starts from silence */
+        if (!cv->work)
+            memset(w, 0, CONVERT_HISTORY * oc * sizeof(float));
+        cv->work = w;
+        cv->work_frames = total;
+    }
+    w = cv->work;
+
+    for (f = 0; f < in_frames; f++)
+        convert_map(cv, src + f * in_bytes, w + (CONVERT_HISTORY + f) * oc);
+
+    while (cv->pos + 2 < total) {
+        float t = (float)cv->frac / cv->out.rate;
+        const float *x = w + cv->pos * oc;
+
+        for (c = 0; c < oc; c++, x++)
+            convert_write(cv->out.format, dst + c * sample,
+                          convert_hermite(x[-(int)oc], x[0], x[oc], x[2 * oc], t));
+        dst += out_bytes;
+        n++;
+
+        cv->frac += cv->in.rate;
+        cv->pos += cv->frac / cv->out.rate;
+        cv->frac %= cv->out.rate;
+    }
+
+    /* keep the last frames for the next call */
+    memmove(w, w + in_frames * oc, CONVERT_HISTORY * oc * sizeof(float));
+    cv->pos -= in_frames;
+    return n;
+}
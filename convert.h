@@ -0,0 +1,77 @@
+/* convert.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Sample format, channel count and rate conversion for playback of data the
+ * device does not take as it is (see pcm_negotiate_config()).
+ *
+ * Frames go through float: channels fold down by averaging the inputs that
+ * map to each output (index modulo the output count) and spread up by
+ * repeating the inputs, then a 4 point Hermite interpolator changes the
+ * rate, keeping its history between calls. Output is rounded and clipped.
+ * Equal rates skip the interpolator.
+ */
+
+enum convert_format {
+    CONVERT_S16,
+    CONVERT_S24_PACKED,     /* 3 bytes, as in wav files */
+    CONVERT_S24,            /* in the low bits of 32, PCM_FORMAT_S24_LE */
+    CONVERT_S32,
+};
+
+struct convert_side {
+    enum convert_format format;
+    unsigned int channels;
+    unsigned int rate;
+};
+
+struct convert;
+
+struct convert *convert_init(const struct convert_side *in,
+                             const struct convert_side *out);
+void convert_free(struct convert *cv);
+
+unsigned int convert_frame_bytes(const struct convert_side *side);
+/* the most output frames in_frames of input can make */
+unsigned int convert_max_out_frames(struct convert *cv, unsigned int in_frames);
+/* returns the number of frames written to out */
+unsigned int convert_process(struct convert *cv, const void *in,
+                             unsigned int in_frames, void *out);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
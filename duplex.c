@@ -0,0 +1,238 @@
+/* duplex.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "duplex.h"
+
+#define DUPLEX_ERROR_MAX 128
+/* reference history kept for alignment, in buffers */
+#define DUPLEX_HISTORY   8
+
+struct duplex {
+    struct pcm *play;
+    struct pcm *cap;
+    struct pcm_config config;
+    unsigned int frame_bytes;
+    unsigned int period_bytes;
+
+    /* history of what was written for playback, indexed by frame count */
+    uint8_t *history;
+    unsigned int history_frames;
+    unsigned long long written;
+    unsigned long long read;
+
+    /* capture frame index minus playback frame index at the same instant */
+    long long offset;
+    int offset_valid;
+
+    uint8_t *silence;
+    char error[DUPLEX_ERROR_MAX];
+};
+
+int duplex_is_ready(struct duplex *dx)
+{
+    return dx->error[0] == '\0';
+}
+
+const char *duplex_get_error(struct duplex *dx)
+{
+    return dx->error;
+}
+
+static long long ts_to_ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void duplex_history_put(struct duplex *dx, const uint8_t *data)
+{
+    unsigned int pos = dx->written % dx->history_frames;
+
+    /* history_frames is a whole number of periods, so no wrap inside one */
+    memcpy(dx->history + pos * dx->frame_bytes, data, dx->period_bytes);
+    dx->written += dx->config.period_size;
+}
+
+static int duplex_write(struct duplex *dx, const void *data)
+{
+    int ret;
+
+    if (!data)
+        data = dx->silence;
+    ret = pcm_write(dx->play, data, dx->period_bytes);
+    if (ret < 0)
+        return ret;
+    duplex_history_put(dx, data);
+    return 0;
+}
+
+struct duplex *duplex_open(unsigned int card, unsigned int play_device,
+                           unsigned int cap_device, struct pcm_config *config)
+{
+    struct duplex *dx;
+    unsigned int i;
+
+    dx = calloc(1, sizeof(*dx));
+    if (!dx)
+        return NULL;
+
+    dx->config = *config;
+    dx->play = pcm_open(card, play_device, PCM_OUT | PCM_MONOTONIC, &dx->config);
+    if (!dx->play || !pcm_is_ready(dx->play)) {
+        snprintf(dx->error, sizeof(dx->error), "playback: %s",
+                 pcm_get_error(dx->play));
+        return dx;
+    }
+
+    /* capture must run with the exact period the playback side got */
+    dx->cap = pcm_open(card, cap_device, PCM_IN | PCM_MONOTONIC, &dx->config);
+    if (!dx->cap || !pcm_is_ready(dx->cap)) {
+        snprintf(dx->error, sizeof(dx->error), "capture: %s",
+                 pcm_get_error(dx->cap));
+        return dx;
+    }
+
+    dx->frame_bytes = pcm_frames_to_bytes(dx->cap, 1);
+    dx->period_bytes = pcm_frames_to_bytes(dx->cap, dx->config.period_size);
+    dx->history_frames = DUPLEX_HISTORY * pcm_get_buffer_size(dx->play);
+    dx->history = calloc(dx->history_frames, dx->frame_bytes);
+    dx->silence = calloc(1, dx->period_bytes);
+    if (!dx->history || !dx->silence) {
+        snprintf(dx->error, sizeof(dx->error), "out of memory");
+        return dx;
+    }
+
+    /* keep half the playback buffer queued: enough to ride out a late
+     * wakeup, and it reaches the default start threshold */
+    for (i = 0; i < dx->config.period_count / 2 || i < 1; i++)
+        if (duplex_write(dx, NULL) < 0) {
+            snprintf(dx->error, sizeof(dx->error), "playback: %s",
+                     pcm_get_error(dx->play));
+            return dx;
+        }
+
+    *config = dx->config;
+    return dx;
+}
+
+void duplex_close(struct duplex *dx)
+{
+    if (!dx)
+        return;
+
+    if (dx->play)
+        pcm_close(dx->play);
+    if (dx->cap)
+        pcm_close(dx->cap);
+    free(dx->history);
+    free(dx->silence);
+    free(dx);
+}
+
+int duplex_get_delay(struct duplex *dx)
+{
+    return dx->offset_valid ? (int)dx->offset : -1;
+}
+
+/* Place both stream positions on the capture timestamp's timeline.
+ * Capture: frame read + avail is at the ADC at t_cap.
+ * Playback: frame written - queued is at the DAC at t_play.
+ */
+static void duplex_align(struct duplex *dx)
+{
+    struct timespec t_cap, t_play;
+    unsigned int cap_avail, play_avail;
+    long long cap_pos, play_pos, offset;
+
+    if (pcm_get_htimestamp(dx->cap, &cap_avail, &t_cap) < 0 ||
+        pcm_get_htimestamp(dx->play, &play_avail, &t_play) < 0)
+        return;
+
+    cap_pos = dx->read + cap_avail;
+    play_pos = dx->written - (pcm_get_buffer_size(dx->play) - play_avail);
+    play_pos += (ts_to_ns(&t_cap) - ts_to_ns(&t_play)) *
+        (long long)dx->config.rate / 1000000000LL;
+    offset = cap_pos - play_pos;
+
+    /* timestamps jitter by a few frames; the filter moves the reference
+     * slowly enough not to disturb the echo canceller. A jump of more than a
+     * period means a stream was restarted after an xrun, so follow it. */
+    if (!dx->offset_valid || llabs(offset - dx->offset) > dx->config.period_size) {
+        dx->offset = offset;
+        dx->offset_valid = 1;
+    } else {
+        dx->offset += (offset - dx->offset) / 8;
+    }
+}
+
+int duplex_transfer(struct duplex *dx, const void *play, void *mic, void *ref)
+{
+    unsigned long long first;
+    unsigned int i, pos;
+    uint8_t *out = ref;
+    int ret;
+
+    ret = duplex_write(dx, play);
+    if (ret < 0) {
+        snprintf(dx->error, sizeof(dx->error), "playback: %s",
+                 pcm_get_error(dx->play));
+        return ret;
+    }
+
+    ret = pcm_read(dx->cap, mic, dx->period_bytes);
+    if (ret < 0) {
+        snprintf(dx->error, sizeof(dx->error), "capture: %s",
+                 pcm_get_error(dx->cap));
+        return ret;
+    }
+    dx->read += dx->config.period_size;
+
+    duplex_align(dx);
+
+    /* playback frames for capture frames [read - period, read) */
+    first = dx->read - dx->config.period_size - dx->offset;
+    for (i = 0; i < dx->config.period_size; i++, out += dx->frame_bytes) {
+        unsigned long long frame = first + i;
+
+        if (!dx->offset_valid || (long long)frame < 0 || frame >= dx->written ||
+            dx->written - frame > dx->history_frames) {
+            memset(out, 0, dx->frame_bytes);
+            continue;
+        }
+        pos = frame % dx->history_frames;
+        memcpy(out, dx->history + pos * dx->frame_bytes, dx->frame_bytes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/* duplex.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef DUPLEX_H
+#define DUPLEX_H
+
+#include "asoundlib.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Full duplex engine.
+ *
+ * Runs a playback and a capture PCM of the same card with the same config,
+ * one period at a time, and hands back with every captured period the
+ * playback frames that were leaving the speaker while it was recorded. The
+ * two streams are put on a shared timeline with pcm_get_htimestamp() on both
+ * PCMs (opened PCM_MONOTONIC), so the reference is aligned to within the
+ * acoustic path, which the echo canceller models.
+ */
+
+struct duplex;
+
+struct duplex *duplex_open(unsigned int card, unsigned int play_device,
+                           unsigned int cap_device, struct pcm_config *config);
+void duplex_close(struct duplex *dx);
+int duplex_is_ready(struct duplex *dx);
+const char *duplex_get_error(struct duplex *dx);
+
+/* Queue one period for playback (silence if play is NULL), then read one
+ * captured period into mic and the matching reference into ref. Each buffer
+ * is one period of config->period_size frames.
+ */
+int duplex_transfer(struct duplex *dx, const void *play, void *mic, void *ref);
+
+/* Capture minus playback position, in frames, or -1 while not yet known */
+int duplex_get_delay(struct duplex *dx);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
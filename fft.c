@@ -0,0 +1,458 @@
+/* fft.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#if !defined(FFT_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define FFT_SSE2
+#endif
+
+#include "cpu.h"
+#include "fft.h"
+#include "fft_kernels.h"
+#include "fft_tables.h"
+
+#if FFT_TABLE_SIZE < FFT_MAX_SIZE
+#error "fft_tables.h is too small for FFT_MAX_SIZE, regenerate it"
+#endif
+
+#define FFT_MAX_STAGES 8
+
+struct fft {
+    unsigned int n;             /* real transform size */
+    unsigned int m;             /* complex transform size, n / 2 */
+    unsigned int log2m;
+    unsigned int *bitrev;       /* m entries */
+    void *work;                 /* m complex of the widest type */
+    float inv_scale;            /* 1 / m */
+
+    /* Radix-4 twiddles W^k, W^2k, W^3k of each stage, grouped per four
+     * butterflies as w1r[4] w1i[4] w2r[4] w2i[4] w3r[4] w3i[4] so SIMD
+     * stages load them straight into registers. */
+    unsigned int tw_offset[FFT_MAX_STAGES];
+    float *tw_f;
+    int16_t *tw_q15;
+    int32_t *tw_q31;
+
+    /* real split twiddles e^(-2 pi i k / n), k < m */
+    float *split_f;
+    int16_t *split_q15;
+    int32_t *split_q31;
+};
+
+static inline int16_t fft_sat16(int32_t v)
+{
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return v;
+}
+
+static inline int32_t fft_sat32(int64_t v)
+{
+    if (v > INT32_MAX)
+        return INT32_MAX;
+    if (v < INT32_MIN)
+        return INT32_MIN;
+    return v;
+}
+
+/* sin(2 pi a / FFT_TABLE_SIZE) from the quarter wave table */
+static int32_t fft_sin(unsigned int a)
+{
+    unsigned int quarter = FFT_TABLE_SIZE / 4;
+    unsigned int r = a % quarter;
+
+    switch ((a / quarter) & 3) {
+    case 0:  return fft_sin_q31[r];
+    case 1:  return fft_sin_q31[quarter - r];
+    case 2:  return -fft_sin_q31[r];
+    default: return -fft_sin_q31[quarter - r];
+    }
+}
+
+/* Store e^(-2 pi i a / FFT_TABLE_SIZE) at index re and im of every table */
+static void fft_set_twiddle(struct fft *fft, int tw, unsigned int re,
+                            unsigned int im, unsigned int a)
+{
+    int32_t c = fft_sin(a + FFT_TABLE_SIZE / 4);
+    int32_t s = -fft_sin(a);
+    float *f = tw ? fft->tw_f : fft->split_f;
+    int16_t *q15 = tw ? fft->tw_q15 : fft->split_q15;
+    int32_t *q31 = tw ? fft->tw_q31 : fft->split_q31;
+
+    f[re] = c / 2147483648.0f;
+    f[im] = s / 2147483648.0f;
+    q15[re] = fft_sat16(((int64_t)c + 0x8000) >> 16);
+    q15[im] = fft_sat16(((int64_t)s + 0x8000) >> 16);
+    q31[re] = c;
+    q31[im] = s;
+}
+
+struct fft *fft_init(unsigned int n)
+{
+    struct fft *fft;
+    unsigned int i, j, k, p, l, s, tw_len;
+
+    if (n < 4 || n > FFT_MAX_SIZE || (n & (n - 1)))
+        return NULL;
+
+    fft = calloc(1, sizeof(*fft));
+    if (!fft)
+        return NULL;
+
+    fft->n = n;
+    fft->m = n / 2;
+    fft->inv_scale = 1.0f / fft->m;
+    for (fft->log2m = 0; (1U << fft->log2m) < fft->m; fft->log2m++)
+        ;
+
+    /* lay out the radix-4 stages, rounding each up to a group of four */
+    tw_len = 0;
+    for (s = 0, l = (fft->log2m & 1) ? 2 : 1; l < fft->m; s++, l *= 4) {
+        fft->tw_offset[s] = tw_len;
+        tw_len += ((l + 3) & ~3U) * 6;
+    }
+
+    fft->bitrev = calloc(fft->m, sizeof(*fft->bitrev));
+    fft->work = calloc(n, sizeof(int32_t));
+    fft->tw_f = calloc(tw_len + 1, sizeof(float));
+    fft->tw_q15 = calloc(tw_len + 1, sizeof(int16_t));
+    fft->tw_q31 = calloc(tw_len + 1, sizeof(int32_t));
+    fft->split_f = calloc(n, sizeof(float));
+    fft->split_q15 = calloc(n, sizeof(int16_t));
+    fft->split_q31 = calloc(n, sizeof(int32_t));
+    if (!fft->bitrev || !fft->work || !fft->tw_f || !fft->tw_q15 ||
+        !fft->tw_q31 || !fft->split_f || !fft->split_q15 || !fft->split_q31) {
+        fft_free(fft);
+        return NULL;
+    }
+
+    for (i = 0; i < fft->m; i++) {
+        unsigned int r = 0;
+        for (j = 0; j < fft->log2m; j++)
+            if (i & (1U << j))
+                r |= 1U << (fft->log2m - 1 - j);
+        fft->bitrev[i] = r;
+    }
+
+    for (s = 0, l = (fft->log2m & 1) ? 2 : 1; l < fft->m; s++, l *= 4) {
+        for (k = 0; k < l; k++) {
+            unsigned int base = fft->tw_offset[s] + (k & ~3U) * 6 + (k & 3);
+            for (p = 1; p <= 3; p++)
+                fft_set_twiddle(fft, 1, base + (p - 1) * 8, base + (p - 1) * 8 + 4,
+                                p * k * (FFT_TABLE_SIZE / (4 * l)));
+        }
+    }
+
+    for (k = 0; k < fft->m; k++)
+        fft_set_twiddle(fft, 0, 2 * k, 2 * k + 1, k * (FFT_TABLE_SIZE / n));
+
+    return fft;
+}
+
+void fft_free(struct fft *fft)
+{
+    if (!fft)
+        return;
+
+    free(fft->bitrev);
+    free(fft->work);
+    free(fft->tw_f);
+    free(fft->tw_q15);
+    free(fft->tw_q31);
+    free(fft->split_f);
+    free(fft->split_q15);
+    free(fft->split_q31);
+    free(fft);
+}
+
+unsigned int fft_get_size(struct fft *fft)
+{
+    return fft->n;
+}
+
+#if defined(FFT_SSE2)
+
+static inline void fft_load4(const float *p, __m128 *re, __m128 *im)
+{
+    __m128 lo = _mm_loadu_ps(p), hi = _mm_loadu_ps(p + 4);
+
+    *re = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    *im = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+static inline void fft_store4(float *p, __m128 re, __m128 im)
+{
+    _mm_storeu_ps(p, _mm_unpacklo_ps(re, im));
+    _mm_storeu_ps(p + 4, _mm_unpackhi_ps(re, im));
+}
+
+/* Same as the NEON stage in fft_neon.c, with shuffles standing in for
+ * vld2q/vst2q */
+static void fft_radix4_sse2(float *x, unsigned int m, unsigned int l,
+                            const float *tw)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < m; i += 4 * l) {
+        for (k = 0; k < l; k += 4) {
+            const float *w = tw + k * 6;
+            float *a0 = x + 2 * (i + k), *a1 = a0 + 2 * l;
+            float *a2 = a1 + 2 * l, *a3 = a2 + 2 * l;
+            __m128 w1r = _mm_loadu_ps(w), w1i = _mm_loadu_ps(w + 4);
+            __m128 w2r = _mm_loadu_ps(w + 8), w2i = _mm_loadu_ps(w + 12);
+            __m128 w3r = _mm_loadu_ps(w + 16), w3i = _mm_loadu_ps(w + 20);
+            __m128 x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
+            __m128 t1r, t1i, t2r, t2i, t3r, t3i;
+            __m128 s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+
+            fft_load4(a0, &x0r, &x0i);
+            fft_load4(a1, &x1r, &x1i);
+            fft_load4(a2, &x2r, &x2i);
+            fft_load4(a3, &x3r, &x3i);
+
+            t1r = _mm_sub_ps(_mm_mul_ps(x2r, w1r), _mm_mul_ps(x2i, w1i));
+            t1i = _mm_add_ps(_mm_mul_ps(x2r, w1i), _mm_mul_ps(x2i, w1r));
+            t2r = _mm_sub_ps(_mm_mul_ps(x1r, w2r), _mm_mul_ps(x1i, w2i));
+            t2i = _mm_add_ps(_mm_mul_ps(x1r, w2i), _mm_mul_ps(x1i, w2r));
+            t3r = _mm_sub_ps(_mm_mul_ps(x3r, w3r), _mm_mul_ps(x3i, w3i));
+            t3i = _mm_add_ps(_mm_mul_ps(x3r, w3i), _mm_mul_ps(x3i, w3r));
+
+            s0r = _mm_add_ps(x0r, t2r); s0i = _mm_add_ps(x0i, t2i);
+            d0r = _mm_sub_ps(x0r, t2r); d0i = _mm_sub_ps(x0i, t2i);
+            s1r = _mm_add_ps(t1r, t3r); s1i = _mm_add_ps(t1i, t3i);
+            d1r = _mm_sub_ps(t1r, t3r); d1i = _mm_sub_ps(t1i, t3i);
+
+            fft_store4(a0, _mm_add_ps(s0r, s1r), _mm_add_ps(s0i, s1i));
+            fft_store4(a2, _mm_sub_ps(s0r, s1r), _mm_sub_ps(s0i, s1i));
+            fft_store4(a1, _mm_add_ps(d0r, d1i), _mm_sub_ps(d0i, d1r));
+            fft_store4(a3, _mm_sub_ps(d0r, d1i), _mm_add_ps(d0i, d1r));
+        }
+    }
+}
+
+static const struct fft_kernels fft_sse2_kernels = {
+    "sse2",
+    fft_radix4_sse2,
+    NULL,
+    NULL,
+};
+#endif
+
+static const struct fft_kernels fft_no_kernels = { "scalar", NULL, NULL, NULL };
+static const struct fft_kernels *fft_simd = &fft_no_kernels;
+
+/* picked once at load, before anything can call in */
+static void __attribute__((constructor)) fft_select(void)
+{
+#if defined(FFT_SSE2)
+    fft_simd = &fft_sse2_kernels;
+#elif !defined(FFT_NO_SIMD)
+    if (cpu_has_neon())
+        fft_simd = &fft_neon_kernels;
+#endif
+}
+
+const char *fft_kernel_name(void)
+{
+    return fft_simd->name;
+}
+
+/* float */
+#define FFT_T           float
+#define FFT_ACC         float
+#define FFT_SUFFIX
+#define FFT_TW          tw_f
+#define FFT_SPLIT       split_f
+#define FFT_MULQ(a, w)  ((a) * (w))
+#define FFT_STAGE(a)    (a)
+#define FFT_HALF(a)     (0.5f * (a))
+#define FFT_STORE(a)    (a)
+#define FFT_NEG(a)      (-(a))
+#define FFT_INV_OUT(a)  ((a) * fft->inv_scale)
+#define FFT_SIMD_RADIX4 fft_simd->radix4
+#include "fft_impl.h"
+#undef FFT_T
+#undef FFT_ACC
+#undef FFT_SUFFIX
+#undef FFT_TW
+#undef FFT_SPLIT
+#undef FFT_MULQ
+#undef FFT_STAGE
+#undef FFT_HALF
+#undef FFT_STORE
+#undef FFT_NEG
+#undef FFT_INV_OUT
+#undef FFT_SIMD_RADIX4
+
+/* Q15 */
+#define FFT_T           int16_t
+#define FFT_ACC         int32_t
+#define FFT_SUFFIX      _q15
+#define FFT_TW          tw_q15
+#define FFT_SPLIT       split_q15
+#define FFT_MULQ(a, w)  (((int32_t)(a) * (w) + 0x4000) >> 15)
+#define FFT_STAGE(a)    ((a) >> 1)
+#define FFT_HALF(a)     ((a) >> 1)
+#define FFT_STORE(a)    fft_sat16(a)
+#define FFT_NEG(a)      (-(int32_t)(a))
+#define FFT_INV_OUT(a)  (a)
+#define FFT_SIMD_RADIX4 fft_simd->radix4_q15
+#include "fft_impl.h"
+#undef FFT_T
+#undef FFT_ACC
+#undef FFT_SUFFIX
+#undef FFT_TW
+#undef FFT_SPLIT
+#undef FFT_MULQ
+#undef FFT_STAGE
+#undef FFT_HALF
+#undef FFT_STORE
+#undef FFT_NEG
+#undef FFT_INV_OUT
+#undef FFT_SIMD_RADIX4
+
+/* Q31 */
+#define FFT_T           int32_t
+#define FFT_ACC         int64_t
+#define FFT_SUFFIX      _q31
+#define FFT_TW          tw_q31
+#define FFT_SPLIT       split_q31
+#define FFT_MULQ(a, w)  (((int64_t)(a) * (w) + 0x40000000) >> 31)
+#define FFT_STAGE(a)    ((a) >> 1)
+#define FFT_HALF(a)     ((a) >> 1)
+#define FFT_STORE(a)    fft_sat32(a)
+#define FFT_NEG(a)      (-(int64_t)(a))
+#define FFT_INV_OUT(a)  (a)
+#define FFT_SIMD_RADIX4 fft_simd->radix4_q31
+#include "fft_impl.h"
+
+struct stft {
+    struct fft *fft;
+    unsigned int frame;
+    unsigned int hop;
+    float scale;        /* synthesis normalisation for the window overlap */
+    float *window;      /* sqrt Hann */
+    float *in;          /* last frame of input */
+    float *ola;         /* overlap-add accumulator */
+    float *time;        /* scratch */
+};
+
+struct stft *stft_init(unsigned int frame, unsigned int hop)
+{
+    struct stft *st;
+    unsigned int i;
+
+    if (!hop || (frame / 2) % hop)
+        return NULL;
+
+    st = calloc(1, sizeof(*st));
+    if (!st)
+        return NULL;
+
+    st->frame = frame;
+    st->hop = hop;
+    /* periodic Hann overlapped every hop sums to frame / (2 * hop) */
+    st->scale = 2.0f * hop / frame;
+    st->fft = fft_init(frame);
+    st->window = calloc(frame, sizeof(float));
+    st->in = calloc(frame, sizeof(float));
+    st->ola = calloc(frame, sizeof(float));
+    st->time = calloc(frame, sizeof(float));
+    if (!st->fft || !st->window || !st->in || !st->ola || !st->time) {
+        stft_free(st);
+        return NULL;
+    }
+
+    for (i = 0; i < frame; i++)
+        st->window[i] = sqrtf(0.5f - 0.5f * cosf(2 * M_PI * i / frame));
+
+    return st;
+}
+
+void stft_free(struct stft *st)
+{
+    if (!st)
+        return;
+
+    fft_free(st->fft);
+    free(st->window);
+    free(st->in);
+    free(st->ola);
+    free(st->time);
+    free(st);
+}
+
+unsigned int stft_get_frame(struct stft *st)
+{
+    return st->frame;
+}
+
+unsigned int stft_get_hop(struct stft *st)
+{
+    return st->hop;
+}
+
+void stft_reset(struct stft *st)
+{
+    memset(st->in, 0, st->frame * sizeof(float));
+    memset(st->ola, 0, st->frame * sizeof(float));
+}
+
+void stft_analyze(struct stft *st, const float *in, float *spec)
+{
+    unsigned int keep = st->frame - st->hop;
+    unsigned int i;
+
+    memmove(st->in, st->in + st->hop, keep * sizeof(float));
+    memcpy(st->in + keep, in, st->hop * sizeof(float));
+
+    for (i = 0; i < st->frame; i++)
+        st->time[i] = st->in[i] * st->window[i];
+    fft_forward(st->fft, st->time, spec);
+}
+
+void stft_synthesize(struct stft *st, float *spec, float *out)
+{
+    unsigned int keep = st->frame - st->hop;
+    unsigned int i;
+
+    fft_inverse(st->fft, spec, st->time);
+    for (i = 0; i < st->frame; i++)
+        st->ola[i] += st->time[i] * st->window[i] * st->scale;
+
+    memcpy(out, st->ola, st->hop * sizeof(float));
+    memmove(st->ola, st->ola + st->hop, keep * sizeof(float));
+    memset(st->ola + keep, 0, st->hop * sizeof(float));
+}
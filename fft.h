@@ -0,0 +1,106 @@
+/* fft.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Real FFT for the capture path.
+ *
+ * Transforms of n real samples (n a power of two, 4 <= n <= FFT_MAX_SIZE) use
+ * a radix-4 complex FFT of n / 2 points (with one radix-2 stage when needed).
+ * The spectrum is n / 2 + 1 bins stored as interleaved re, im pairs, so
+ * spectrum buffers hold n + 2 values. All state is allocated in fft_init();
+ * the transforms never allocate, and twiddles come from a table built at
+ * compile time (fft_tables.h).
+ *
+ * Float transforms are unscaled forward and scaled by 1 / n inverse. The
+ * Q15 and Q31 transforms are for cores with weak floating point: to stay in
+ * range the forward transform returns the spectrum divided by n and the
+ * inverse undoes only the unscaled spectrum, so a round trip scales by
+ * 1 / n. They saturate rather than wrap.
+ *
+ * The radix-4 stages of all three run on NEON from fft_neon.c when the cpu
+ * has it, checked once at load; the fixed point ones match the scalar code
+ * to the bit. On x86 the float stages use SSE2 and the fixed point ones
+ * stay scalar. Define FFT_NO_SIMD to stop both.
+ */
+
+#define FFT_MAX_SIZE 4096
+
+struct fft;
+
+struct fft *fft_init(unsigned int n);
+void fft_free(struct fft *fft);
+unsigned int fft_get_size(struct fft *fft);
+/* "neon", "sse2" or "scalar": what the radix-4 stages run on, the float
+ * ones only for "sse2" */
+const char *fft_kernel_name(void);
+
+/* in: n samples, out: n + 2 values. The inverse uses in as scratch and
+ * clobbers it. */
+void fft_forward(struct fft *fft, const float *in, float *out);
+void fft_inverse(struct fft *fft, float *in, float *out);
+void fft_forward_q15(struct fft *fft, const int16_t *in, int16_t *out);
+void fft_inverse_q15(struct fft *fft, int16_t *in, int16_t *out);
+void fft_forward_q31(struct fft *fft, const int32_t *in, int32_t *out);
+void fft_inverse_q31(struct fft *fft, int32_t *in, int32_t *out);
+
+/*
+ * Streaming STFT.
+ *
+ * Keeps the overlap between frames so callers push audio one hop at a time.
+ * Analysis and synthesis both use a sqrt Hann window, normalised so that
+ * stft_synthesize(stft_analyze(x)) reconstructs x delayed by frame - hop
+ * samples. hop must divide frame / 2.
+ */
+
+struct stft;
+
+struct stft *stft_init(unsigned int frame, unsigned int hop);
+void stft_free(struct stft *st);
+unsigned int stft_get_frame(struct stft *st);
+unsigned int stft_get_hop(struct stft *st);
+
+/* push hop samples, returns the spectrum (frame + 2 floats) of the last frame */
+void stft_analyze(struct stft *st, const float *in, float *spec);
+/* overlap-add the frame of spec (clobbered) and return the next hop samples */
+void stft_synthesize(struct stft *st, float *spec, float *out);
+void stft_reset(struct stft *st);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
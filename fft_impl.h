@@ -0,0 +1,171 @@
+/* fft_impl.h
+**
+** Sample type generic part of fft.c, included once per type. The includer
+** defines:
+**
+**   FFT_T            storage type of samples and twiddles
+**   FFT_ACC          type wide enough for a product of two FFT_T
+**   FFT_SUFFIX       suffix of the public function names
+**   FFT_TW           struct fft member holding the radix-4 twiddles
+**   FFT_SPLIT        struct fft member holding the real split twiddles
+**   FFT_MULQ(a, w)   product of a sample and a twiddle, back in sample scale
+**   FFT_STAGE(a)     scaling applied per radix-2 stage
+**   FFT_HALF(a)      a / 2
+**   FFT_STORE(a)     FFT_ACC to FFT_T, saturating where needed
+**   FFT_NEG(a)       -a in FFT_ACC
+**   FFT_INV_OUT(a)   final scaling of the inverse transform
+**
+** and may define FFT_SIMD_RADIX4(fft, x, l, tw) to replace the radix-4
+** stages with l >= 4, which always come in whole groups of four butterflies.
+*/
+
+#define FFT_CAT_(a, b) a##b
+#define FFT_CAT(a, b) FFT_CAT_(a, b)
+#define FFT_FN(name) FFT_CAT(name, FFT_SUFFIX)
+
+/* First stage when log2(m) is odd: radix-2 butterflies on adjacent pairs */
+static void FFT_FN(fft_radix2)(struct fft *fft, FFT_T *x)
+{
+    unsigned int i;
+
+    for (i = 0; i < fft->m; i += 2) {
+        FFT_T *a = x + 2 * i, *b = a + 2;
+        FFT_ACC ar = a[0], ai = a[1], br = b[0], bi = b[1];
+
+        a[0] = FFT_STORE(FFT_STAGE(ar + br));
+        a[1] = FFT_STORE(FFT_STAGE(ai + bi));
+        b[0] = FFT_STORE(FFT_STAGE(ar - br));
+        b[1] = FFT_STORE(FFT_STAGE(ai - bi));
+    }
+}
+
+/* Combine four transforms of size l into one of size 4l. After the base 2
+ * bit reversal the quarters hold the sub-transforms of the samples at 0, 2,
+ * 1 and 3 mod 4, hence the twiddle order below. */
+static void FFT_FN(fft_radix4)(struct fft *fft, FFT_T *x, unsigned int l,
+                               const FFT_T *tw)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < fft->m; i += 4 * l) {
+        for (k = 0; k < l; k++) {
+            const FFT_T *w = tw + (k & ~3U) * 6 + (k & 3);
+            FFT_T *a0 = x + 2 * (i + k), *a1 = a0 + 2 * l;
+            FFT_T *a2 = a1 + 2 * l, *a3 = a2 + 2 * l;
+            FFT_ACC t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+            FFT_ACC s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+
+            t0r = FFT_STAGE(FFT_STAGE((FFT_ACC)a0[0]));
+            t0i = FFT_STAGE(FFT_STAGE((FFT_ACC)a0[1]));
+            t1r = FFT_STAGE(FFT_STAGE(FFT_MULQ(a2[0], w[0]) - FFT_MULQ(a2[1], w[4])));
+            t1i = FFT_STAGE(FFT_STAGE(FFT_MULQ(a2[0], w[4]) + FFT_MULQ(a2[1], w[0])));
+            t2r = FFT_STAGE(FFT_STAGE(FFT_MULQ(a1[0], w[8]) - FFT_MULQ(a1[1], w[12])));
+            t2i = FFT_STAGE(FFT_STAGE(FFT_MULQ(a1[0], w[12]) + FFT_MULQ(a1[1], w[8])));
+            t3r = FFT_STAGE(FFT_STAGE(FFT_MULQ(a3[0], w[16]) - FFT_MULQ(a3[1], w[20])));
+            t3i = FFT_STAGE(FFT_STAGE(FFT_MULQ(a3[0], w[20]) + FFT_MULQ(a3[1], w[16])));
+
+            s0r = t0r + t2r; s0i = t0i + t2i;
+            d0r = t0r - t2r; d0i = t0i - t2i;
+            s1r = t1r + t3r; s1i = t1i + t3i;
+            d1r = t1r - t3r; d1i = t1i - t3i;
+
+            a0[0] = FFT_STORE(s0r + s1r);
+            a0[1] = FFT_STORE(s0i + s1i);
+            a2[0] = FFT_STORE(s0r - s1r);
+            a2[1] = FFT_STORE(s0i - s1i);
+            /* d0 -/+ i d1 */
+            a1[0] = FFT_STORE(d0r + d1i);
+            a1[1] = FFT_STORE(d0i - d1r);
+            a3[0] = FFT_STORE(d0r - d1i);
+            a3[1] = FFT_STORE(d0i + d1r);
+        }
+    }
+}
+
+/* Forward complex transform of the bit reversed data in x */
+static void FFT_FN(fft_complex)(struct fft *fft, FFT_T *x)
+{
+    unsigned int s, l = 1;
+
+    if (fft->log2m & 1) {
+        FFT_FN(fft_radix2)(fft, x);
+        l = 2;
+    }
+    for (s = 0; l < fft->m; s++, l *= 4) {
+#ifdef FFT_SIMD_RADIX4
+        if (l >= 4 && FFT_SIMD_RADIX4) {
+            FFT_SIMD_RADIX4(x, fft->m, l, fft->FFT_TW + fft->tw_offset[s]);
+            continue;
+        }
+#endif
+        FFT_FN(fft_radix4)(fft, x, l, fft->FFT_TW + fft->tw_offset[s]);
+    }
+}
+
+void FFT_FN(fft_forward)(struct fft *fft, const FFT_T *in, FFT_T *out)
+{
+    FFT_T *z = fft->work;
+    const FFT_T *sp = fft->FFT_SPLIT;
+    unsigned int m = fft->m;
+    unsigned int i, k;
+
+    /* pack even samples as real and odd samples as imaginary parts */
+    for (i = 0; i < m; i++) {
+        unsigned int r = fft->bitrev[i];
+        z[2 * r] = in[2 * i];
+        z[2 * r + 1] = in[2 * i + 1];
+    }
+    FFT_FN(fft_complex)(fft, z);
+
+    /* split the half size transform into the real spectrum */
+    out[0] = FFT_STORE(FFT_STAGE((FFT_ACC)z[0] + z[1]));
+    out[1] = 0;
+    out[2 * m] = FFT_STORE(FFT_STAGE((FFT_ACC)z[0] - z[1]));
+    out[2 * m + 1] = 0;
+    for (k = 1; k < m; k++) {
+        FFT_ACC zr = z[2 * k], zi = z[2 * k + 1];
+        FFT_ACC cr = z[2 * (m - k)], ci = FFT_NEG(z[2 * (m - k) + 1]);
+        FFT_ACC er = FFT_HALF(zr + cr), ei = FFT_HALF(zi + ci);
+        FFT_ACC or_ = FFT_HALF(zi - ci), oi = FFT_HALF(cr - zr);
+        FFT_ACC wr = sp[2 * k], wi = sp[2 * k + 1];
+
+        out[2 * k] = FFT_STORE(FFT_STAGE(er + FFT_MULQ(or_, wr) - FFT_MULQ(oi, wi)));
+        out[2 * k + 1] = FFT_STORE(FFT_STAGE(ei + FFT_MULQ(or_, wi) + FFT_MULQ(oi, wr)));
+    }
+}
+
+void FFT_FN(fft_inverse)(struct fft *fft, FFT_T *in, FFT_T *out)
+{
+    FFT_T *z = fft->work;
+    const FFT_T *sp = fft->FFT_SPLIT;
+    unsigned int m = fft->m;
+    unsigned int i, k;
+
+    /* rebuild the half size spectrum Z = E + iO and store its conjugate
+     * bit reversed: the inverse is the conjugate of the forward transform
+     * of the conjugate */
+    for (k = 0; k < m; k++) {
+        FFT_ACC xr = in[2 * k], xi = in[2 * k + 1];
+        FFT_ACC cr = in[2 * (m - k)], ci = FFT_NEG(in[2 * (m - k) + 1]);
+        FFT_ACC er = FFT_HALF(xr + cr), ei = FFT_HALF(xi + ci);
+        FFT_ACC dr = FFT_HALF(xr - cr), di = FFT_HALF(xi - ci);
+        /* O = D * conj(W) */
+        FFT_ACC wr = sp[2 * k], wi = sp[2 * k + 1];
+        FFT_ACC or_ = FFT_MULQ(dr, wr) + FFT_MULQ(di, wi);
+        FFT_ACC oi = FFT_MULQ(di, wr) - FFT_MULQ(dr, wi);
+        unsigned int r = fft->bitrev[k];
+
+        z[2 * r] = FFT_STORE(er - oi);
+        z[2 * r + 1] = FFT_STORE(FFT_NEG(ei + or_));
+    }
+    FFT_FN(fft_complex)(fft, z);
+
+    for (i = 0; i < m; i++) {
+        out[2 * i] = FFT_STORE(FFT_INV_OUT((FFT_ACC)z[2 * i]));
+        out[2 * i + 1] = FFT_STORE(FFT_INV_OUT(FFT_NEG(z[2 * i + 1])));
+    }
+}
+
+#undef FFT_CAT_
+#undef FFT_CAT
+#undef FFT_FN
@@ -0,0 +1,53 @@
+/* fft_kernels.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef FFT_KERNELS_H
+#define FFT_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * SIMD stages behind the transforms. Each radix4 combines every group of
+ * four size l transforms of the m complex values in x, four butterflies at
+ * a time, so l must be a multiple of four; a NULL entry leaves the stage
+ * to the scalar code. The Q15 and Q31 ones give the scalar results to the
+ * bit, scaling and saturation included.
+ */
+struct fft_kernels {
+    const char *name;
+    void (*radix4)(float *x, unsigned int m, unsigned int l, const float *tw);
+    void (*radix4_q15)(int16_t *x, unsigned int m, unsigned int l,
+                       const int16_t *tw);
+    void (*radix4_q31)(int32_t *x, unsigned int m, unsigned int l,
+                       const int32_t *tw);
+};
+
+/* fft_neon.c, all NULL unless it was built with NEON enabled */
+extern const struct fft_kernels fft_neon_kernels;
+
+#endif
@@ -0,0 +1,211 @@
+/* fft_neon.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include "fft_kernels.h"
+
+/*
+ * NEON stages for fft.c, built with -mfpu=neon and called only when the
+ * cpu has NEON (see cpu.h).
+ */
+
+#if !defined(FFT_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+
+/* Four radix-4 butterflies per iteration; vld2q/vst2q split and merge the
+ * interleaved re, im pairs. */
+static void fft_radix4_neon(float *x, unsigned int m, unsigned int l,
+                            const float *tw)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < m; i += 4 * l) {
+        for (k = 0; k < l; k += 4) {
+            const float *w = tw + k * 6;
+            float *a0 = x + 2 * (i + k), *a1 = a0 + 2 * l;
+            float *a2 = a1 + 2 * l, *a3 = a2 + 2 * l;
+            float32x4x2_t v0 = vld2q_f32(a0), v1 = vld2q_f32(a1);
+            float32x4x2_t v2 = vld2q_f32(a2), v3 = vld2q_f32(a3);
+            float32x4_t w1r = vld1q_f32(w), w1i = vld1q_f32(w + 4);
+            float32x4_t w2r = vld1q_f32(w + 8), w2i = vld1q_f32(w + 12);
+            float32x4_t w3r = vld1q_f32(w + 16), w3i = vld1q_f32(w + 20);
+            float32x4_t t1r, t1i, t2r, t2i, t3r, t3i;
+            float32x4_t s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+
+            t1r = vmlsq_f32(vmulq_f32(v2.val[0], w1r), v2.val[1], w1i);
+            t1i = vmlaq_f32(vmulq_f32(v2.val[0], w1i), v2.val[1], w1r);
+            t2r = vmlsq_f32(vmulq_f32(v1.val[0], w2r), v1.val[1], w2i);
+            t2i = vmlaq_f32(vmulq_f32(v1.val[0], w2i), v1.val[1], w2r);
+            t3r = vmlsq_f32(vmulq_f32(v3.val[0], w3r), v3.val[1], w3i);
+            t3i = vmlaq_f32(vmulq_f32(v3.val[0], w3i), v3.val[1], w3r);
+
+            s0r = vaddq_f32(v0.val[0], t2r); s0i = vaddq_f32(v0.val[1], t2i);
+            d0r = vsubq_f32(v0.val[0], t2r); d0i = vsubq_f32(v0.val[1], t2i);
+            s1r = vaddq_f32(t1r, t3r); s1i = vaddq_f32(t1i, t3i);
+            d1r = vsubq_f32(t1r, t3r); d1i = vsubq_f32(t1i, t3i);
+
+            v0.val[0] = vaddq_f32(s0r, s1r); v0.val[1] = vaddq_f32(s0i, s1i);
+            v2.val[0] = vsubq_f32(s0r, s1r); v2.val[1] = vsubq_f32(s0i, s1i);
+            v1.val[0] = vaddq_f32(d0r, d1i); v1.val[1] = vsubq_f32(d0i, d1r);
+            v3.val[0] = vsubq_f32(d0r, d1i); v3.val[1] = vaddq_f32(d0i, d1r);
+
+            vst2q_f32(a0, v0);
+            vst2q_f32(a1, v1);
+            vst2q_f32(a2, v2);
+            vst2q_f32(a3, v3);
+        }
+    }
+}
+
+/* The Q15 stage. The products are taken exactly and rounded back to Q15
+ * like FFT_MULQ; vqrdmulh would saturate -32768 * -32768, and both the
+ * data and the twiddles reach -32768. The sums are exact in 32 bits and
+ * saturate on the way back to 16. */
+static inline int32x4_t fft_mulq15_neon(int16x4_t a, int16x4_t w)
+{
+    return vrshrq_n_s32(vmull_s16(a, w), 15);
+}
+
+static void fft_radix4_q15_neon(int16_t *x, unsigned int m, unsigned int l,
+                                const int16_t *tw)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < m; i += 4 * l) {
+        for (k = 0; k < l; k += 4) {
+            const int16_t *w = tw + k * 6;
+            int16_t *a0 = x + 2 * (i + k), *a1 = a0 + 2 * l;
+            int16_t *a2 = a1 + 2 * l, *a3 = a2 + 2 * l;
+            int16x4x2_t v0 = vld2_s16(a0), v1 = vld2_s16(a1);
+            int16x4x2_t v2 = vld2_s16(a2), v3 = vld2_s16(a3);
+            int16x4_t w1r = vld1_s16(w), w1i = vld1_s16(w + 4);
+            int16x4_t w2r = vld1_s16(w + 8), w2i = vld1_s16(w + 12);
+            int16x4_t w3r = vld1_s16(w + 16), w3i = vld1_s16(w + 20);
+            int32x4_t t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+            int32x4_t s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+
+            t0r = vshrq_n_s32(vmovl_s16(v0.val[0]), 2);
+            t0i = vshrq_n_s32(vmovl_s16(v0.val[1]), 2);
+            t1r = vshrq_n_s32(vsubq_s32(fft_mulq15_neon(v2.val[0], w1r),
+                                        fft_mulq15_neon(v2.val[1], w1i)), 2);
+            t1i = vshrq_n_s32(vaddq_s32(fft_mulq15_neon(v2.val[0], w1i),
+                                        fft_mulq15_neon(v2.val[1], w1r)), 2);
+            t2r = vshrq_n_s32(vsubq_s32(fft_mulq15_neon(v1.val[0], w2r),
+                                        fft_mulq15_neon(v1.val[1], w2i)), 2);
+            t2i = vshrq_n_s32(vaddq_s32(fft_mulq15_neon(v1.val[0], w2i),
+                                        fft_mulq15_neon(v1.val[1], w2r)), 2);
+            t3r = vshrq_n_s32(vsubq_s32(fft_mulq15_neon(v3.val[0], w3r),
+                                        fft_mulq15_neon(v3.val[1], w3i)), 2);
+            t3i = vshrq_n_s32(vaddq_s32(fft_mulq15_neon(v3.val[0], w3i),
+                                        fft_mulq15_neon(v3.val[1], w3r)), 2);
+
+            s0r = vaddq_s32(t0r, t2r); s0i = vaddq_s32(t0i, t2i);
+            d0r = vsubq_s32(t0r, t2r); d0i = vsubq_s32(t0i, t2i);
+            s1r = vaddq_s32(t1r, t3r); s1i = vaddq_s32(t1i, t3i);
+            d1r = vsubq_s32(t1r, t3r); d1i = vsubq_s32(t1i, t3i);
+
+            v0.val[0] = vqmovn_s32(vaddq_s32(s0r, s1r));
+            v0.val[1] = vqmovn_s32(vaddq_s32(s0i, s1i));
+            v2.val[0] = vqmovn_s32(vsubq_s32(s0r, s1r));
+            v2.val[1] = vqmovn_s32(vsubq_s32(s0i, s1i));
+            v1.val[0] = vqmovn_s32(vaddq_s32(d0r, d1i));
+            v1.val[1] = vqmovn_s32(vsubq_s32(d0i, d1r));
+            v3.val[0] = vqmovn_s32(vsubq_s32(d0r, d1i));
+            v3.val[1] = vqmovn_s32(vaddq_s32(d0i, d1r));
+
+            vst2_s16(a0, v0);
+            vst2_s16(a1, v1);
+            vst2_s16(a2, v2);
+            vst2_s16(a3, v3);
+        }
+    }
+}
+
+/* The Q31 stage. No twiddle is INT32_MIN, so vqrdmulh is FFT_MULQ exactly.
+ * Halving adds and subtracts followed by one more shift are the scalar
+ * (a +/- b) >> 2 in 64 bits, which leaves every sum in 32 bits but the
+ * last, and saturating that one is what fft_sat32() does. */
+static void fft_radix4_q31_neon(int32_t *x, unsigned int m, unsigned int l,
+                                const int32_t *tw)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < m; i += 4 * l) {
+        for (k = 0; k < l; k += 4) {
+            const int32_t *w = tw + k * 6;
+            int32_t *a0 = x + 2 * (i + k), *a1 = a0 + 2 * l;
+            int32_t *a2 = a1 + 2 * l, *a3 = a2 + 2 * l;
+            int32x4x2_t v0 = vld2q_s32(a0), v1 = vld2q_s32(a1);
+            int32x4x2_t v2 = vld2q_s32(a2), v3 = vld2q_s32(a3);
+            int32x4_t w1r = vld1q_s32(w), w1i = vld1q_s32(w + 4);
+            int32x4_t w2r = vld1q_s32(w + 8), w2i = vld1q_s32(w + 12);
+            int32x4_t w3r = vld1q_s32(w + 16), w3i = vld1q_s32(w + 20);
+            int32x4_t t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+            int32x4_t s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+
+            t0r = vshrq_n_s32(v0.val[0], 2);
+            t0i = vshrq_n_s32(v0.val[1], 2);
+            t1r = vshrq_n_s32(vhsubq_s32(vqrdmulhq_s32(v2.val[0], w1r),
+                                         vqrdmulhq_s32(v2.val[1], w1i)), 1);
+            t1i = vshrq_n_s32(vhaddq_s32(vqrdmulhq_s32(v2.val[0], w1i),
+                                         vqrdmulhq_s32(v2.val[1], w1r)), 1);
+            t2r = vshrq_n_s32(vhsubq_s32(vqrdmulhq_s32(v1.val[0], w2r),
+                                         vqrdmulhq_s32(v1.val[1], w2i)), 1);
+            t2i = vshrq_n_s32(vhaddq_s32(vqrdmulhq_s32(v1.val[0], w2i),
+                                         vqrdmulhq_s32(v1.val[1], w2r)), 1);
+            t3r = vshrq_n_s32(vhsubq_s32(vqrdmulhq_s32(v3.val[0], w3r),
+                                         vqrdmulhq_s32(v3.val[1], w3i)), 1);
+            t3i = vshrq_n_s32(vhaddq_s32(vqrdmulhq_s32(v3.val[0], w3i),
+                                         vqrdmulhq_s32(v3.val[1], w3r)), 1);
+
+            s0r = vaddq_s32(t0r, t2r); s0i = vaddq_s32(t0i, t2i);
+            d0r = vsubq_s32(t0r, t2r); d0i = vsubq_s32(t0i, t2i);
+            s1r = vaddq_s32(t1r, t3r); s1i = vaddq_s32(t1i, t3i);
+            d1r = vsubq_s32(t1r, t3r); d1i = vsubq_s32(t1i, t3i);
+
+            v0.val[0] = vqaddq_s32(s0r, s1r); v0.val[1] = vqaddq_s32(s0i, s1i);
+            v2.val[0] = vqsubq_s32(s0r, s1r); v2.val[1] = vqsubq_s32(s0i, s1i);
+            v1.val[0] = vqaddq_s32(d0r, d1i); v1.val[1] = vqsubq_s32(d0i, d1r);
+            v3.val[0] = vqsubq_s32(d0r, d1i); v3.val[1] = vqaddq_s32(d0i, d1r);
+
+            vst2q_s32(a0, v0);
+            vst2q_s32(a1, v1);
+            vst2q_s32(a2, v2);
+            vst2q_s32(a3, v3);
+        }
+    }
+}
+
+const struct fft_kernels fft_neon_kernels = {
+    "neon",
+    fft_radix4_neon,
+    fft_radix4_q15_neon,
+    fft_radix4_q31_neon,
+};
+#else
+const struct fft_kernels fft_neon_kernels;
+#endif
@@ -0,0 +1,306 @@
+/* fftbench.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "fft.h"
+
+/*
+ * Checks the float, Q15 and Q31 transforms against a direct DFT in double
+ * precision and times them. Accuracy is the signal to error ratio over all
+ * bins of the forward spectrum, and over all samples of the round trip
+ * through the inverse (which the fixed point transforms scale by 1 / n, so
+ * theirs falls with n as the result runs out of bits). A forward spectrum
+ * below the minimum for its type fails. Half scale noise is the input.
+ */
+
+#define MIN_SIZE            16
+#define NS_PER_SIZE         200000000ULL    /* time spent timing each size */
+
+/* lowest forward signal to error ratio accepted, in dB */
+#define MIN_SNR_FLOAT       100.0
+#define MIN_SNR_Q31         100.0
+#define MIN_SNR_Q15         35.0
+
+enum sample_type {
+    TYPE_FLOAT,
+    TYPE_Q15,
+    TYPE_Q31,
+};
+
+static const struct {
+    const char *name;
+    double min_snr;
+    double full_scale;      /* of the values it transforms */
+    size_t size;
+} types[] = {
+    [TYPE_FLOAT] = { "float", MIN_SNR_FLOAT, 1.0, sizeof(float) },
+    [TYPE_Q15] = { "q15", MIN_SNR_Q15, 32768.0, sizeof(int16_t) },
+    [TYPE_Q31] = { "q31", MIN_SNR_Q31, 2147483648.0, sizeof(int32_t) },
+};
+
+struct bench {
+    struct fft *fft;
+    unsigned int n;
+    double *x;              /* the input */
+    double *ref;            /* its spectrum by direct DFT */
+    double *expect;         /* what a transform should return */
+    void *in;
+    void *out;
+    void *spec;             /* copy of out for the inverse to clobber */
+    void *back;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* ref: n / 2 + 1 bins of x as re, im pairs */
+static int dft(const double *x, double *ref, unsigned int n)
+{
+    double *c = malloc(n * sizeof(double));
+    unsigned int i, k;
+
+    if (!c)
+        return -1;
+    for (i = 0; i < n; i++)
+        c[i] = cos(2 * M_PI * i / n);
+    for (k = 0; k <= n / 2; k++) {
+        double re = 0, im = 0;
+
+        /* sin(2 pi a / n) is cos(2 pi (a - n / 4) / n) */
+        for (i = 0; i < n; i++) {
+            unsigned int a = (unsigned int)(((uint64_t)k * i) % n);
+
+            re += x[i] * c[a];
+            im -= x[i] * c[(a + 3 * n / 4) % n];
+        }
+        ref[2 * k] = re;
+        ref[2 * k + 1] = im;
+    }
+    free(c);
+    return 0;
+}
+
+static double value(enum sample_type type, const void *p, unsigned int i)
+{
+    switch (type) {
+    case TYPE_Q15:
+        return ((const int16_t *)p)[i] / types[type].full_scale;
+    case TYPE_Q31:
+        return ((const int32_t *)p)[i] / types[type].full_scale;
+    default:
+        return ((const float *)p)[i];
+    }
+}
+
+/* 10 log10 of the expected power over the error power */
+static double snr_db(enum sample_type type, const double *expect, const void *p,
+                     unsigned int count)
+{
+    double sig = 0, err = 0;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        double e = value(type, p, i) - expect[i];
+
+        sig += expect[i] * expect[i];
+        err += e * e;
+    }
+    if (err == 0)
+        return INFINITY;
+    return 10 * log10(sig / err);
+}
+
+static void forward(struct bench *b, enum sample_type type)
+{
+    switch (type) {
+    case TYPE_Q15:
+        fft_forward_q15(b->fft, b->in, b->out);
+        break;
+    case TYPE_Q31:
+        fft_forward_q31(b->fft, b->in, b->out);
+        break;
+    default:
+        fft_forward(b->fft, b->in, b->out);
+        break;
+    }
+}
+
+static void inverse(struct bench *b, enum sample_type type)
+{
+    memcpy(b->spec, b->out, (b->n + 2) * types[type].size);
+    switch (type) {
+    case TYPE_Q15:
+        fft_inverse_q15(b->fft, b->spec, b->back);
+        break;
+    case TYPE_Q31:
+        fft_inverse_q31(b->fft, b->spec, b->back);
+        break;
+    default:
+        fft_inverse(b->fft, b->spec, b->back);
+        break;
+    }
+}
+
+/* the input as the type, from x */
+static void load(struct bench *b, enum sample_type type)
+{
+    unsigned int i;
+
+    for (i = 0; i < b->n; i++) {
+        if (type == TYPE_Q15)
+            ((int16_t *)b->in)[i] = (int16_t)lrint(b->x[i] * 32768.0);
+        else if (type == TYPE_Q31)
+            ((int32_t *)b->in)[i] = (int32_t)lrint(b->x[i] * 2147483648.0);
+        else
+            ((float *)b->in)[i] = (float)b->x[i];
+    }
+}
+
+/* returns 0, or 1 if the forward transform is not accurate enough */
+static int run(struct bench *b, enum sample_type type)
+{
+    double scale = type == TYPE_FLOAT ? 1.0 : 1.0 / b->n;
+    double fwd_snr, back_snr, fwd_ns, inv_ns;
+    unsigned int i, r, count;
+    uint64_t start;
+
+    /* about 2 n log2 n operations, at a few ns each */
+    for (count = 0, i = b->n; i > 1; i /= 2)
+        count += 2 * b->n;
+    count = (unsigned int)(NS_PER_SIZE / 4 / count);
+    if (!count)
+        count = 1;
+
+    load(b, type);
+    forward(b, type);
+    for (i = 0; i < b->n + 2; i++)
+        b->expect[i] = b->ref[i] * scale;
+    fwd_snr = snr_db(type, b->expect, b->out, b->n + 2);
+    inverse(b, type);
+    for (i = 0; i < b->n; i++)
+        b->expect[i] = b->x[i] * scale;
+    back_snr = snr_db(type, b->expect, b->back, b->n);
+
+    start = now_ns();
+    for (r = 0; r < count; r++)
+        forward(b, type);
+    fwd_ns = (double)(now_ns() - start) / count;
+    start = now_ns();
+    for (r = 0; r < count; r++)
+        inverse(b, type);
+    inv_ns = (double)(now_ns() - start) / count;
+
+    printf("%-6s %5u %9.1f dB %9.1f dB %10.0f ns %10.0f ns%s\n", types[type].name,
+           b->n, fwd_snr, back_snr, fwd_ns, inv_ns,
+           fwd_snr >= types[type].min_snr ? "" : "  FAIL");
+    return fwd_snr >= types[type].min_snr ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int min_size = MIN_SIZE, max_size = FFT_MAX_SIZE;
+    struct bench b;
+    unsigned int i;
+    int type, ret = 0;
+
+    /* parse command line arguments */
+    argv += 1;
+    while (*argv) {
+        if (strcmp(*argv, "-n") == 0) {
+            argv++;
+            if (*argv)
+                min_size = max_size = atoi(*argv);
+        } else {
+            fprintf(stderr, "Usage: fftbench [-n size]\n");
+            return 1;
+        }
+        if (*argv)
+            argv++;
+    }
+
+    if (min_size < 4 || max_size > FFT_MAX_SIZE || (min_size & (min_size - 1))) {
+        fprintf(stderr, "Size must be a power of two from 4 to %u\n", FFT_MAX_SIZE);
+        return 1;
+    }
+
+    /* int32_t is the widest sample */
+    memset(&b, 0, sizeof(b));
+    b.x = malloc(max_size * sizeof(double));
+    b.ref = malloc((max_size + 2) * sizeof(double));
+    b.expect = malloc((max_size + 2) * sizeof(double));
+    b.in = malloc(max_size * sizeof(int32_t));
+    b.out = malloc((max_size + 2) * sizeof(int32_t));
+    b.spec = malloc((max_size + 2) * sizeof(int32_t));
+    b.back = malloc(max_size * sizeof(int32_t));
+    if (!b.x || !b.ref || !b.expect || !b.in || !b.out || !b.spec || !b.back) {
+        fprintf(stderr, "Unable to allocate buffers\n");
+        ret = 1;
+        goto done;
+    }
+
+    printf("radix-4 stages on %s kernels\n", fft_kernel_name());
+    printf("%-6s %5s %12s %12s %13s %13s\n", "type", "n", "forward", "round trip",
+           "forward", "inverse");
+    srand(1);
+    for (b.n = min_size; b.n <= max_size; b.n *= 2) {
+        /* on the Q15 grid, so every type transforms the same values */
+        for (i = 0; i < b.n; i++)
+            b.x[i] = (rand() % 32768 - 16384) / 32768.0;
+        b.fft = fft_init(b.n);
+        if (!b.fft || dft(b.x, b.ref, b.n) < 0) {
+            fprintf(stderr, "Unable to set up a transform of %u\n", b.n);
+            fft_free(b.fft);
+            ret = 1;
+            goto done;
+        }
+        for (type = TYPE_FLOAT; type <= TYPE_Q31; type++)
+            ret |= run(&b, type);
+        fft_free(b.fft);
+    }
+
+done:
+    free(b.x);
+    free(b.ref);
+    free(b.expect);
+    free(b.in);
+    free(b.out);
+    free(b.spec);
+    free(b.back);
+    return ret;
+}
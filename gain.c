@@ -0,0 +1,339 @@
+/* gain.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#if !defined(GAIN_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define GAIN_SSE2
+#endif
+
+#include "cpu.h"
+#include "gain.h"
+#include "gain_kernels.h"
+
+/* where exponential ramps to and from mute start and stop, -100 dB */
+#define GAIN_FLOOR  0.00001
+
+struct gain {
+    unsigned int channels;
+    unsigned int bits;
+    double cur;             /* amplitude outside ramps, and where they start */
+    double target;
+    unsigned int frames;    /* left in the ramp */
+    unsigned int lane;      /* frame of the ramp block the next frame is */
+    struct gain_lanes ramp;
+};
+
+/* Q15 and Q31 with rounding; the scalar forms take unity (1 << 15 and
+ * 1 << 31) too */
+static inline int16_t gain_mul_s16(int16_t x, int32_t q)
+{
+    return (int16_t)((x * q + (1 << 14)) >> 15);
+}
+
+static inline int32_t gain_mul_s32(int32_t x, int64_t q)
+{
+    return (int32_t)(((int64_t)x * q + (1 << 30)) >> 31);
+}
+
+/* S24 sits in the low bits: shift it up to S32 and back so the sign is kept */
+static inline int32_t gain_mul_s24(int32_t x, int64_t q)
+{
+    return gain_mul_s32((int32_t)((uint32_t)x << 8), q) >> 8;
+}
+
+#if defined(GAIN_SSE2)
+/* SSE2 has no signed 32 bit multiply, so S32 and S24 stay scalar there */
+static inline __m128i gain_mul_s16_sse2(__m128i x, __m128i vq)
+{
+    __m128i round = _mm_set1_epi32(1 << 14);
+    __m128i lo = _mm_mullo_epi16(x, vq), hi = _mm_mulhi_epi16(x, vq);
+    __m128i p0 = _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round);
+    __m128i p1 = _mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round);
+
+    return _mm_packs_epi32(_mm_srai_epi32(p0, 15), _mm_srai_epi32(p1, 15));
+}
+
+static unsigned int gain_s16_sse2(int16_t *dst, const int16_t *src, unsigned int n,
+                                  int32_t q)
+{
+    __m128i vq = _mm_set1_epi16(q);
+    unsigned int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), gain_mul_s16_sse2(x, vq));
+    }
+    return i;
+}
+
+static unsigned int gain_ramp_s16_sse2(int16_t *dst, const int16_t *src,
+                                       unsigned int channels, unsigned int blocks,
+                                       struct gain_lanes *l)
+{
+    __m128 lane0 = _mm_loadu_ps(l->lane), lane1 = _mm_loadu_ps(l->lane + 4);
+    __m128 scale = _mm_set1_ps(32768.0f), half = _mm_set1_ps(0.5f);
+    unsigned int b, i = 0;
+
+    if (channels != 1 && channels != 2)
+        return 0;
+
+    for (b = 0; b < blocks; b++) {
+        __m128 a = _mm_set1_ps((float)l->cur);
+        __m128 g0 = l->exponential ? _mm_mul_ps(a, lane0) : _mm_add_ps(a, lane0);
+        __m128 g1 = l->exponential ? _mm_mul_ps(a, lane1) : _mm_add_ps(a, lane1);
+        __m128i q0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g0, scale), half));
+        __m128i q1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g1, scale), half));
+        /* packs saturates unity to INT16_MAX, like gain_q15() */
+        __m128i q = _mm_packs_epi32(q0, q1);
+
+        if (channels == 1) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), gain_mul_s16_sse2(x, q));
+            i += 8;
+        } else {
+            __m128i x0 = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i x1 = _mm_loadu_si128((const __m128i *)(src + i + 8));
+            _mm_storeu_si128((__m128i *)(dst + i),
+                             gain_mul_s16_sse2(x0, _mm_unpacklo_epi16(q, q)));
+            _mm_storeu_si128((__m128i *)(dst + i + 8),
+                             gain_mul_s16_sse2(x1, _mm_unpackhi_epi16(q, q)));
+            i += 16;
+        }
+        gain_next_block(l);
+    }
+    return blocks;
+}
+
+static const struct gain_kernels gain_sse2_kernels = {
+    "sse2",
+    gain_s16_sse2,
+    NULL,
+    gain_ramp_s16_sse2,
+    NULL,
+};
+#endif
+
+static const struct gain_kernels gain_no_kernels = { "scalar", NULL, NULL, NULL, NULL };
+static const struct gain_kernels *gain_simd = &gain_no_kernels;
+
+/* picked once at load, before anything can call in */
+static void __attribute__((constructor)) gain_select(void)
+{
+#if defined(GAIN_SSE2)
+    gain_simd = &gain_sse2_kernels;
+#elif !defined(GAIN_NO_SIMD)
+    if (cpu_has_neon())
+        gain_simd = &gain_neon_kernels;
+#endif
+}
+
+const char *gain_kernel_name(void)
+{
+    return gain_simd->name;
+}
+
+struct gain *gain_init(unsigned int channels, unsigned int bits)
+{
+    struct gain *g;
+
+    if (!channels || (bits != 16 && bits != 24 && bits != 32))
+        return NULL;
+
+    g = calloc(1, sizeof(*g));
+    if (!g)
+        return NULL;
+
+    g->channels = channels;
+    g->bits = bits;
+    g->cur = g->target = 1.0;
+    return g;
+}
+
+void gain_free(struct gain *g)
+{
+    free(g);
+}
+
+void gain_set(struct gain *g, int db, unsigned int frames, enum gain_curve curve)
+{
+    double amp, step;
+    unsigned int k;
+
+    if (db <= GAIN_MUTE)
+        amp = 0.0;
+    else if (db >= 0)
+        amp = 1.0;
+    else
+        amp = pow(10.0, db / 2000.0);
+
+    /* a ramp cut short hands on the gain it got to */
+    if (g->frames)
+        g->cur = gain_lane(&g->ramp, g->lane);
+
+    g->target = amp;
+    g->lane = 0;
+    if (!frames || amp == g->cur) {
+        g->cur = amp;
+        g->frames = 0;
+        return;
+    }
+
+    g->ramp.exponential = curve == GAIN_EXPONENTIAL;
+    if (g->ramp.exponential) {
+        if (g->cur < GAIN_FLOOR)
+            g->cur = GAIN_FLOOR;
+        step = pow((amp < GAIN_FLOOR ? GAIN_FLOOR : amp) / g->cur, 1.0 / frames);
+        for (k = 0; k < GAIN_BLOCK; k++)
+            g->ramp.lane[k] = (float)pow(step, k);
+        g->ramp.block_step = pow(step, GAIN_BLOCK);
+    } else {
+        step = (amp - g->cur) / frames;
+        for (k = 0; k < GAIN_BLOCK; k++)
+            g->ramp.lane[k] = (float)(k * step);
+        g->ramp.block_step = GAIN_BLOCK * step;
+    }
+    g->ramp.cur = g->cur;
+    g->frames = frames;
+}
+
+unsigned int gain_get_ramp_frames(struct gain *g)
+{
+    return g->frames;
+}
+
+int gain_is_unity(struct gain *g)
+{
+    return !g->frames && g->cur >= 1.0;
+}
+
+/* the gain moves every frame: whole blocks go to the kernels, the frames
+ * around them one at a time */
+static unsigned int gain_ramp(struct gain *g, void *dst, const void *src,
+                              unsigned int frames)
+{
+    unsigned int n = frames < g->frames ? frames : g->frames;
+    unsigned int f = 0, c, b, i = 0;
+
+    while (f < n) {
+        if (!g->lane && n - f >= GAIN_BLOCK) {
+            b = 0;
+            if (g->bits == 16 && gain_simd->ramp_s16)
+                b = gain_simd->ramp_s16((int16_t *)dst + i, (const int16_t *)src + i,
+                                        g->channels, (n - f) / GAIN_BLOCK, &g->ramp);
+            else if (g->bits != 16 && gain_simd->ramp_s32)
+                b = gain_simd->ramp_s32((int32_t *)dst + i, (const int32_t *)src + i,
+                                        g->channels, g->bits, (n - f) / GAIN_BLOCK,
+                                        &g->ramp);
+            f += b * GAIN_BLOCK;
+            i += b * GAIN_BLOCK * g->channels;
+        }
+
+        /* up to the end of the block */
+        while (f < n) {
+            float gain = gain_lane(&g->ramp, g->lane);
+
+            if (g->bits == 16) {
+                int32_t q = gain_q15(gain);
+
+                for (c = 0; c < g->channels; c++, i++)
+                    ((int16_t *)dst)[i] = gain_mul_s16(((const int16_t *)src)[i], q);
+            } else {
+                int32_t q = gain_q31(gain);
+
+                for (c = 0; c < g->channels; c++, i++) {
+                    int32_t x = ((const int32_t *)src)[i];
+                    ((int32_t *)dst)[i] = g->bits == 24 ? gain_mul_s24(x, q) : gain_mul_s32(x, q);
+                }
+            }
+
+            f++;
+            if (++g->lane == GAIN_BLOCK) {
+                g->lane = 0;
+                gain_next_block(&g->ramp);
+                break;
+            }
+        }
+    }
+
+    g->frames -= n;
+    if (!g->frames) {
+        g->cur = g->target;
+        g->lane = 0;
+    }
+    return n;
+}
+
+void gain_apply(struct gain *g, void *dst, const void *src, unsigned int frames)
+{
+    unsigned int bytes = g->bits == 16 ? 2 : 4;
+    unsigned int n, i = 0;
+
+    if (g->frames) {
+        n = gain_ramp(g, dst, src, frames);
+        dst = (char *)dst + n * g->channels * bytes;
+        src = (const char *)src + n * g->channels * bytes;
+        frames -= n;
+    }
+    if (!frames)
+        return;
+
+    n = frames * g->channels;
+    if (g->cur >= 1.0) {
+        if (dst != src)
+            memcpy(dst, src, n * bytes);
+    } else if (g->cur <= 0.0) {
+        memset(dst, 0, n * bytes);
+    } else if (g->bits == 16) {
+        int32_t q = (int32_t)(g->cur * 32768.0 + 0.5);
+
+        if (q > INT16_MAX)
+            q = INT16_MAX;
+        if (gain_simd->s16)
+            i = gain_simd->s16(dst, src, n, q);
+        for (; i < n; i++)
+            ((int16_t *)dst)[i] = gain_mul_s16(((const int16_t *)src)[i], q);
+    } else {
+        int64_t q64 = (int64_t)(g->cur * 2147483648.0 + 0.5);
+        int32_t q = q64 > INT32_MAX ? INT32_MAX : (int32_t)q64;
+
+        if (gain_simd->s32)
+            i = gain_simd->s32(dst, src, n, q, g->bits);
+        if (g->bits == 24) {
+            for (; i < n; i++)
+                ((int32_t *)dst)[i] = gain_mul_s24(((const int32_t *)src)[i], q);
+        } else {
+            for (; i < n; i++)
+                ((int32_t *)dst)[i] = gain_mul_s32(((const int32_t *)src)[i], q);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/* gain.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef GAIN_H
+#define GAIN_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Software gain for the playback path.
+ *
+ * Scales interleaved S16, S24 (in 32 bits) or S32 frames by a gain from mute
+ * to unity, in 1/100 dB. Gain changes ramp frame by frame over the given
+ * number of frames, either linearly in amplitude or linearly in dB; the
+ * exponential curve starts and ends mute ramps at -100 dB. Ramp gains are
+ * worked out in float for blocks of eight frames from a double anchor, so
+ * mono and stereo ramps run on the same SIMD kernels as a steady gain:
+ * SSE2 on x86, NEON on ARM cores that have it (gain_neon.c, chosen at run
+ * time). S32 and S24 on SSE2 stay scalar, it has no signed 32 bit
+ * multiply. Results are the same with and without SIMD.
+ */
+
+#define GAIN_MUTE   -9999999
+
+enum gain_curve {
+    GAIN_LINEAR,
+    GAIN_EXPONENTIAL,
+};
+
+struct gain;
+
+/* bits: 16, 24 or 32 */
+struct gain *gain_init(unsigned int channels, unsigned int bits);
+void gain_free(struct gain *g);
+
+/* ramp to db (<= 0) over frames, starting from wherever the last ramp got */
+void gain_set(struct gain *g, int db, unsigned int frames, enum gain_curve curve);
+/* frames left in the current ramp */
+unsigned int gain_get_ramp_frames(struct gain *g);
+/* steady at unity, so callers can skip gain_apply() */
+int gain_is_unity(struct gain *g);
+
+/* dst may equal src */
+void gain_apply(struct gain *g, void *dst, const void *src, unsigned int frames);
+
+/* "neon", "sse2" or "scalar" */
+const char *gain_kernel_name(void);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
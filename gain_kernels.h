@@ -0,0 +1,103 @@
+/* gain_kernels.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef GAIN_KERNELS_H
+#define GAIN_KERNELS_H
+
+#include <stdint.h>
+
+/* frames per ramp block, two vectors of float gains */
+#define GAIN_BLOCK  8
+
+/*
+ * A ramp as the kernels see it. Frame k of a block gets the float gain
+ * cur * lane[k] on the exponential curve or cur + lane[k] on the linear
+ * one, and cur moves on by block_step, in double, after every block so
+ * float error does not build up over a long ramp. The scalar ramp works
+ * out its gains the same way, so the kernels match it to the bit.
+ */
+struct gain_lanes {
+    double cur;
+    double block_step;
+    int exponential;
+    float lane[GAIN_BLOCK];
+};
+
+static inline float gain_lane(const struct gain_lanes *l, unsigned int k)
+{
+    float a = (float)l->cur;
+
+    return l->exponential ? a * l->lane[k] : a + l->lane[k];
+}
+
+static inline void gain_next_block(struct gain_lanes *l)
+{
+    if (l->exponential)
+        l->cur *= l->block_step;
+    else
+        l->cur += l->block_step;
+}
+
+/* ramp gains in Q15 and Q31, truncated after adding a half and saturated
+ * at unity like the vector conversions and narrowing do */
+static inline int32_t gain_q15(float g)
+{
+    float v = g * 32768.0f + 0.5f;
+
+    return v >= 32768.0f ? INT16_MAX : (int32_t)v;
+}
+
+static inline int32_t gain_q31(float g)
+{
+    float v = g * 2147483648.0f + 0.5f;
+
+    return v >= 2147483648.0f ? INT32_MAX : (int32_t)v;
+}
+
+/*
+ * SIMD kernels behind gain_apply(). The steady ones do the samples they
+ * can in whole vectors and return how many; the ramp ones do up to blocks
+ * whole blocks of mono or stereo frames, moving the lanes on, and return
+ * how many blocks. A NULL entry does none and leaves it all to the scalar
+ * loops.
+ */
+struct gain_kernels {
+    const char *name;
+    unsigned int (*s16)(int16_t *dst, const int16_t *src, unsigned int n, int32_t q);
+    unsigned int (*s32)(int32_t *dst, const int32_t *src, unsigned int n, int32_t q,
+                        unsigned int bits);
+    unsigned int (*ramp_s16)(int16_t *dst, const int16_t *src, unsigned int channels,
+                             unsigned int blocks, struct gain_lanes *l);
+    unsigned int (*ramp_s32)(int32_t *dst, const int32_t *src, unsigned int channels,
+                             unsigned int bits, unsigned int blocks, struct gain_lanes *l);
+};
+
+/* gain_neon.c, all NULL unless it was built with NEON enabled */
+extern const struct gain_kernels gain_neon_kernels;
+
+#endif
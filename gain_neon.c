@@ -0,0 +1,161 @@
+/* gain_neon.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdint.h>
+
+#include "gain_kernels.h"
+
+/*
+ * NEON kernels for gain.c, built with -mfpu=neon and called only when the
+ * cpu has NEON (see cpu.h). vqrdmulh is the rounding Q15/Q31 multiply of
+ * the scalar code as long as the gain stays below unity, which the Q
+ * conversions make sure of. Without NEON to build for, the table is empty
+ * and gain.c stays scalar.
+ */
+
+#if !defined(GAIN_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+
+/* S24 sits in the low bits: shift it up to S32 and back so the sign is kept */
+static inline int32x4_t gain_mul_s32_neon(int32x4_t x, int32x4_t q, unsigned int bits)
+{
+    if (bits == 24)
+        return vshlq_s32(vqrdmulhq_s32(vshlq_s32(x, vdupq_n_s32(8)), q), vdupq_n_s32(-8));
+    return vqrdmulhq_s32(x, q);
+}
+
+/* the gains of one block, scaled to Q15 or Q31 */
+static inline void gain_block_neon(const struct gain_lanes *l, float32x4_t scale,
+                                   int32x4_t q[2])
+{
+    float32x4_t a = vdupq_n_f32((float)l->cur), half = vdupq_n_f32(0.5f);
+    unsigned int k;
+
+    for (k = 0; k < 2; k++) {
+        float32x4_t lane = vld1q_f32(l->lane + 4 * k);
+        float32x4_t g = l->exponential ? vmulq_f32(a, lane) : vaddq_f32(a, lane);
+
+        q[k] = vcvtq_s32_f32(vaddq_f32(vmulq_f32(g, scale), half));
+    }
+}
+
+static unsigned int gain_s16_neon(int16_t *dst, const int16_t *src, unsigned int n,
+                                  int32_t q)
+{
+    int16x8_t vq = vdupq_n_s16(q);
+    unsigned int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(dst + i, vqrdmulhq_s16(vld1q_s16(src + i), vq));
+    return i;
+}
+
+static unsigned int gain_s32_neon(int32_t *dst, const int32_t *src, unsigned int n,
+                                  int32_t q, unsigned int bits)
+{
+    int32x4_t vq = vdupq_n_s32(q);
+    unsigned int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        vst1q_s32(dst + i, gain_mul_s32_neon(vld1q_s32(src + i), vq, bits));
+    return i;
+}
+
+static unsigned int gain_ramp_s16_neon(int16_t *dst, const int16_t *src,
+                                       unsigned int channels, unsigned int blocks,
+                                       struct gain_lanes *l)
+{
+    float32x4_t scale = vdupq_n_f32(32768.0f);
+    unsigned int b, i = 0;
+
+    if (channels != 1 && channels != 2)
+        return 0;
+
+    for (b = 0; b < blocks; b++) {
+        int32x4_t q32[2];
+        int16x8_t q;
+
+        gain_block_neon(l, scale, q32);
+        q = vcombine_s16(vqmovn_s32(q32[0]), vqmovn_s32(q32[1]));
+        if (channels == 1) {
+            vst1q_s16(dst + i, vqrdmulhq_s16(vld1q_s16(src + i), q));
+            i += 8;
+        } else {
+            int16x8x2_t qq = vzipq_s16(q, q);
+
+            vst1q_s16(dst + i, vqrdmulhq_s16(vld1q_s16(src + i), qq.val[0]));
+            vst1q_s16(dst + i + 8, vqrdmulhq_s16(vld1q_s16(src + i + 8), qq.val[1]));
+            i += 16;
+        }
+        gain_next_block(l);
+    }
+    return blocks;
+}
+
+static unsigned int gain_ramp_s32_neon(int32_t *dst, const int32_t *src,
+                                       unsigned int channels, unsigned int bits,
+                                       unsigned int blocks, struct gain_lanes *l)
+{
+    float32x4_t scale = vdupq_n_f32(2147483648.0f);
+    unsigned int b, k, i = 0;
+
+    if (channels != 1 && channels != 2)
+        return 0;
+
+    for (b = 0; b < blocks; b++) {
+        int32x4_t q[2];
+
+        gain_block_neon(l, scale, q);
+        for (k = 0; k < 2; k++) {
+            if (channels == 1) {
+                vst1q_s32(dst + i, gain_mul_s32_neon(vld1q_s32(src + i), q[k], bits));
+                i += 4;
+            } else {
+                int32x4x2_t qq = vzipq_s32(q[k], q[k]);
+
+                vst1q_s32(dst + i, gain_mul_s32_neon(vld1q_s32(src + i), qq.val[0], bits));
+                vst1q_s32(dst + i + 4,
+                          gain_mul_s32_neon(vld1q_s32(src + i + 4), qq.val[1], bits));
+                i += 8;
+            }
+        }
+        gain_next_block(l);
+    }
+    return blocks;
+}
+
+const struct gain_kernels gain_neon_kernels = {
+    "neon",
+    gain_s16_neon,
+    gain_s32_neon,
+    gain_ramp_s16_neon,
+    gain_ramp_s32_neon,
+};
+#else
+const struct gain_kernels gain_neon_kernels;
+#endif
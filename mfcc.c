@@ -0,0 +1,258 @@
+/* mfcc.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mfcc.h"
+#include "fft.h"
+
+#define MFCC_FRAME_MS   32
+#define MFCC_LOG_FLOOR  1.0f    /* keeps digital silence at 0 */
+
+struct mel_band {
+    unsigned int start;     /* first bin */
+    unsigned int len;
+    const float *weight;
+};
+
+struct mfcc {
+    unsigned int rate;
+    unsigned int frame;
+    unsigned int hop;
+    unsigned int mel_bands;
+    unsigned int num_ceps;
+    struct stft *stft;
+    struct mel_band *band;
+    float *weights;         /* triangles of all bands */
+    float *dct;             /* num_ceps x mel_bands */
+    float *in;              /* hop of input being collected */
+    float *spec;
+    float *logmel;
+    int16_t *vec;
+    unsigned int pos;
+};
+
+static float hz_to_mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+static inline int16_t mfcc_quantize(float v)
+{
+    long q = lrintf(v * (1 << MFCC_FRAC_BITS));
+
+    if (q > INT16_MAX)
+        return INT16_MAX;
+    if (q < INT16_MIN)
+        return INT16_MIN;
+    return q;
+}
+
+/* triangles spaced evenly on the mel scale between MFCC_LOW_HZ and
+ * Nyquist, each peaking at 1 */
+static int mfcc_init_mel(struct mfcc *mf)
+{
+    unsigned int bins = mf->frame / 2 + 1;
+    float lo = hz_to_mel(MFCC_LOW_HZ), hi = hz_to_mel(mf->rate / 2.0f);
+    float bin_hz = (float)mf->rate / mf->frame;
+    float *edge, *w;
+    unsigned int b, k, total = 0;
+
+    mf->band = calloc(mf->mel_bands, sizeof(*mf->band));
+    edge = calloc(mf->mel_bands + 2, sizeof(float));
+    if (!mf->band || !edge)
+        goto fail;
+
+    for (b = 0; b < mf->mel_bands + 2; b++)
+        edge[b] = mel_to_hz(lo + (hi - lo) * b / (mf->mel_bands + 1));
+
+    for (b = 0; b < mf->mel_bands; b++) {
+        struct mel_band *band = &mf->band[b];
+
+        band->start = ceilf(edge[b] / bin_hz);
+        for (k = band->start; k < bins && k * bin_hz < edge[b + 2]; k++)
+            band->len++;
+        total += band->len;
+    }
+
+    mf->weights = calloc(total + 1, sizeof(float));
+    if (!mf->weights)
+        goto fail;
+
+    w = mf->weights;
+    for (b = 0; b < mf->mel_bands; b++) {
+        struct mel_band *band = &mf->band[b];
+        float left = edge[b], centre = edge[b + 1], right = edge[b + 2];
+
+        band->weight = w;
+        for (k = band->start; k < band->start + band->len; k++) {
+            float f = k * bin_hz;
+
+            *w++ = f <= centre ? (f - left) / (centre - left) :
+                (right - f) / (right - centre);
+        }
+    }
+
+    free(edge);
+    return 0;
+
+fail:
+    free(edge);
+    return -1;
+}
+
+struct mfcc *mfcc_init(unsigned int rate, unsigned int mel_bands,
+                       unsigned int num_ceps)
+{
+    struct mfcc *mf;
+    unsigned int c, b;
+
+    if (!rate || !mel_bands || num_ceps > mel_bands)
+        return NULL;
+
+    mf = calloc(1, sizeof(*mf));
+    if (!mf)
+        return NULL;
+
+    mf->rate = rate;
+    mf->mel_bands = mel_bands;
+    mf->num_ceps = num_ceps;
+    /* power of two frame closest to MFCC_FRAME_MS */
+    for (mf->frame = 64; mf->frame * 1000 / rate < MFCC_FRAME_MS &&
+         mf->frame < FFT_MAX_SIZE; mf->frame <<= 1)
+        ;
+    mf->hop = mf->frame / 4;
+
+    mf->stft = stft_init(mf->frame, mf->hop);
+    mf->dct = calloc(num_ceps * mel_bands + 1, sizeof(float));
+    mf->in = calloc(mf->hop, sizeof(float));
+    mf->spec = calloc(mf->frame + 2, sizeof(float));
+    mf->logmel = calloc(mel_bands, sizeof(float));
+    mf->vec = calloc(mel_bands + num_ceps, sizeof(int16_t));
+    if (!mf->stft || !mf->dct || !mf->in || !mf->spec || !mf->logmel || !mf->vec ||
+        mfcc_init_mel(mf) < 0) {
+        mfcc_free(mf);
+        return NULL;
+    }
+
+    for (c = 0; c < num_ceps; c++)
+        for (b = 0; b < mel_bands; b++)
+            mf->dct[c * mel_bands + b] = sqrtf((c ? 2.0f : 1.0f) / mel_bands) *
+                cosf(M_PI * c * (b + 0.5f) / mel_bands);
+
+    return mf;
+}
+
+void mfcc_free(struct mfcc *mf)
+{
+    if (!mf)
+        return;
+
+    stft_free(mf->stft);
+    free(mf->band);
+    free(mf->weights);
+    free(mf->dct);
+    free(mf->in);
+    free(mf->spec);
+    free(mf->logmel);
+    free(mf->vec);
+    free(mf);
+}
+
+void mfcc_reset(struct mfcc *mf)
+{
+    stft_reset(mf->stft);
+    mf->pos = 0;
+}
+
+void mfcc_get_header(struct mfcc *mf, struct mfcc_header *header)
+{
+    header->magic = MFCC_MAGIC;
+    header->version = MFCC_VERSION;
+    header->frac_bits = MFCC_FRAC_BITS;
+    header->mel_bands = mf->mel_bands;
+    header->num_ceps = mf->num_ceps;
+    header->rate = mf->rate;
+    header->frame = mf->frame;
+    header->hop = mf->hop;
+    header->count = 0;
+}
+
+static void mfcc_frame(struct mfcc *mf, mfcc_cb cb, void *arg)
+{
+    float *spec = mf->spec;
+    unsigned int b, c, k;
+
+    stft_analyze(mf->stft, mf->in, spec);
+
+    /* power spectrum in place over the re slots */
+    for (k = 0; k <= mf->frame / 2; k++)
+        spec[k] = spec[2 * k] * spec[2 * k] + spec[2 * k + 1] * spec[2 * k + 1];
+
+    for (b = 0; b < mf->mel_bands; b++) {
+        const struct mel_band *band = &mf->band[b];
+        float e = MFCC_LOG_FLOOR;
+
+        for (k = 0; k < band->len; k++)
+            e += band->weight[k] * spec[band->start + k];
+        mf->logmel[b] = logf(e);
+        mf->vec[b] = mfcc_quantize(mf->logmel[b]);
+    }
+
+    for (c = 0; c < mf->num_ceps; c++) {
+        const float *d = mf->dct + c * mf->mel_bands;
+        float v = 0;
+
+        for (b = 0; b < mf->mel_bands; b++)
+            v += d[b] * mf->logmel[b];
+        mf->vec[mf->mel_bands + c] = mfcc_quantize(v);
+    }
+
+    cb(arg, mf->vec, mf->mel_bands + mf->num_ceps);
+}
+
+void mfcc_process(struct mfcc *mf, const int16_t *data, unsigned int frames,
+                  unsigned int channels, mfcc_cb cb, void *arg)
+{
+    unsigned int i;
+
+    for (i = 0; i < frames; i++, data += channels) {
+        mf->in[mf->pos] = *data;
+        if (++mf->pos == mf->hop) {
+            mfcc_frame(mf, cb, arg);
+            mf->pos = 0;
+        }
+    }
+}
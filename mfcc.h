@@ -0,0 +1,91 @@
+/* mfcc.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef MFCC_H
+#define MFCC_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Log-mel filterbank and MFCC extraction at capture time.
+ *
+ * Mono S16 audio is pushed as it arrives; every hop (a quarter of a ~32 ms
+ * STFT frame) produces one vector of mel_bands natural log filterbank
+ * energies followed by num_ceps MFCCs (orthonormal DCT-II of the log
+ * energies, c0 first), in fixed point with MFCC_FRAC_BITS fraction
+ * bits. Vector i covers the frame that ends with sample (i + 1) * hop since
+ * the last mfcc_reset(). All state is allocated in mfcc_init().
+ */
+
+#define MFCC_MEL_BANDS  40
+#define MFCC_NUM_CEPS   13
+#define MFCC_FRAC_BITS  6
+#define MFCC_LOW_HZ     20
+
+/* Sidecar file layout: this header, then count vectors of dims int16_t,
+ * all little endian. */
+#define MFCC_MAGIC      0x4343464d  /* "MFCC" */
+#define MFCC_VERSION    1
+
+struct mfcc_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t frac_bits;
+    uint16_t mel_bands;
+    uint16_t num_ceps;
+    uint32_t rate;
+    uint32_t frame;     /* STFT frame in samples */
+    uint32_t hop;       /* samples per vector */
+    uint32_t count;     /* vectors in the file */
+};
+
+struct mfcc;
+
+/* called once per hop with mel_bands + num_ceps values */
+typedef void (*mfcc_cb)(void *arg, const int16_t *vec, unsigned int dims);
+
+struct mfcc *mfcc_init(unsigned int rate, unsigned int mel_bands,
+                       unsigned int num_ceps);
+void mfcc_free(struct mfcc *mf);
+void mfcc_reset(struct mfcc *mf);
+/* fill in everything but count */
+void mfcc_get_header(struct mfcc *mf, struct mfcc_header *header);
+
+/* push frames of interleaved S16, only channel 0 is analysed */
+void mfcc_process(struct mfcc *mf, const int16_t *data, unsigned int frames,
+                  unsigned int channels, mfcc_cb cb, void *arg);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
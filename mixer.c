@@ -33,6 +33,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
 
 #include <sys/ioctl.h>
 
@@ -44,57 +48,280 @@
 
 #include "asoundlib.h"
 
+/*
+ * mixer_open() only lists the controls: their ids, names included, come
+ * with the list. The rest of the info and the enum item names are read from
+ * the driver the first time a control is used, and the names are kept in
+ * the mixer's string pool rather than strdup()ed one by one.
+ *
+ * Everything sized by the control list (the mixer itself, the controls,
+ * their info, the name index and the first pool chunk) is one allocation,
+ * laid out by mixer_arena_layout(). The first pool chunk doubles as the
+ * id buffer for ELEM_LIST while opening. Only enum names that outgrow it
+ * take further chunks.
+ *
+ * Values read or written are cached per control, so reads and the read
+ * half of read-modify-write setters go to the driver only once. The mixer
+ * subscribes to control events and drops the cache of every control the
+ * driver reports changed before any cached value is used. Its own writes
+ * come back as events too: a write reads the events right away and keeps
+ * its values when the only one for the control is its own echo. That costs
+ * two poll()s and a read() per write, plus an ELEM_READ when there was no
+ * cache to say whether the write changed anything, and every cached read
+ * still polls for events. Volatile controls, and all controls if the
+ * subscription fails, are not cached.
+ * Since that consumes the events, the ones callers asked for with
+ * mixer_subscribe_events() are decoded into a queue on the way.
+ */
+
+#define MIXER_EVENT_QUEUE   64
+
+/* TLV types from the kernel's sound/tlv.h, which older headers lack */
+#define MIXER_TLV_DB_SCALE          1
+#define MIXER_TLV_DB_LINEAR         2
+#define MIXER_TLV_DB_RANGE          3
+#define MIXER_TLV_DB_MINMAX         4
+#define MIXER_TLV_DB_MINMAX_MUTE    5
+#define MIXER_TLV_DB_SCALE_MUTE     0x10000
+#define MIXER_TLV_WORDS             256
+
+/* controls with more steps than this convert to and from dB without a table */
+#define MIXER_DB_TABLE_MAX          4096
+
+#define MIXER_MAX_RAMPS             16
+#define MIXER_RAMP_STEP_MS          10
+
 struct mixer_ctl {
     struct mixer *mixer;
     struct snd_ctl_elem_info *info;
+    int info_ready;
     char **ename;
+    void *cache;        /* the values part of struct snd_ctl_elem_value */
+    int cache_valid;
+    unsigned int value_events;  /* seen since mixer_ctl_write() zeroed it */
+    unsigned int *tlv;  /* dB TLV, tlv[0] == 0 when there is none */
+    int *db_table;      /* dB of every raw value from the min */
+};
+
+/* the dB scale of an integer control */
+struct mixer_db_scale {
+    const unsigned int *tlv;
+    const int *table;   /* dB of every raw value from min, or NULL */
+    int min;
+    int max;
+};
+
+/* A volume change in progress on the ramp thread. It keeps its own copy of
+ * the scale, which lives in the pool, so it never looks at ctl state the
+ * caller may invalidate meanwhile. */
+struct mixer_ramp {
+    struct mixer_ctl *ctl;
+    struct mixer_db_scale scale;
+    unsigned int numid;
+    unsigned int count;
+    int from;           /* 1/100 dB */
+    int to;
+    struct timespec start;
+    unsigned int duration_ms;
+    int last_raw;
 };
 
+#define MIXER_POOL_CHUNK    4096
+
+struct mixer_pool {
+    struct mixer_pool *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/* name lookups match on the name and, optionally, on these */
+#define MIXER_MATCH_INDEX   0x1
+#define MIXER_MATCH_DEVICE  0x2     /* iface, device and subdevice */
+
 struct mixer {
     int fd;
     struct snd_ctl_card_info card_info;
     struct snd_ctl_elem_info *elem_info;
     struct mixer_ctl *ctl;
     unsigned int count;
+
+    /* open addressing table of control numbers + 1 hashed by name, 0 is
+     * empty. Linear probing keeps controls of the same name in order. */
+    unsigned int *name_index;
+    unsigned int name_index_mask;
+
+    struct mixer_pool *pool;
+    struct mixer_pool *arena_pool;  /* the chunk inside the arena */
+
+    int subscribed;
+
+    /* events for mixer_read_event() */
+    int deliver_events;
+    struct mixer_event events[MIXER_EVENT_QUEUE];
+    unsigned int event_head;
+    unsigned int event_count;
+    int events_lost;
+
+    /* ramps run on their own thread, started on the first one */
+    pthread_mutex_t ramp_lock;
+    pthread_cond_t ramp_cond;
+    pthread_t ramp_thread;
+    int ramp_thread_running;
+    int ramp_quit;
+    struct mixer_ramp ramps[MIXER_MAX_RAMPS];
+    unsigned int ramp_count;
+};
+
+struct mixer_arena {
+    size_t ctl;
+    size_t elem_info;
+    size_t name_index;
+    unsigned int name_index_size;
+    size_t pool;
+    size_t pool_size;
+    size_t size;
 };
 
 void mixer_close(struct mixer *mixer)
 {
-    unsigned int n,m;
+    struct mixer_pool *pool;
 
     if (!mixer)
         return;
 
+    if (mixer->ramp_thread_running) {
+        pthread_mutex_lock(&mixer->ramp_lock);
+        mixer->ramp_quit = 1;
+        pthread_cond_broadcast(&mixer->ramp_cond);
+        pthread_mutex_unlock(&mixer->ramp_lock);
+        pthread_join(mixer->ramp_thread, NULL);
+    }
+    pthread_mutex_destroy(&mixer->ramp_lock);
+    pthread_cond_destroy(&mixer->ramp_cond);
+
     if (mixer->fd >= 0)
         close(mixer->fd);
 
-    if (mixer->ctl) {
-        for (n = 0; n < mixer->count; n++) {
-            if (mixer->ctl[n].ename) {
-                unsigned int max = mixer->ctl[n].info->value.enumerated.items;
-                for (m = 0; m < max; m++)
-                    free(mixer->ctl[n].ename[m]);
-                free(mixer->ctl[n].ename);
-            }
-        }
-        free(mixer->ctl);
+    while ((pool = mixer->pool) != mixer->arena_pool) {
+        mixer->pool = pool->next;
+        free(pool);
     }
 
-    if (mixer->elem_info)
-        free(mixer->elem_info);
-
     free(mixer);
+}
 
-    /* TODO: verify frees */
+/* bump allocation from the string pool, freed only by mixer_close() */
+static void *mixer_pool_alloc(struct mixer *mixer, size_t size)
+{
+    struct mixer_pool *pool = mixer->pool;
+    size_t chunk;
+
+    size = (size + 7) & ~(size_t)7;
+    if (!pool || pool->size - pool->used < size) {
+        chunk = size > MIXER_POOL_CHUNK ? size : MIXER_POOL_CHUNK;
+        pool = malloc(sizeof(*pool) + chunk);
+        if (!pool)
+            return NULL;
+        pool->size = chunk;
+        pool->used = 0;
+        pool->next = mixer->pool;
+        mixer->pool = pool;
+    }
+
+    pool->used += size;
+    return pool->data + pool->used - size;
+}
+
+/* FNV-1a */
+static unsigned int mixer_hash_name(const char *name)
+{
+    unsigned int hash = 2166136261U;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static void mixer_build_index(struct mixer *mixer)
+{
+    unsigned int n, slot;
+
+    for (n = 0; n < mixer->count; n++) {
+        slot = mixer_hash_name((char *)mixer->elem_info[n].id.name);
+        for (slot &= mixer->name_index_mask; mixer->name_index[slot];
+             slot = (slot + 1) & mixer->name_index_mask)
+            ;
+        mixer->name_index[slot] = n + 1;
+    }
+}
+
+static size_t mixer_arena_align(size_t offset)
+{
+    return (offset + 15) & ~(size_t)15;
+}
+
+static void mixer_arena_layout(struct mixer_arena *arena, unsigned int count)
+{
+    size_t offset;
+
+    /* keep the name index load factor at or below one half */
+    for (arena->name_index_size = 16; arena->name_index_size < 2 * count;
+         arena->name_index_size <<= 1)
+        ;
+
+    /* big enough for the ids of every control while opening */
+    arena->pool_size = count * sizeof(struct snd_ctl_elem_id);
+    if (arena->pool_size < MIXER_POOL_CHUNK)
+        arena->pool_size = MIXER_POOL_CHUNK;
+
+    offset = mixer_arena_align(sizeof(struct mixer));
+    arena->ctl = offset;
+    offset = mixer_arena_align(offset + count * sizeof(struct mixer_ctl));
+    arena->elem_info = offset;
+    offset = mixer_arena_align(offset + count * sizeof(struct snd_ctl_elem_info));
+    arena->name_index = offset;
+    offset = mixer_arena_align(offset + arena->name_index_size * sizeof(unsigned int));
+    arena->pool = offset;
+    arena->size = offset + sizeof(struct mixer_pool) + arena->pool_size;
+}
+
+static struct mixer_ctl *mixer_lookup(struct mixer *mixer, const char *name,
+                                      const struct snd_ctl_elem_id *id,
+                                      unsigned int match)
+{
+    unsigned int slot, n;
+
+    if (!mixer || !name)
+        return NULL;
+
+    slot = mixer_hash_name(name) & mixer->name_index_mask;
+    for (; (n = mixer->name_index[slot]); slot = (slot + 1) & mixer->name_index_mask) {
+        struct snd_ctl_elem_id *eid = &mixer->elem_info[n - 1].id;
+
+        if (strcmp(name, (char *)eid->name))
+            continue;
+        if ((match & MIXER_MATCH_INDEX) && eid->index != id->index)
+            continue;
+        if ((match & MIXER_MATCH_DEVICE) && (eid->iface != id->iface ||
+            eid->device != id->device || eid->subdevice != id->subdevice))
+            continue;
+        return mixer->ctl + n - 1;
+    }
+
+    return NULL;
 }
 
 struct mixer *mixer_open(unsigned int card)
 {
     struct snd_ctl_elem_list elist;
-    struct snd_ctl_elem_info tmp;
-    struct snd_ctl_elem_id *eid = NULL;
+    struct snd_ctl_elem_id *eid;
+    struct mixer_arena arena;
     struct mixer *mixer = NULL;
-    unsigned int n, m;
+    char *base;
+    unsigned int n;
     int fd;
     char fn[256];
 
@@ -107,61 +334,48 @@ struct mixer *mixer_open(unsigned int card)
     if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &elist) < 0)
         goto fail;
 
-    mixer = calloc(1, sizeof(*mixer));
-    if (!mixer)
+    mixer_arena_layout(&arena, elist.count);
+    base = calloc(1, arena.size);
+    if (!base)
         goto fail;
 
-    mixer->ctl = calloc(elist.count, sizeof(struct mixer_ctl));
-    mixer->elem_info = calloc(elist.count, sizeof(struct snd_ctl_elem_info));
-    if (!mixer->ctl || !mixer->elem_info)
-        goto fail;
+    mixer = (struct mixer *)base;
+    pthread_mutex_init(&mixer->ramp_lock, NULL);
+    pthread_cond_init(&mixer->ramp_cond, NULL);
+    mixer->fd = fd;
+    mixer->count = elist.count;
+    mixer->ctl = (struct mixer_ctl *)(base + arena.ctl);
+    mixer->elem_info = (struct snd_ctl_elem_info *)(base + arena.elem_info);
+    mixer->name_index = (unsigned int *)(base + arena.name_index);
+    mixer->name_index_mask = arena.name_index_size - 1;
+    mixer->arena_pool = (struct mixer_pool *)(base + arena.pool);
+    mixer->arena_pool->size = arena.pool_size;
+    mixer->pool = mixer->arena_pool;
 
     if (ioctl(fd, SNDRV_CTL_IOCTL_CARD_INFO, &mixer->card_info) < 0)
         goto fail;
 
-    eid = calloc(elist.count, sizeof(struct snd_ctl_elem_id));
-    if (!eid)
-        goto fail;
-
-    mixer->count = elist.count;
-    mixer->fd = fd;
+    /* list into the pool chunk, which is free until the first enum name */
+    eid = (struct snd_ctl_elem_id *)mixer->arena_pool->data;
     elist.space = mixer->count;
     elist.pids = eid;
     if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &elist) < 0)
         goto fail;
 
     for (n = 0; n < mixer->count; n++) {
-        struct snd_ctl_elem_info *ei = mixer->elem_info + n;
-        ei->id.numid = eid[n].numid;
-        if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_INFO, ei) < 0)
-            goto fail;
-        mixer->ctl[n].info = ei;
+        mixer->elem_info[n].id = eid[n];
+        mixer->ctl[n].info = mixer->elem_info + n;
         mixer->ctl[n].mixer = mixer;
-        if (ei->type == SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
-            char **enames = calloc(ei->value.enumerated.items, sizeof(char*));
-            if (!enames)
-                goto fail;
-            mixer->ctl[n].ename = enames;
-            for (m = 0; m < ei->value.enumerated.items; m++) {
-                memset(&tmp, 0, sizeof(tmp));
-                tmp.id.numid = ei->id.numid;
-                tmp.value.enumerated.item = m;
-                if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_INFO, &tmp) < 0)
-                    goto fail;
-                enames[m] = strdup(tmp.value.enumerated.name);
-                if (!enames[m])
-                    goto fail;
-            }
-        }
     }
 
-    free(eid);
+    mixer_build_index(mixer);
+
+    n = 1;
+    mixer->subscribed = ioctl(fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS, &n) == 0;
+
     return mixer;
 
 fail:
-    /* TODO: verify frees in failure case */
-    if (eid)
-        free(eid);
     if (mixer)
         mixer_close(mixer);
     else if (fd >= 0)
@@ -192,21 +406,256 @@ struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
 
 struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
 {
-    unsigned int n;
+    return mixer_lookup(mixer, name, NULL, 0);
+}
 
-    if (!mixer)
+struct mixer_ctl *mixer_get_ctl_by_name_and_index(struct mixer *mixer,
+                                                  const char *name,
+                                                  unsigned int index)
+{
+    struct snd_ctl_elem_id id;
+
+    memset(&id, 0, sizeof(id));
+    id.index = index;
+    return mixer_lookup(mixer, name, &id, MIXER_MATCH_INDEX);
+}
+
+struct mixer_ctl *mixer_get_ctl_by_id(struct mixer *mixer, enum mixer_ctl_iface iface,
+                                      unsigned int device, unsigned int subdevice,
+                                      const char *name, unsigned int index)
+{
+    struct snd_ctl_elem_id id;
+
+    memset(&id, 0, sizeof(id));
+    id.iface = iface;
+    id.device = device;
+    id.subdevice = subdevice;
+    id.index = index;
+    return mixer_lookup(mixer, name, &id, MIXER_MATCH_INDEX | MIXER_MATCH_DEVICE);
+}
+
+/* the control's info, read from the driver on first use */
+static struct snd_ctl_elem_info *mixer_ctl_info(struct mixer_ctl *ctl)
+{
+    if (!ctl)
+        return NULL;
+
+    if (!ctl->info_ready) {
+        if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_INFO, ctl->info) < 0)
+            return NULL;
+        ctl->info_ready = 1;
+    }
+    return ctl->info;
+}
+
+/* the names of an enum control's items, read on first use */
+static char **mixer_ctl_enums(struct mixer_ctl *ctl)
+{
+    struct snd_ctl_elem_info tmp;
+    struct snd_ctl_elem_info *ei = mixer_ctl_info(ctl);
+    char **enames;
+    unsigned int m;
+
+    if (!ei || ei->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED)
         return NULL;
+    if (ctl->ename)
+        return ctl->ename;
+
+    enames = mixer_pool_alloc(ctl->mixer, ei->value.enumerated.items * sizeof(char *));
+    if (!enames)
+        return NULL;
+
+    for (m = 0; m < ei->value.enumerated.items; m++) {
+        memset(&tmp, 0, sizeof(tmp));
+        tmp.id.numid = ei->id.numid;
+        tmp.value.enumerated.item = m;
+        if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_INFO, &tmp) < 0)
+            return NULL;
+        enames[m] = mixer_pool_alloc(ctl->mixer, strlen(tmp.value.enumerated.name) + 1);
+        if (!enames[m])
+            return NULL;
+        strcpy(enames[m], tmp.value.enumerated.name);
+    }
+
+    ctl->ename = enames;
+    return enames;
+}
+
+static struct mixer_ctl *mixer_get_ctl_by_numid(struct mixer *mixer, unsigned int numid)
+{
+    unsigned int n;
+
+    /* numids are normally the list order counted from one */
+    if (numid && numid <= mixer->count && mixer->elem_info[numid - 1].id.numid == numid)
+        return mixer->ctl + numid - 1;
 
     for (n = 0; n < mixer->count; n++)
-        if (!strcmp(name, (char*) mixer->elem_info[n].id.name))
+        if (mixer->elem_info[n].id.numid == numid)
             return mixer->ctl + n;
 
     return NULL;
 }
 
+/* forget what an info change may have made stale, the pool keeps the old
+ * allocations until mixer_close() */
+static void mixer_ctl_invalidate_info(struct mixer_ctl *ctl)
+{
+    ctl->info_ready = 0;
+    ctl->ename = NULL;
+    ctl->cache = NULL;
+    ctl->cache_valid = 0;
+    ctl->tlv = NULL;
+    ctl->db_table = NULL;
+}
+
+/* apply the pending control events to the caches, without blocking */
+static void mixer_queue_event(struct mixer *mixer, struct snd_ctl_event *ev,
+                              struct mixer_ctl *ctl)
+{
+    struct mixer_event *event;
+    unsigned int mask = ev->data.elem.mask;
+
+    if (mixer->event_count == MIXER_EVENT_QUEUE) {
+        /* drop the oldest, the reader learns it has to resync */
+        mixer->event_head = (mixer->event_head + 1) % MIXER_EVENT_QUEUE;
+        mixer->event_count--;
+        mixer->events_lost = 1;
+    }
+
+    event = &mixer->events[(mixer->event_head + mixer->event_count++) % MIXER_EVENT_QUEUE];
+    memset(event, 0, sizeof(*event));
+    event->ctl = ctl;
+    if (mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
+        event->mask = MIXER_EVENT_REMOVE;
+    } else {
+        if (mask & SNDRV_CTL_EVENT_MASK_VALUE)
+            event->mask |= MIXER_EVENT_VALUE;
+        if (mask & SNDRV_CTL_EVENT_MASK_INFO)
+            event->mask |= MIXER_EVENT_INFO;
+        if (mask & SNDRV_CTL_EVENT_MASK_ADD)
+            event->mask |= MIXER_EVENT_ADD;
+    }
+    strncpy(event->name, (char *)ev->data.elem.id.name, sizeof(event->name) - 1);
+    event->index = ev->data.elem.id.index;
+}
+
+/* apply the pending control events to the caches and queue them for
+ * mixer_read_event(), without blocking */
+static void mixer_read_events(struct mixer *mixer)
+{
+    struct snd_ctl_event ev[16];
+    struct pollfd pfd;
+    struct mixer_ctl *ctl;
+    ssize_t bytes;
+    unsigned int i;
+
+    if (!mixer->subscribed)
+        return;
+
+    pfd.fd = mixer->fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        bytes = read(mixer->fd, ev, sizeof(ev));
+        if (bytes <= 0)
+            break;
+
+        for (i = 0; i < bytes / sizeof(ev[0]); i++) {
+            if (ev[i].type != SNDRV_CTL_EVENT_ELEM)
+                continue;
+            ctl = mixer_get_ctl_by_numid(mixer, ev[i].data.elem.id.numid);
+            if (mixer->deliver_events)
+                mixer_queue_event(mixer, &ev[i], ctl);
+            if (!ctl)
+                continue;
+            if (ev[i].data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+                (ev[i].data.elem.mask & (SNDRV_CTL_EVENT_MASK_INFO | SNDRV_CTL_EVENT_MASK_TLV)))
+                mixer_ctl_invalidate_info(ctl);
+            else if (ev[i].data.elem.mask & SNDRV_CTL_EVENT_MASK_VALUE) {
+                ctl->cache_valid = 0;
+                ctl->value_events++;
+            }
+        }
+    }
+}
+
+int mixer_subscribe_events(struct mixer *mixer, int subscribe)
+{
+    int on = 1;
+
+    if (!mixer)
+        return -EINVAL;
+
+    if (subscribe && !mixer->subscribed) {
+        if (ioctl(mixer->fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS, &on) < 0)
+            return -errno;
+        mixer->subscribed = 1;
+    }
+
+    /* the kernel subscription stays for the value cache */
+    mixer->deliver_events = !!subscribe;
+    if (!subscribe) {
+        mixer->event_count = 0;
+        mixer->events_lost = 0;
+    }
+    return 0;
+}
+
+int mixer_get_fd(struct mixer *mixer)
+{
+    if (!mixer)
+        return -EINVAL;
+
+    return mixer->fd;
+}
+
+int mixer_wait_event(struct mixer *mixer, int timeout)
+{
+    struct pollfd pfd;
+    int ret;
+
+    if (!mixer || !mixer->deliver_events)
+        return -EINVAL;
+
+    mixer_read_events(mixer);
+    if (mixer->event_count || mixer->events_lost)
+        return 1;
+
+    pfd.fd = mixer->fd;
+    pfd.events = POLLIN;
+    ret = poll(&pfd, 1, timeout);
+    if (ret < 0)
+        return -errno;
+
+    return ret > 0 && (pfd.revents & POLLIN);
+}
+
+int mixer_read_event(struct mixer *mixer, struct mixer_event *event)
+{
+    if (!mixer || !event || !mixer->deliver_events)
+        return -EINVAL;
+
+    mixer_read_events(mixer);
+
+    if (mixer->events_lost) {
+        memset(event, 0, sizeof(*event));
+        event->mask = MIXER_EVENT_LOST;
+        mixer->events_lost = 0;
+        return 1;
+    }
+
+    if (!mixer->event_count)
+        return 0;
+
+    *event = mixer->events[mixer->event_head];
+    mixer->event_head = (mixer->event_head + 1) % MIXER_EVENT_QUEUE;
+    mixer->event_count--;
+    return 1;
+}
+
 void mixer_ctl_update(struct mixer_ctl *ctl)
 {
-    ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_INFO, ctl->info);
+    mixer_ctl_invalidate_info(ctl);
+    ctl->info_ready = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_INFO, ctl->info) == 0;
 }
 
 const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
@@ -219,7 +668,7 @@ const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
 
 enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
 {
-    if (!ctl)
+    if (!mixer_ctl_info(ctl))
         return MIXER_CTL_TYPE_UNKNOWN;
 
     switch (ctl->info->type) {
@@ -235,7 +684,7 @@ enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
 
 const char *mixer_ctl_get_type_string(struct mixer_ctl *ctl)
 {
-    if (!ctl)
+    if (!mixer_ctl_info(ctl))
         return "";
 
     switch (ctl->info->type) {
@@ -251,12 +700,183 @@ const char *mixer_ctl_get_type_string(struct mixer_ctl *ctl)
 
 unsigned int mixer_ctl_get_num_values(struct mixer_ctl *ctl)
 {
-    if (!ctl)
+    if (!mixer_ctl_info(ctl))
         return 0;
 
     return ctl->info->count;
 }
 
+/* where the values of the control's type live in ev, and their size */
+static void *mixer_ctl_values(struct snd_ctl_elem_info *ei,
+                              struct snd_ctl_elem_value *ev, size_t *size)
+{
+    switch (ei->type) {
+    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+    case SNDRV_CTL_ELEM_TYPE_INTEGER:
+        *size = ei->count * sizeof(ev->value.integer.value[0]);
+        return ev->value.integer.value;
+
+    case SNDRV_CTL_ELEM_TYPE_INTEGER64:
+        *size = ei->count * sizeof(ev->value.integer64.value[0]);
+        return ev->value.integer64.value;
+
+    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+        *size = ei->count * sizeof(ev->value.enumerated.item[0]);
+        return ev->value.enumerated.item;
+
+    case SNDRV_CTL_ELEM_TYPE_BYTES:
+        *size = ei->count * sizeof(ev->value.bytes.data[0]);
+        return ev->value.bytes.data;
+
+    case SNDRV_CTL_ELEM_TYPE_IEC958:
+        *size = sizeof(ev->value.iec958);
+        return &ev->value.iec958;
+
+    default:
+        return NULL;
+    }
+}
+
+static int mixer_ctl_cacheable(struct mixer_ctl *ctl)
+{
+    return ctl->mixer->subscribed && !(ctl->info->access & SNDRV_CTL_ELEM_ACCESS_VOLATILE);
+}
+
+static void mixer_ctl_cache_store(struct mixer_ctl *ctl, struct snd_ctl_elem_value *ev)
+{
+    void *values;
+    size_t size;
+
+    if (!mixer_ctl_cacheable(ctl))
+        return;
+
+    values = mixer_ctl_values(ctl->info, ev, &size);
+    if (!values)
+        return;
+    if (!ctl->cache) {
+        ctl->cache = mixer_pool_alloc(ctl->mixer, size);
+        if (!ctl->cache)
+            return;
+    }
+    memcpy(ctl->cache, values, size);
+    ctl->cache_valid = 1;
+}
+
+/* Read all values of a control whose info is loaded, from the cache when
+ * it is still valid */
+static int mixer_ctl_read(struct mixer_ctl *ctl, struct snd_ctl_elem_value *ev)
+{
+    void *values;
+    size_t size;
+    int ret;
+
+    mixer_read_events(ctl->mixer);
+
+    memset(ev, 0, sizeof(*ev));
+    ev->id.numid = ctl->info->id.numid;
+
+    if (ctl->cache_valid) {
+        values = mixer_ctl_values(ctl->info, ev, &size);
+        memcpy(values, ctl->cache, size);
+        return 0;
+    }
+
+    ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, ev);
+    if (ret < 0)
+        return ret;
+
+    mixer_ctl_cache_store(ctl, ev);
+    return 0;
+}
+
+/* Write through the cache. The kernel queues the value event of a write for
+ * every subscribed file, this one too, before the ioctl returns, so the
+ * events read right after it are the write's own echo and whatever other
+ * writers did meanwhile. A write that changes the cached values brings one
+ * echo, one that does not brings none; when that is all there is, the
+ * cache holds what the driver does. Without a cache to tell, a single event
+ * is checked against the driver with one ELEM_READ. */
+static int mixer_ctl_write(struct mixer_ctl *ctl, struct snd_ctl_elem_value *ev)
+{
+    struct snd_ctl_elem_value driver;
+    void *values;
+    size_t size;
+    int echo = -1;      /* value events the write causes, -1 when unknown */
+    int ret;
+
+    mixer_read_events(ctl->mixer);
+    values = mixer_ctl_values(ctl->info, ev, &size);
+    if (ctl->cache_valid && values)
+        echo = memcmp(ctl->cache, values, size) != 0;
+
+    ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, ev);
+    if (ret < 0) {
+        ctl->cache_valid = 0;
+        return ret;
+    }
+
+    ctl->value_events = 0;
+    mixer_read_events(ctl->mixer);
+    if (!ctl->info_ready || !mixer_ctl_cacheable(ctl))
+        return 0;
+
+    if (!ctl->value_events || (int)ctl->value_events == echo) {
+        mixer_ctl_cache_store(ctl, ev);
+    } else if (echo < 0 && ctl->value_events == 1) {
+        memset(&driver, 0, sizeof(driver));
+        driver.id.numid = ctl->info->id.numid;
+        if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, &driver) == 0)
+            mixer_ctl_cache_store(ctl, &driver);
+    }
+    return 0;
+}
+
+/* value id of ev as an int, like mixer_ctl_get_value() returns it */
+static int mixer_ctl_value_to_int(struct snd_ctl_elem_info *ei,
+                                  struct snd_ctl_elem_value *ev, unsigned int id)
+{
+    switch (ei->type) {
+    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+        return !!ev->value.integer.value[id];
+
+    case SNDRV_CTL_ELEM_TYPE_INTEGER:
+        return ev->value.integer.value[id];
+
+    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+        return ev->value.enumerated.item[id];
+
+    case SNDRV_CTL_ELEM_TYPE_BYTES:
+        return ev->value.bytes.data[id];
+
+    default:
+        return -EINVAL;
+    }
+}
+
+static int mixer_ctl_int_to_value(struct snd_ctl_elem_info *ei,
+                                  struct snd_ctl_elem_value *ev, unsigned int id,
+                                  int value)
+{
+    switch (ei->type) {
+    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+        ev->value.integer.value[id] = !!value;
+        break;
+
+    case SNDRV_CTL_ELEM_TYPE_INTEGER:
+        ev->value.integer.value[id] = value;
+        break;
+
+    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+        ev->value.enumerated.item[id] = value;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
 static int percent_to_int(struct snd_ctl_elem_info *ei, int percent)
 {
     int range;
@@ -283,7 +903,7 @@ static int int_to_percent(struct snd_ctl_elem_info *ei, int value)
 
 int mixer_ctl_get_percent(struct mixer_ctl *ctl, unsigned int id)
 {
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
         return -EINVAL;
 
     return int_to_percent(ctl->info, mixer_ctl_get_value(ctl, id));
@@ -291,7 +911,7 @@ int mixer_ctl_get_percent(struct mixer_ctl *ctl, unsigned int id)
 
 int mixer_ctl_set_percent(struct mixer_ctl *ctl, unsigned int id, int percent)
 {
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
         return -EINVAL;
 
     return mixer_ctl_set_value(ctl, id, percent_to_int(ctl->info, percent));
@@ -302,31 +922,33 @@ int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
     struct snd_ctl_elem_value ev;
     int ret;
 
-    if (!ctl || (id >= ctl->info->count))
+    if (!mixer_ctl_info(ctl) || (id >= ctl->info->count))
         return -EINVAL;
 
-    memset(&ev, 0, sizeof(ev));
-    ev.id.numid = ctl->info->id.numid;
-    ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, &ev);
+    ret = mixer_ctl_read(ctl, &ev);
     if (ret < 0)
         return ret;
 
-    switch (ctl->info->type) {
-    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
-        return !!ev.value.integer.value[id];
+    return mixer_ctl_value_to_int(ctl->info, &ev, id);
+}
 
-    case SNDRV_CTL_ELEM_TYPE_INTEGER:
-        return ev.value.integer.value[id];
+int mixer_ctl_get_values(struct mixer_ctl *ctl, int *values, unsigned int count)
+{
+    struct snd_ctl_elem_value ev;
+    unsigned int i;
+    int ret;
 
-    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
-        return ev.value.enumerated.item[id];
+    if (!mixer_ctl_info(ctl) || (count > ctl->info->count) || !values ||
+        (ctl->info->type < SNDRV_CTL_ELEM_TYPE_BOOLEAN) ||
+        (ctl->info->type > SNDRV_CTL_ELEM_TYPE_BYTES))
+        return -EINVAL;
 
-    case SNDRV_CTL_ELEM_TYPE_BYTES:
-        return ev.value.bytes.data[id];
+    ret = mixer_ctl_read(ctl, &ev);
+    if (ret < 0)
+        return ret;
 
-    default:
-        return -EINVAL;
-    }
+    for (i = 0; i < count; i++)
+        values[i] = mixer_ctl_value_to_int(ctl->info, &ev, i);
 
     return 0;
 }
@@ -338,13 +960,10 @@ int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
     size_t size;
     void *source;
 
-    if (!ctl || (count > ctl->info->count) || !count || !array)
+    if (!mixer_ctl_info(ctl) || (count > ctl->info->count) || !count || !array)
         return -EINVAL;
 
-    memset(&ev, 0, sizeof(ev));
-    ev.id.numid = ctl->info->id.numid;
-
-    ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, &ev);
+    ret = mixer_ctl_read(ctl, &ev);
     if (ret < 0)
         return ret;
 
@@ -374,33 +993,43 @@ int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
     struct snd_ctl_elem_value ev;
     int ret;
 
-    if (!ctl || (id >= ctl->info->count))
+    if (!mixer_ctl_info(ctl) || (id >= ctl->info->count))
         return -EINVAL;
 
-    memset(&ev, 0, sizeof(ev));
-    ev.id.numid = ctl->info->id.numid;
-    ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, &ev);
+    ret = mixer_ctl_read(ctl, &ev);
     if (ret < 0)
         return ret;
 
-    switch (ctl->info->type) {
-    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
-        ev.value.integer.value[id] = !!value;
-        break;
+    if (mixer_ctl_int_to_value(ctl->info, &ev, id, value) < 0)
+        return -EINVAL;
 
-    case SNDRV_CTL_ELEM_TYPE_INTEGER:
-        ev.value.integer.value[id] = value;
-        break;
+    return mixer_ctl_write(ctl, &ev);
+}
 
-    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
-        ev.value.enumerated.item[id] = value;
-        break;
+int mixer_ctl_set_values(struct mixer_ctl *ctl, const int *values, unsigned int count)
+{
+    struct snd_ctl_elem_value ev;
+    unsigned int i;
+    int ret;
 
-    default:
+    if (!mixer_ctl_info(ctl) || (count > ctl->info->count) || !count || !values)
         return -EINVAL;
+
+    /* only values left out need reading */
+    if (count < ctl->info->count) {
+        ret = mixer_ctl_read(ctl, &ev);
+        if (ret < 0)
+            return ret;
+    } else {
+        memset(&ev, 0, sizeof(ev));
+        ev.id.numid = ctl->info->id.numid;
     }
 
-    return ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
+    for (i = 0; i < count; i++)
+        if (mixer_ctl_int_to_value(ctl->info, &ev, i, values[i]) < 0)
+            return -EINVAL;
+
+    return mixer_ctl_write(ctl, &ev);
 }
 
 int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
@@ -409,7 +1038,7 @@ int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
     size_t size;
     void *dest;
 
-    if (!ctl || (count > ctl->info->count) || !count || !array)
+    if (!mixer_ctl_info(ctl) || (count > ctl->info->count) || !count || !array)
         return -EINVAL;
 
     memset(&ev, 0, sizeof(ev));
@@ -433,12 +1062,12 @@ int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
 
     memcpy(dest, array, size * count);
 
-    return ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
+    return mixer_ctl_write(ctl, &ev);
 }
 
 int mixer_ctl_get_range_min(struct mixer_ctl *ctl)
 {
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
         return -EINVAL;
 
     return ctl->info->value.integer.min;
@@ -446,15 +1075,342 @@ int mixer_ctl_get_range_min(struct mixer_ctl *ctl)
 
 int mixer_ctl_get_range_max(struct mixer_ctl *ctl)
 {
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_INTEGER))
         return -EINVAL;
 
     return ctl->info->value.integer.max;
 }
 
+/* dB of raw in [rmin, rmax] under one TLV, 1/100 dB */
+static int mixer_tlv_to_db(const unsigned int *tlv, int rmin, int rmax, int raw)
+{
+    unsigned int len = tlv[1] / sizeof(unsigned int);
+    int min = (int)tlv[2], max = (int)tlv[3];
+    unsigned int pos;
+    double lmin, lmax, v;
+
+    switch (tlv[0]) {
+    case MIXER_TLV_DB_SCALE:
+        if ((tlv[3] & MIXER_TLV_DB_SCALE_MUTE) && raw == rmin)
+            return MIXER_CTL_DB_MUTE;
+        return min + (int)(tlv[3] & 0xffff) * (raw - rmin);
+
+    case MIXER_TLV_DB_MINMAX_MUTE:
+        if (raw == rmin)
+            return MIXER_CTL_DB_MUTE;
+        /* fall through */
+    case MIXER_TLV_DB_MINMAX:
+        if (rmax == rmin)
+            return min;
+        return min + (int)((long long)(max - min) * (raw - rmin) / (rmax - rmin));
+
+    case MIXER_TLV_DB_LINEAR:
+        if (raw <= rmin)
+            return min;
+        if (raw >= rmax)
+            return max;
+        /* raw steps are linear in amplitude */
+        v = (double)(raw - rmin) / (rmax - rmin);
+        if (min <= MIXER_CTL_DB_MUTE)
+            return (int)(2000.0 * log10(v)) + max;
+        lmin = pow(10.0, min / 2000.0);
+        lmax = pow(10.0, max / 2000.0);
+        return (int)(2000.0 * log10((lmax - lmin) * v + lmin));
+
+    case MIXER_TLV_DB_RANGE:
+        /* rmin, rmax, then a TLV for that part of the range */
+        for (pos = 2; pos + 4 <= len + 2; pos += 4 + tlv[pos + 3] / sizeof(unsigned int)) {
+            if (raw >= (int)tlv[pos] && raw <= (int)tlv[pos + 1])
+                return mixer_tlv_to_db(tlv + pos + 2, tlv[pos], tlv[pos + 1], raw);
+        }
+        return MIXER_CTL_DB_MUTE;
+
+    default:
+        return MIXER_CTL_DB_MUTE;
+    }
+}
+
+/* the control's dB TLV, read once; NULL if it has none */
+static const unsigned int *mixer_ctl_tlv(struct mixer_ctl *ctl)
+{
+    struct snd_ctl_tlv *tlv;
+    struct snd_ctl_elem_info *ei = mixer_ctl_info(ctl);
+
+    if (!ei || ei->type != SNDRV_CTL_ELEM_TYPE_INTEGER ||
+        !(ei->access & SNDRV_CTL_ELEM_ACCESS_TLV_READ))
+        return NULL;
+
+    if (!ctl->tlv) {
+        tlv = mixer_pool_alloc(ctl->mixer, sizeof(*tlv) +
+                               MIXER_TLV_WORDS * sizeof(unsigned int));
+        if (!tlv)
+            return NULL;
+        tlv->numid = ei->id.numid;
+        tlv->length = MIXER_TLV_WORDS * sizeof(unsigned int);
+        if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_TLV_READ, tlv) < 0 ||
+            tlv->tlv[0] < MIXER_TLV_DB_SCALE || tlv->tlv[0] > MIXER_TLV_DB_MINMAX_MUTE ||
+            tlv->tlv[1] + 2 * sizeof(unsigned int) > tlv->length)
+            tlv->tlv[0] = 0;
+        ctl->tlv = tlv->tlv;
+    }
+
+    return ctl->tlv[0] ? ctl->tlv : NULL;
+}
+
+/* the dB of every raw value, built on first use for controls with few
+ * enough steps */
+static const int *mixer_ctl_db_table(struct mixer_ctl *ctl)
+{
+    const unsigned int *tlv = mixer_ctl_tlv(ctl);
+    long min, max, raw;
+    int *table;
+
+    if (!tlv)
+        return NULL;
+    if (ctl->db_table)
+        return ctl->db_table;
+
+    min = ctl->info->value.integer.min;
+    max = ctl->info->value.integer.max;
+    if (max < min || max - min >= MIXER_DB_TABLE_MAX)
+        return NULL;
+
+    table = mixer_pool_alloc(ctl->mixer, (max - min + 1) * sizeof(int));
+    if (!table)
+        return NULL;
+    for (raw = min; raw <= max; raw++)
+        table[raw - min] = mixer_tlv_to_db(tlv, min, max, raw);
+
+    ctl->db_table = table;
+    return table;
+}
+
+static int mixer_ctl_db_scale(struct mixer_ctl *ctl, struct mixer_db_scale *scale)
+{
+    scale->tlv = mixer_ctl_tlv(ctl);
+    if (!scale->tlv)
+        return -EINVAL;
+
+    scale->table = mixer_ctl_db_table(ctl);
+    scale->min = ctl->info->value.integer.min;
+    scale->max = ctl->info->value.integer.max;
+    return 0;
+}
+
+static int mixer_raw_to_db(const struct mixer_db_scale *scale, int raw)
+{
+    if (scale->table)
+        return scale->table[raw - scale->min];
+    return mixer_tlv_to_db(scale->tlv, scale->min, scale->max, raw);
+}
+
+/* the raw value whose dB is nearest to db, dB rising with raw */
+static int mixer_db_to_raw(const struct mixer_db_scale *scale, int db)
+{
+    int lo = scale->min, hi = scale->max;
+    int mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (mixer_raw_to_db(scale, mid) < db)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo > scale->min &&
+        db - mixer_raw_to_db(scale, lo - 1) < mixer_raw_to_db(scale, lo) - db)
+        lo--;
+    return lo;
+}
+
+int mixer_ctl_get_db_range(struct mixer_ctl *ctl, int *min_db, int *max_db)
+{
+    struct mixer_db_scale scale;
+
+    if (mixer_ctl_db_scale(ctl, &scale) < 0 || !min_db || !max_db)
+        return -EINVAL;
+
+    *min_db = mixer_raw_to_db(&scale, scale.min);
+    *max_db = mixer_raw_to_db(&scale, scale.max);
+    return 0;
+}
+
+int mixer_ctl_get_db(struct mixer_ctl *ctl, unsigned int id, int *db)
+{
+    struct mixer_db_scale scale;
+    int raw;
+
+    if (mixer_ctl_db_scale(ctl, &scale) < 0 || !db || id >= ctl->info->count)
+        return -EINVAL;
+
+    raw = mixer_ctl_get_value(ctl, id);
+    if (raw < scale.min || raw > scale.max)
+        return -EINVAL;
+
+    *db = mixer_raw_to_db(&scale, raw);
+    return 0;
+}
+
+int mixer_ctl_set_db(struct mixer_ctl *ctl, int db)
+{
+    struct mixer_db_scale scale;
+    struct snd_ctl_elem_value ev;
+    unsigned int i;
+    int raw;
+
+    if (mixer_ctl_db_scale(ctl, &scale) < 0)
+        return -EINVAL;
+
+    raw = mixer_db_to_raw(&scale, db);
+    memset(&ev, 0, sizeof(ev));
+    ev.id.numid = ctl->info->id.numid;
+    for (i = 0; i < ctl->info->count; i++)
+        ev.value.integer.value[i] = raw;
+
+    return mixer_ctl_write(ctl, &ev);
+}
+
+static unsigned int mixer_elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 +
+        (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/* Steps every ramp every MIXER_RAMP_STEP_MS, interpolating in dB. It only
+ * writes to the driver; the value events it causes update the cache. */
+static void *mixer_ramp_thread(void *arg)
+{
+    struct mixer *mixer = arg;
+    struct snd_ctl_elem_value ev;
+    struct timespec step = { 0, MIXER_RAMP_STEP_MS * 1000000 };
+    unsigned int n, i, elapsed;
+    int db, raw;
+
+    pthread_mutex_lock(&mixer->ramp_lock);
+    while (!mixer->ramp_quit) {
+        if (!mixer->ramp_count) {
+            pthread_cond_wait(&mixer->ramp_cond, &mixer->ramp_lock);
+            continue;
+        }
+
+        for (n = 0; n < mixer->ramp_count; ) {
+            struct mixer_ramp *ramp = &mixer->ramps[n];
+
+            elapsed = mixer_elapsed_ms(&ramp->start);
+            if (elapsed >= ramp->duration_ms)
+                db = ramp->to;
+            else
+                db = ramp->from + (int)((long long)(ramp->to - ramp->from) *
+                                        elapsed / ramp->duration_ms);
+
+            raw = mixer_db_to_raw(&ramp->scale, db);
+            if (raw != ramp->last_raw) {
+                memset(&ev, 0, sizeof(ev));
+                ev.id.numid = ramp->numid;
+                for (i = 0; i < ramp->count; i++)
+                    ev.value.integer.value[i] = raw;
+                if (ioctl(mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev) == 0)
+                    ramp->last_raw = raw;
+            }
+
+            if (elapsed >= ramp->duration_ms) {
+                mixer->ramps[n] = mixer->ramps[--mixer->ramp_count];
+                pthread_cond_broadcast(&mixer->ramp_cond);
+            } else {
+                n++;
+            }
+        }
+
+        pthread_mutex_unlock(&mixer->ramp_lock);
+        nanosleep(&step, NULL);
+        pthread_mutex_lock(&mixer->ramp_lock);
+    }
+    pthread_mutex_unlock(&mixer->ramp_lock);
+
+    return NULL;
+}
+
+int mixer_ctl_ramp_db(struct mixer_ctl *ctl, int db, unsigned int duration_ms)
+{
+    struct mixer *mixer;
+    struct mixer_ramp *ramp = NULL;
+    struct mixer_db_scale scale;
+    int from, min_db, max_db;
+    unsigned int n;
+    int ret = 0;
+
+    if (mixer_ctl_db_scale(ctl, &scale) < 0 ||
+        mixer_ctl_get_db_range(ctl, &min_db, &max_db) < 0 ||
+        mixer_ctl_get_db(ctl, 0, &from) < 0)
+        return -EINVAL;
+    if (!duration_ms)
+        return mixer_ctl_set_db(ctl, db);
+
+    /* ramp up from mute as from the lowest audible step */
+    if (from == MIXER_CTL_DB_MUTE && scale.max > scale.min)
+        from = mixer_raw_to_db(&scale, scale.min + 1);
+    if (db < min_db)
+        db = min_db;
+    else if (db > max_db)
+        db = max_db;
+
+    mixer = ctl->mixer;
+    pthread_mutex_lock(&mixer->ramp_lock);
+
+    /* a new ramp on a control replaces the one in progress */
+    for (n = 0; n < mixer->ramp_count; n++)
+        if (mixer->ramps[n].ctl == ctl)
+            ramp = &mixer->ramps[n];
+    if (!ramp && mixer->ramp_count < MIXER_MAX_RAMPS)
+        ramp = &mixer->ramps[mixer->ramp_count++];
+    if (!ramp) {
+        ret = -EBUSY;
+        goto done;
+    }
+
+    ramp->ctl = ctl;
+    ramp->scale = scale;
+    ramp->numid = ctl->info->id.numid;
+    ramp->count = ctl->info->count;
+    ramp->from = from;
+    ramp->to = db;
+    ramp->duration_ms = duration_ms;
+    ramp->last_raw = mixer_ctl_get_value(ctl, 0);
+    clock_gettime(CLOCK_MONOTONIC, &ramp->start);
+
+    if (!mixer->ramp_thread_running) {
+        if (pthread_create(&mixer->ramp_thread, NULL, mixer_ramp_thread, mixer)) {
+            mixer->ramp_count--;
+            ret = -EAGAIN;
+            goto done;
+        }
+        mixer->ramp_thread_running = 1;
+    }
+    pthread_cond_broadcast(&mixer->ramp_cond);
+
+done:
+    pthread_mutex_unlock(&mixer->ramp_lock);
+    return ret;
+}
+
+void mixer_wait_ramps(struct mixer *mixer)
+{
+    if (!mixer)
+        return;
+
+    pthread_mutex_lock(&mixer->ramp_lock);
+    while (mixer->ramp_count)
+        pthread_cond_wait(&mixer->ramp_cond, &mixer->ramp_lock);
+    pthread_mutex_unlock(&mixer->ramp_lock);
+}
+
 unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
 {
-    if (!ctl)
+    if (!mixer_ctl_info(ctl))
         return 0;
 
     return ctl->info->value.enumerated.items;
@@ -463,8 +1419,8 @@ unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
 const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl,
                                       unsigned int enum_id)
 {
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED) ||
-        (enum_id >= ctl->info->value.enumerated.items))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED) ||
+        (enum_id >= ctl->info->value.enumerated.items) || !mixer_ctl_enums(ctl))
         return NULL;
 
     return (const char *)ctl->ename[enum_id];
@@ -476,7 +1432,8 @@ int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
     struct snd_ctl_elem_value ev;
     int ret;
 
-    if (!ctl || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED))
+    if (!mixer_ctl_info(ctl) || (ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED) ||
+        !mixer_ctl_enums(ctl))
         return -EINVAL;
 
     num_enums = ctl->info->value.enumerated.items;
@@ -485,7 +1442,7 @@ int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
             memset(&ev, 0, sizeof(ev));
             ev.value.enumerated.item[0] = i;
             ev.id.numid = ctl->info->id.numid;
-            ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
+            ret = mixer_ctl_write(ctl, &ev);
             if (ret < 0)
                 return ret;
             return 0;
@@ -495,3 +1452,261 @@ int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
     return -EINVAL;
 }
 
+/*
+ * Scenarios
+ *
+ * One control per line, "name = value ...", with ",index" after the name
+ * for controls that share a name; a comma not followed by digits only is
+ * part of the name. Values are integers or enum item names, quoted if they
+ * contain spaces; a single value sets every value of the control. Blank
+ * lines and lines starting with # are skipped, and lines longer than
+ * MIXER_SCENARIO_LINE - 2 characters are an error.
+ */
+
+#define MIXER_SCENARIO_LINE 1024
+
+struct mixer_scenario_entry {
+    struct mixer_ctl *ctl;
+    unsigned int count;
+    int *values;
+    struct snd_ctl_elem_value *saved;   /* values before, once written */
+};
+
+/* next whitespace separated, optionally quoted, token of *p */
+static char *mixer_scenario_token(char **p)
+{
+    char *start, *end;
+
+    for (start = *p; isspace((unsigned char)*start); start++)
+        ;
+    if (!*start)
+        return NULL;
+
+    if (*start == '"') {
+        start++;
+        end = strchr(start, '"');
+        if (!end)
+            return NULL;
+    } else {
+        for (end = start; *end && !isspace((unsigned char)*end); end++)
+            ;
+    }
+
+    *p = *end ? end + 1 : end;
+    *end = 0;
+    return start;
+}
+
+static int mixer_scenario_value(struct mixer_ctl *ctl, const char *token, int *value)
+{
+    unsigned int i, num_enums;
+    char *end;
+    long v;
+
+    v = strtol(token, &end, 0);
+    if (end != token && !*end) {
+        *value = v;
+        return 0;
+    }
+
+    if (ctl->info->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN) {
+        if (!strcasecmp(token, "on") || !strcasecmp(token, "true")) {
+            *value = 1;
+            return 0;
+        }
+        if (!strcasecmp(token, "off") || !strcasecmp(token, "false")) {
+            *value = 0;
+            return 0;
+        }
+    }
+
+    num_enums = mixer_ctl_get_num_enums(ctl);
+    for (i = 0; i < num_enums; i++) {
+        const char *name = mixer_ctl_get_enum_string(ctl, i);
+
+        if (name && !strcmp(token, name)) {
+            *value = i;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+/* returns 1 for an entry, 0 for a line without one */
+static int mixer_scenario_parse(struct mixer *mixer, char *line,
+                                struct mixer_scenario_entry *entry)
+{
+    char *name, *values, *end, *comma, *index, *token;
+    unsigned int i;
+
+    name = line + strspn(line, " \t");
+    if (!*name || *name == '\n' || *name == '#')
+        return 0;
+
+    values = strchr(name, '=');
+    if (!values)
+        return -EINVAL;
+    *values++ = 0;
+
+    /* trim the name, split off ",index" */
+    for (end = values - 1; end > name && isspace((unsigned char)end[-1]); end--)
+        ;
+    *end = 0;
+    comma = strrchr(name, ',');
+    index = comma ? comma + 1 + strspn(comma + 1, " \t") : NULL;
+    if (index && *index && strspn(index, "0123456789") == strlen(index)) {
+        *comma = 0;
+        entry->ctl = mixer_get_ctl_by_name_and_index(mixer, name, atoi(index));
+    } else {
+        entry->ctl = mixer_get_ctl_by_name(mixer, name);
+    }
+    if (!entry->ctl || !mixer_ctl_info(entry->ctl) || !entry->ctl->info->count ||
+        entry->ctl->info->type < SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
+        entry->ctl->info->type > SNDRV_CTL_ELEM_TYPE_ENUMERATED)
+        return -EINVAL;
+
+    entry->values = calloc(entry->ctl->info->count, sizeof(int));
+    if (!entry->values)
+        return -ENOMEM;
+
+    for (entry->count = 0; (token = mixer_scenario_token(&values)); entry->count++) {
+        if (entry->count == entry->ctl->info->count ||
+            mixer_scenario_value(entry->ctl, token, &entry->values[entry->count]) < 0)
+            return -EINVAL;
+    }
+    if (!entry->count)
+        return -EINVAL;
+
+    if (entry->count == 1) {
+        for (i = 1; i < entry->ctl->info->count; i++)
+            entry->values[i] = entry->values[0];
+        entry->count = entry->ctl->info->count;
+    }
+
+    return 1;
+}
+
+/* write the entry if it differs from the current values */
+static int mixer_scenario_write(struct mixer_scenario_entry *entry,
+                                struct mixer_scenario_stats *stats)
+{
+    struct mixer_ctl *ctl = entry->ctl;
+    struct snd_ctl_elem_value ev;
+    void *before, *after;
+    unsigned int i;
+    size_t size;
+    int ret;
+
+    ret = mixer_ctl_read(ctl, &ev);
+    if (ret < 0)
+        return ret;
+
+    entry->saved = malloc(sizeof(ev));
+    if (!entry->saved)
+        return -ENOMEM;
+    *entry->saved = ev;
+
+    for (i = 0; i < entry->count; i++)
+        mixer_ctl_int_to_value(ctl->info, &ev, i, entry->values[i]);
+
+    before = mixer_ctl_values(ctl->info, entry->saved, &size);
+    after = mixer_ctl_values(ctl->info, &ev, &size);
+    if (!memcmp(before, after, size)) {
+        free(entry->saved);
+        entry->saved = NULL;
+        return 0;
+    }
+
+    ret = mixer_ctl_write(ctl, &ev);
+    if (ret < 0) {
+        free(entry->saved);
+        entry->saved = NULL;
+        return ret;
+    }
+
+    stats->writes++;
+    return 0;
+}
+
+int mixer_apply_scenario(struct mixer *mixer, const char *path,
+                         struct mixer_scenario_stats *stats)
+{
+    struct mixer_scenario_entry *entries = NULL, *tmp;
+    struct mixer_scenario_stats local;
+    struct timespec start, end;
+    unsigned int count = 0, alloc = 0, n;
+    char line[MIXER_SCENARIO_LINE];
+    size_t len;
+    FILE *file;
+    int ret = 0;
+
+    if (!mixer || !path)
+        return -EINVAL;
+    if (!stats)
+        stats = &local;
+
+    memset(stats, 0, sizeof(*stats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    file = fopen(path, "r");
+    if (!file)
+        return -errno;
+
+    /* resolve the whole file before touching anything */
+    while (fgets(line, sizeof(line), file)) {
+        stats->line++;
+        /* a line fgets() had to split, unless it is the last one */
+        len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n' && getc(file) != EOF) {
+            ret = -E2BIG;
+            goto done;
+        }
+        if (count == alloc) {
+            alloc = alloc ? 2 * alloc : 32;
+            tmp = realloc(entries, alloc * sizeof(*entries));
+            if (!tmp) {
+                ret = -ENOMEM;
+                goto done;
+            }
+            entries = tmp;
+        }
+        memset(&entries[count], 0, sizeof(entries[count]));
+        ret = mixer_scenario_parse(mixer, line, &entries[count]);
+        if (ret < 0) {
+            free(entries[count].values);
+            goto done;
+        }
+        count += ret;
+    }
+    stats->line = 0;
+    stats->controls = count;
+
+    for (n = 0; n < count; n++) {
+        ret = mixer_scenario_write(&entries[n], stats);
+        if (ret < 0)
+            break;
+    }
+
+    if (ret < 0) {
+        /* put back what was written, newest first */
+        stats->failed = mixer_ctl_get_name(entries[n].ctl);
+        while (n--) {
+            if (entries[n].saved && mixer_ctl_write(entries[n].ctl, entries[n].saved) == 0)
+                stats->writes++;
+        }
+    }
+
+done:
+    for (n = 0; n < count; n++) {
+        free(entries[n].values);
+        free(entries[n].saved);
+    }
+    free(entries);
+    fclose(file);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->elapsed_us = (end.tv_sec - start.tv_sec) * 1000000 +
+        (end.tv_nsec - start.tv_nsec) / 1000;
+    return ret;
+}
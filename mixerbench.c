@@ -0,0 +1,596 @@
+/* mixerbench.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+#include <linux/ioctl.h>
+#define __force
+#define __bitwise
+#define __user
+#include <sound/asound.h>
+
+#include "asoundlib.h"
+
+/*
+ * Times the mixer library on a card, or with -s on a synthetic card of that
+ * many controls with names like an ASoC codec's. The synthetic card is
+ * served by open() and ioctl() wrappers this tool is linked with
+ * (-Wl,--wrap), so no hardware or driver is involved and the times are the
+ * library's own.
+ *
+ * Name lookups go over every control name, through the hash index and
+ * through the linear strcmp() scan over the info array that
+ * mixer_get_ctl_by_name() used to do, plus as many names the card does not
+ * have.
+ *
+ * mixer_open() is timed against a copy of the eager open it replaced, which
+ * read the info and enum names of every control up front, and against
+ * itself followed by reading all of that. The allocations and ioctls of
+ * each are counted by the malloc(), calloc(), realloc(), strdup() and
+ * ioctl() wrappers.
+ */
+
+#define BENCH_NS            200000000ULL    /* least time spent on a measure */
+#define SYNTHETIC_ENUMS     8               /* items of each enum control */
+
+struct bench {
+    struct mixer *mixer;
+    unsigned int count;
+    /* the names laid out as the old scan saw them, in the info array */
+    struct snd_ctl_elem_info *info;
+    const char **names;
+    const char **missing;
+};
+
+static unsigned int synthetic_controls;
+static unsigned long ioctl_count;
+static unsigned long alloc_count;
+static unsigned long long alloc_bytes;
+
+static const char *synthetic_prefix[] = {
+    "SLIMBUS_0_RX", "SLIMBUS_1_TX", "PRI_MI2S_RX", "QUAT_MI2S_TX",
+    "INT0_MI2S_RX", "RX_CDC_DMA_RX_0", "TX_CDC_DMA_TX_3", "WSA_CDC_DMA_RX_0",
+};
+
+static const char *synthetic_kind[] = {
+    "Audio Mixer MultiMedia", "Port Mixer SLIM", "Channel Mixer",
+    "Voice Mixer", "Volume", "Switch",
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void synthetic_id(unsigned int n, struct snd_ctl_elem_id *id)
+{
+    unsigned int p = n % ARRAY_SIZE(synthetic_prefix);
+    unsigned int k = n / ARRAY_SIZE(synthetic_prefix) % ARRAY_SIZE(synthetic_kind);
+    unsigned int serial = n / (ARRAY_SIZE(synthetic_prefix) * ARRAY_SIZE(synthetic_kind));
+
+    memset(id, 0, sizeof(*id));
+    id->numid = n + 1;
+    id->iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+    snprintf((char *)id->name, sizeof(id->name), "%s %s%u", synthetic_prefix[p],
+             synthetic_kind[k], serial + 1);
+}
+
+/* a quarter of the controls are enums, a quarter switches, the rest volumes */
+static int synthetic_info(struct snd_ctl_elem_info *ei)
+{
+    unsigned int n = ei->id.numid - 1;
+    unsigned int item = ei->value.enumerated.item;
+
+    if (!ei->id.numid || n >= synthetic_controls) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    memset(ei, 0, sizeof(*ei));
+    synthetic_id(n, &ei->id);
+    ei->access = SNDRV_CTL_ELEM_ACCESS_READWRITE;
+    switch (n % 4) {
+    case 0:
+        ei->type = SNDRV_CTL_ELEM_TYPE_ENUMERATED;
+        ei->count = 1;
+        ei->value.enumerated.items = SYNTHETIC_ENUMS;
+        if (item >= SYNTHETIC_ENUMS)
+            item = SYNTHETIC_ENUMS - 1;
+        ei->value.enumerated.item = item;
+        snprintf(ei->value.enumerated.name, sizeof(ei->value.enumerated.name),
+                 "Input %u", item);
+        break;
+    case 1:
+        ei->type = SNDRV_CTL_ELEM_TYPE_BOOLEAN;
+        ei->count = 2;
+        ei->value.integer.max = 1;
+        break;
+    default:
+        ei->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+        ei->count = 2;
+        ei->value.integer.max = 124;
+        ei->value.integer.step = 1;
+        break;
+    }
+    return 0;
+}
+
+static int synthetic_ioctl(unsigned long request, void *arg)
+{
+    struct snd_ctl_elem_list *list = arg;
+    struct snd_ctl_card_info *card = arg;
+    unsigned int n;
+
+    switch (request) {
+    case SNDRV_CTL_IOCTL_ELEM_LIST:
+        list->count = synthetic_controls;
+        for (n = 0; n < list->space && list->offset + n < synthetic_controls; n++)
+            synthetic_id(list->offset + n, &list->pids[n]);
+        list->used = n;
+        return 0;
+    case SNDRV_CTL_IOCTL_CARD_INFO:
+        memset(card, 0, sizeof(*card));
+        strcpy((char *)card->id, "Synthetic");
+        snprintf((char *)card->name, sizeof(card->name), "Synthetic %u controls",
+                 synthetic_controls);
+        return 0;
+    case SNDRV_CTL_IOCTL_ELEM_INFO:
+        return synthetic_info(arg);
+    case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS:
+        return 0;
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+/* the wrapped calls of everything this tool is linked with */
+int __real_open(const char *path, int flags, ...);
+int __real_ioctl(int fd, unsigned long request, ...);
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    alloc_count++;
+    alloc_bytes += strlen(s) + 1;
+    return __real_strdup(s);
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode = 0;
+
+    if (flags & O_CREAT) {
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    /* any fd will do for the synthetic card, its ioctls never reach it */
+    if (synthetic_controls && !strncmp(path, "/dev/snd/controlC", 17))
+        return __real_open("/dev/null", O_RDWR);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    ioctl_count++;
+    if (synthetic_controls)
+        return synthetic_ioctl(request, arg);
+    return __real_ioctl(fd, request, arg);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* mixer_open() and mixer_close() as they were before the info was read
+ * on first use */
+struct eager_ctl {
+    struct eager_mixer *mixer;
+    struct snd_ctl_elem_info *info;
+    char **ename;
+};
+
+struct eager_mixer {
+    int fd;
+    struct snd_ctl_card_info card_info;
+    struct snd_ctl_elem_info *elem_info;
+    struct eager_ctl *ctl;
+    unsigned int count;
+};
+
+static void eager_close(struct eager_mixer *mixer)
+{
+    unsigned int n, m;
+
+    if (!mixer)
+        return;
+
+    if (mixer->fd >= 0)
+        close(mixer->fd);
+
+    if (mixer->ctl) {
+        for (n = 0; n < mixer->count; n++) {
+            if (mixer->ctl[n].ename) {
+                unsigned int max = mixer->ctl[n].info->value.enumerated.items;
+                for (m = 0; m < max; m++)
+                    free(mixer->ctl[n].ename[m]);
+                free(mixer->ctl[n].ename);
+            }
+        }
+        free(mixer->ctl);
+    }
+
+    free(mixer->elem_info);
+    free(mixer);
+}
+
+static struct eager_mixer *eager_open(unsigned int card)
+{
+    struct snd_ctl_elem_list elist;
+    struct snd_ctl_elem_info tmp;
+    struct snd_ctl_elem_id *eid = NULL;
+    struct eager_mixer *mixer = NULL;
+    unsigned int n, m;
+    int fd;
+    char fn[256];
+
+    snprintf(fn, sizeof(fn), "/dev/snd/controlC%u", card);
+    fd = open(fn, O_RDWR);
+    if (fd < 0)
+        return NULL;
+
+    memset(&elist, 0, sizeof(elist));
+    if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &elist) < 0)
+        goto fail;
+
+    mixer = calloc(1, sizeof(*mixer));
+    if (!mixer)
+        goto fail;
+
+    mixer->ctl = calloc(elist.count, sizeof(struct eager_ctl));
+    mixer->elem_info = calloc(elist.count, sizeof(struct snd_ctl_elem_info));
+    if (!mixer->ctl || !mixer->elem_info)
+        goto fail;
+
+    if (ioctl(fd, SNDRV_CTL_IOCTL_CARD_INFO, &mixer->card_info) < 0)
+        goto fail;
+
+    eid = calloc(elist.count, sizeof(struct snd_ctl_elem_id));
+    if (!eid)
+        goto fail;
+
+    mixer->count = elist.count;
+    mixer->fd = fd;
+    elist.space = mixer->count;
+    elist.pids = eid;
+    if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &elist) < 0)
+        goto fail;
+
+    for (n = 0; n < mixer->count; n++) {
+        struct snd_ctl_elem_info *ei = mixer->elem_info + n;
+        ei->id.numid = eid[n].numid;
+        if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_INFO, ei) < 0)
+            goto fail;
+        mixer->ctl[n].info = ei;
+        mixer->ctl[n].mixer = mixer;
+        if (ei->type == SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
+            char **enames = calloc(ei->value.enumerated.items, sizeof(char *));
+            if (!enames)
+                goto fail;
+            mixer->ctl[n].ename = enames;
+            for (m = 0; m < ei->value.enumerated.items; m++) {
+                memset(&tmp, 0, sizeof(tmp));
+                tmp.id.numid = ei->id.numid;
+                tmp.value.enumerated.item = m;
+                if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_INFO, &tmp) < 0)
+                    goto fail;
+                enames[m] = strdup(tmp.value.enumerated.name);
+                if (!enames[m])
+                    goto fail;
+            }
+        }
+    }
+
+    free(eid);
+    return mixer;
+
+fail:
+    free(eid);
+    if (mixer)
+        eager_close(mixer);
+    else if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+static int open_eager(unsigned int card)
+{
+    struct eager_mixer *mixer = eager_open(card);
+
+    if (!mixer)
+        return -1;
+    eager_close(mixer);
+    return 0;
+}
+
+static int open_lazy(unsigned int card)
+{
+    struct mixer *mixer = mixer_open(card);
+
+    if (!mixer)
+        return -1;
+    mixer_close(mixer);
+    return 0;
+}
+
+/* what the eager open read, through the lazy one */
+static int open_lazy_all(unsigned int card)
+{
+    struct mixer *mixer = mixer_open(card);
+    unsigned int n;
+
+    if (!mixer)
+        return -1;
+    for (n = 0; n < mixer_get_num_ctls(mixer); n++) {
+        struct mixer_ctl *ctl = mixer_get_ctl(mixer, n);
+
+        if (mixer_ctl_get_type(ctl) == MIXER_CTL_TYPE_ENUM &&
+            !mixer_ctl_get_enum_string(ctl, 0)) {
+            mixer_close(mixer);
+            return -1;
+        }
+    }
+    mixer_close(mixer);
+    return 0;
+}
+
+static int bench_open(unsigned int card)
+{
+    static const struct {
+        const char *name;
+        int (*run)(unsigned int card);
+    } ways[] = {
+        { "eager (before)", open_eager },
+        { "lazy", open_lazy },
+        { "lazy, then all info", open_lazy_all },
+    };
+    unsigned int i;
+
+    printf("%-22s %12s %12s %12s %8s\n", "mixer_open + close", "time",
+           "allocations", "bytes", "ioctls");
+    for (i = 0; i < ARRAY_SIZE(ways); i++) {
+        unsigned long allocs = alloc_count, ioctls = ioctl_count;
+        unsigned long long bytes = alloc_bytes, opens = 0;
+        uint64_t start, elapsed;
+
+        /* one to count, the allocations and ioctls are the same every time */
+        if (ways[i].run(card) < 0) {
+            fprintf(stderr, "%s: failed to open the mixer\n", ways[i].name);
+            return -1;
+        }
+        allocs = alloc_count - allocs;
+        bytes = alloc_bytes - bytes;
+        ioctls = ioctl_count - ioctls;
+
+        start = now_ns();
+        do {
+            ways[i].run(card);
+            opens++;
+            elapsed = now_ns() - start;
+        } while (elapsed < BENCH_NS);
+
+        printf("%-22s %9.1f us %12lu %12llu %8lu\n", ways[i].name,
+               (double)elapsed / opens / 1000, allocs, bytes, ioctls);
+    }
+    return 0;
+}
+
+static struct mixer_ctl *lookup_hash(struct bench *b, const char *name)
+{
+    return mixer_get_ctl_by_name(b->mixer, name);
+}
+
+/* mixer_get_ctl_by_name() as it was before the index */
+static struct mixer_ctl *lookup_linear(struct bench *b, const char *name)
+{
+    unsigned int n;
+
+    for (n = 0; n < b->count; n++)
+        if (!strcmp(name, (char *)b->info[n].id.name))
+            return mixer_get_ctl(b->mixer, n);
+
+    return NULL;
+}
+
+/* ns per lookup, looking up every name in turn for at least BENCH_NS */
+static double time_lookups(struct bench *b, const char **names,
+                           struct mixer_ctl *(*lookup)(struct bench *b, const char *name))
+{
+    unsigned long long lookups = 0;
+    uint64_t start = now_ns(), elapsed;
+    uintptr_t sum = 0;
+    unsigned int n;
+
+    do {
+        for (n = 0; n < b->count; n++)
+            sum += (uintptr_t)lookup(b, names[n]);
+        lookups += b->count;
+        elapsed = now_ns() - start;
+    } while (elapsed < BENCH_NS);
+
+    /* keep the lookups from being optimised away */
+    if (sum == 1)
+        printf("\n");
+    return (double)elapsed / lookups;
+}
+
+static int bench_lookups(struct bench *b)
+{
+    double hash, linear;
+    unsigned int n;
+
+    for (n = 0; n < b->count; n++) {
+        if (lookup_hash(b, b->names[n]) != lookup_linear(b, b->names[n]) ||
+            lookup_hash(b, b->missing[n])) {
+            fprintf(stderr, "Lookup of '%s' differs from the linear scan\n",
+                    b->names[n]);
+            return -1;
+        }
+    }
+
+    printf("%-22s %12s %12s %8s\n", "mixer_get_ctl_by_name", "linear", "hash", "speedup");
+    linear = time_lookups(b, b->names, lookup_linear);
+    hash = time_lookups(b, b->names, lookup_hash);
+    printf("%-22s %9.1f ns %9.1f ns %7.0fx\n", "every control", linear, hash,
+           linear / hash);
+    linear = time_lookups(b, b->missing, lookup_linear);
+    hash = time_lookups(b, b->missing, lookup_hash);
+    printf("%-22s %9.1f ns %9.1f ns %7.0fx\n", "names not on the card", linear, hash,
+           linear / hash);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    unsigned int card = 0;
+    unsigned int n;
+    char *missing = NULL;
+    int ret = 1;
+
+    /* parse command line arguments */
+    argv += 1;
+    while (*argv) {
+        if (strcmp(*argv, "-D") == 0) {
+            argv++;
+            if (*argv)
+                card = atoi(*argv);
+        } else if (strcmp(*argv, "-s") == 0) {
+            argv++;
+            if (*argv)
+                synthetic_controls = atoi(*argv);
+        } else {
+            fprintf(stderr, "Usage: mixerbench [-D card] [-s synthetic_controls]\n");
+            return 1;
+        }
+        if (*argv)
+            argv++;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.mixer = mixer_open(card);
+    if (!b.mixer) {
+        fprintf(stderr, "Failed to open mixer\n");
+        return 1;
+    }
+    b.count = mixer_get_num_ctls(b.mixer);
+    if (!b.count) {
+        fprintf(stderr, "The card has no controls\n");
+        goto done;
+    }
+
+    b.info = calloc(b.count, sizeof(*b.info));
+    b.names = calloc(b.count, sizeof(*b.names));
+    b.missing = calloc(b.count, sizeof(*b.missing));
+    missing = calloc(b.count, sizeof(b.info->id.name));
+    if (!b.info || !b.names || !b.missing || !missing) {
+        fprintf(stderr, "Unable to allocate buffers\n");
+        goto done;
+    }
+    for (n = 0; n < b.count; n++) {
+        const char *name = mixer_ctl_get_name(mixer_get_ctl(b.mixer, n));
+        char *m = missing + n * sizeof(b.info->id.name);
+
+        strncpy((char *)b.info[n].id.name, name, sizeof(b.info->id.name) - 1);
+        b.names[n] = (char *)b.info[n].id.name;
+        /* same length and prefix as a real name, so strcmp() gets as far */
+        snprintf(m, sizeof(b.info->id.name), "%s", name);
+        m[strlen(m) - 1] ^= 0x40;
+        b.missing[n] = m;
+    }
+
+    printf("%s: %u controls\n", mixer_get_name(b.mixer), b.count);
+    if (bench_lookups(&b) < 0)
+        goto done;
+    printf("\n");
+    if (bench_open(card) < 0)
+        goto done;
+    ret = 0;
+
+done:
+    free(missing);
+    free(b.missing);
+    free(b.names);
+    free(b.info);
+    mixer_close(b.mixer);
+    return ret;
+}
@@ -38,7 +38,10 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
 
 #include <linux/ioctl.h>
 #define __force
@@ -47,6 +50,8 @@
 #include <sound/asound.h>
 
 #include "asoundlib.h"
+#include "gain.h"
+#include "trace.h"
 
 #define PARAM_MAX SNDRV_PCM_HW_PARAM_LAST_INTERVAL
 #define SNDRV_PCM_HW_PARAMS_NO_PERIOD_WAKEUP (1<<2)
@@ -93,6 +98,14 @@ static void param_set_min(struct snd_pcm_hw_params *p, int n, unsigned int val)
     }
 }
 
+static void param_set_max(struct snd_pcm_hw_params *p, int n, unsigned int val)
+{
+    if (param_is_interval(n)) {
+        struct snd_interval *i = param_to_interval(p, n);
+        i->max = val;
+    }
+}
+
 static unsigned int param_get_min(struct snd_pcm_hw_params *p, int n)
 {
     if (param_is_interval(n)) {
@@ -155,6 +168,34 @@ static void param_init(struct snd_pcm_hw_params *p)
 
 #define PCM_ERROR_MAX 128
 
+#define PCM_MAX_CARDS       32
+
+/* capability cache, see pcm_params_get_cached(). Elsewhere than Android
+ * the default is per user, under $XDG_CACHE_HOME or ~/.cache */
+#if !defined(PCM_CACHE_PATH) && defined(__ANDROID__)
+#define PCM_CACHE_PATH      "/data/misc/audio/tinyalsa_pcm.cache"
+#endif
+#define PCM_CACHE_NAME      "tinyalsa_pcm.cache"
+#define PCM_CACHE_MAGIC     0x4d434350  /* "PCCM" */
+#define PCM_CACHE_VERSION   2
+#define PCM_CACHE_ENTRIES   64
+
+struct pcm_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+};
+
+struct pcm_cache_entry {
+    char card_id[16];
+    uint32_t fingerprint;   /* of the card and pcm info, see pcm_fingerprint() */
+    uint32_t device;
+    uint32_t flags;
+    uint32_t request;       /* 0 for the capabilities, else a negotiation */
+    struct snd_pcm_hw_params params;
+};
+
 struct pcm {
     int fd;
     unsigned int flags;
@@ -168,8 +209,23 @@ struct pcm {
     struct snd_pcm_mmap_control *mmap_control;
     struct snd_pcm_sync_ptr *sync_ptr;
     void *mmap_buffer;
+    struct pcm_channel_area *areas;     /* one per channel, mmap only */
     unsigned int noirq_frames_per_msec;
     int wait_for_avail_min;
+    int xrun;               /* until data moves again */
+
+    /* software gain, created by the first pcm_set_gain() or pcm_set_mute() */
+    struct gain *gain;
+    int gain_db;
+    int gain_muted;
+    enum pcm_ramp gain_ramp;
+    void *gain_buf;         /* pcm_write() data after gain */
+    unsigned int gain_buf_size;
+
+    /* PCM_STATS, written only by the thread moving data */
+    struct pcm_stats *stats;
+    uint64_t stats_wakeup_us;   /* last wakeup, 0 when not running */
+    uint64_t stats_xrun_us;     /* pending xrun, 0 once recovered */
 };
 
 unsigned int pcm_get_buffer_size(struct pcm *pcm)
@@ -213,6 +269,15 @@ static unsigned int pcm_format_to_alsa(enum pcm_format format)
     };
 }
 
+static unsigned int pcm_access(unsigned int flags)
+{
+    if (flags & PCM_NONINTERLEAVED)
+        return flags & PCM_MMAP ? SNDRV_PCM_ACCESS_MMAP_NONINTERLEAVED :
+                                  SNDRV_PCM_ACCESS_RW_NONINTERLEAVED;
+    return flags & PCM_MMAP ? SNDRV_PCM_ACCESS_MMAP_INTERLEAVED :
+                              SNDRV_PCM_ACCESS_RW_INTERLEAVED;
+}
+
 unsigned int pcm_format_to_bits(enum pcm_format format)
 {
     switch (format) {
@@ -237,10 +302,162 @@ unsigned int pcm_frames_to_bytes(struct pcm *pcm, unsigned int frames)
         (pcm_format_to_bits(pcm->config.format) >> 3);
 }
 
+/* One writer, so a relaxed load and store is enough and costs no more than
+ * a plain increment; readers load each counter whole. */
+#define PCM_STATS_ADD(p, v) \
+    __atomic_store_n((p), __atomic_load_n((p), __ATOMIC_RELAXED) + (v), __ATOMIC_RELAXED)
+#define PCM_STATS_GET(p)    __atomic_load_n((p), __ATOMIC_RELAXED)
+
+static uint64_t pcm_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* values below 8 get a bucket each, then 8 per power of two */
+static unsigned int pcm_histogram_bucket(unsigned int v)
+{
+    unsigned int k;
+
+    if (v < 8)
+        return v;
+    k = 31 - __builtin_clz(v);
+    return (k - 2) * 8 + ((v >> (k - 3)) & 7);
+}
+
+static void pcm_histogram_add(struct pcm_histogram *hist, uint64_t v)
+{
+    unsigned int x = v > UINT_MAX ? UINT_MAX : v;
+
+    PCM_STATS_ADD(&hist->count[pcm_histogram_bucket(x)], 1);
+    PCM_STATS_ADD(&hist->samples, 1);
+    PCM_STATS_ADD(&hist->sum, x);
+    if (x > PCM_STATS_GET(&hist->max))
+        __atomic_store_n(&hist->max, x, __ATOMIC_RELAXED);
+}
+
+static int pcm_mmap_avail(struct pcm *pcm);
+
+/* back from blocking since start, having waited for frames of audio */
+static void pcm_stats_wakeup(struct pcm *pcm, uint64_t start, unsigned int frames)
+{
+    struct pcm_stats *stats = pcm->stats;
+    uint64_t now = pcm_stats_now();
+
+    pcm_histogram_add(&stats->blocked, now - start);
+    if (pcm->stats_wakeup_us) {
+        int64_t expected = (uint64_t)frames * 1000000 / pcm->config.rate;
+        int64_t off = (int64_t)(now - pcm->stats_wakeup_us) - expected;
+
+        pcm_histogram_add(&stats->jitter, off < 0 ? -off : off);
+    }
+    pcm->stats_wakeup_us = now;
+
+    /* only when the status page is mapped, it costs a syscall otherwise */
+    if (!pcm->sync_ptr && pcm->mmap_status)
+        pcm_histogram_add(&stats->avail, pcm_mmap_avail(pcm));
+}
+
+static void pcm_stats_xrun(struct pcm *pcm)
+{
+    PCM_STATS_ADD(&pcm->stats->xruns, 1);
+    if (!pcm->stats_xrun_us)
+        pcm->stats_xrun_us = pcm_stats_now();
+    pcm->stats_wakeup_us = 0;
+}
+
+static void pcm_stats_ioctl(struct pcm *pcm, unsigned long request, int rc,
+                            uint64_t start, void *arg)
+{
+    enum pcm_stats_ioctl type;
+    int err = errno;
+
+    switch (request) {
+    case SNDRV_PCM_IOCTL_WRITEI_FRAMES:
+    case SNDRV_PCM_IOCTL_READI_FRAMES:
+    case SNDRV_PCM_IOCTL_WRITEN_FRAMES:
+    case SNDRV_PCM_IOCTL_READN_FRAMES:
+        type = PCM_STATS_IOCTL_TRANSFER;
+        break;
+    case SNDRV_PCM_IOCTL_SYNC_PTR:
+        type = PCM_STATS_IOCTL_SYNC_PTR;
+        break;
+    case SNDRV_PCM_IOCTL_PREPARE:
+        type = PCM_STATS_IOCTL_PREPARE;
+        break;
+    case SNDRV_PCM_IOCTL_START:
+        type = PCM_STATS_IOCTL_START;
+        break;
+    case SNDRV_PCM_IOCTL_DROP:
+        type = PCM_STATS_IOCTL_DROP;
+        break;
+    default:
+        type = PCM_STATS_IOCTL_OTHER;
+        break;
+    }
+    PCM_STATS_ADD(&pcm->stats->ioctls[type], 1);
+
+    if (type == PCM_STATS_IOCTL_TRANSFER) {
+        if (rc < 0) {
+            if (err == EPIPE)
+                pcm_stats_xrun(pcm);
+        } else {
+            /* snd_xfern has frames in the same place */
+            pcm_stats_wakeup(pcm, start, ((struct snd_xferi *)arg)->frames);
+        }
+    } else if (type != PCM_STATS_IOCTL_SYNC_PTR && type != PCM_STATS_IOCTL_OTHER) {
+        pcm->stats_wakeup_us = 0;
+    }
+
+    if (rc == 0 && pcm->stats_xrun_us &&
+        (type == PCM_STATS_IOCTL_TRANSFER || type == PCM_STATS_IOCTL_START)) {
+        pcm_histogram_add(&pcm->stats->recovery, pcm_stats_now() - pcm->stats_xrun_us);
+        pcm->stats_xrun_us = 0;
+    }
+    errno = err;
+}
+
+static void pcm_xrun(struct pcm *pcm)
+{
+    if (!pcm->xrun) {
+        pcm->xrun = 1;
+        TRACE_PROBE1(pcm_xrun, pcm);
+    }
+}
+
+/* every ioctl on an open stream goes through here, for xruns and PCM_STATS */
+static int pcm_ioctl(struct pcm *pcm, unsigned long request, void *arg)
+{
+    uint64_t start = 0;
+    int rc;
+
+    if (pcm->stats)
+        start = pcm_stats_now();
+
+    rc = ioctl(pcm->fd, request, arg);
+    if (rc < 0 && errno == EPIPE) {
+        pcm_xrun(pcm);
+    } else if (rc == 0 && pcm->xrun &&
+               (request == SNDRV_PCM_IOCTL_START ||
+                request == SNDRV_PCM_IOCTL_WRITEI_FRAMES ||
+                request == SNDRV_PCM_IOCTL_READI_FRAMES ||
+                request == SNDRV_PCM_IOCTL_WRITEN_FRAMES ||
+                request == SNDRV_PCM_IOCTL_READN_FRAMES)) {
+        pcm->xrun = 0;
+        TRACE_PROBE1(pcm_xrun_recovered, pcm);
+    }
+
+    if (pcm->stats)
+        pcm_stats_ioctl(pcm, request, rc, start, arg);
+    return rc;
+}
+
 static int pcm_sync_ptr(struct pcm *pcm, int flags) {
     if (pcm->sync_ptr) {
         pcm->sync_ptr->flags = flags;
-        if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_SYNC_PTR, pcm->sync_ptr) < 0)
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_SYNC_PTR, pcm->sync_ptr) < 0)
             return -1;
     }
     return 0;
@@ -307,19 +524,92 @@ static void pcm_hw_munmap_status(struct pcm *pcm) {
     pcm->mmap_control = NULL;
 }
 
+static int pcm_mmap_areas(struct pcm *pcm)
+{
+    struct snd_pcm_channel_info info;
+    unsigned int bits = pcm_format_to_bits(pcm->config.format);
+    unsigned int c;
+
+    pcm->areas = calloc(pcm->config.channels, sizeof(*pcm->areas));
+    if (!pcm->areas)
+        return -ENOMEM;
+
+    for (c = 0; c < pcm->config.channels; c++) {
+        struct pcm_channel_area *area = &pcm->areas[c];
+
+        area->addr = pcm->mmap_buffer;
+        if (!(pcm->flags & PCM_NONINTERLEAVED)) {
+            area->first = c * bits;
+            area->step = pcm->config.channels * bits;
+            continue;
+        }
+
+        /* the driver decides where each channel goes, usually one block
+         * after another */
+        memset(&info, 0, sizeof(info));
+        info.channel = c;
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_CHANNEL_INFO, &info) == 0 &&
+            info.step && info.offset + (info.first + (pcm->buffer_size - 1) *
+                info.step + bits) / 8 <= pcm_frames_to_bytes(pcm, pcm->buffer_size)) {
+            area->addr = (char*)pcm->mmap_buffer + info.offset;
+            area->first = info.first;
+            area->step = info.step;
+        } else {
+            area->first = c * pcm->buffer_size * bits;
+            area->step = bits;
+        }
+    }
+    return 0;
+}
+
+/* buf is planar for a non-interleaved stream, each channel buf_frames long */
+static void pcm_areas_copy_planar(struct pcm *pcm, unsigned int pcm_offset,
+                                  char *buf, unsigned int src_offset,
+                                  unsigned int frames, unsigned int buf_frames)
+{
+    unsigned int bytes = pcm_format_to_bits(pcm->config.format) / 8;
+    unsigned int c, i;
+
+    for (c = 0; c < pcm->config.channels; c++) {
+        const struct pcm_channel_area *area = &pcm->areas[c];
+        char *dst = (char*)area->addr + (area->first + pcm_offset * area->step) / 8;
+        char *src = buf + (c * buf_frames + src_offset) * bytes;
+        unsigned int step = area->step / 8;
+
+        if (step == bytes) {
+            if (pcm->flags & PCM_IN)
+                memcpy(src, dst, frames * bytes);
+            else
+                memcpy(dst, src, frames * bytes);
+            continue;
+        }
+        for (i = 0; i < frames; i++, dst += step, src += bytes) {
+            if (pcm->flags & PCM_IN)
+                memcpy(src, dst, bytes);
+            else
+                memcpy(dst, src, bytes);
+        }
+    }
+}
+
 static int pcm_areas_copy(struct pcm *pcm, unsigned int pcm_offset,
                           char *buf, unsigned int src_offset,
-                          unsigned int frames)
+                          unsigned int frames, unsigned int buf_frames)
 {
     int size_bytes = pcm_frames_to_bytes(pcm, frames);
     int pcm_offset_bytes = pcm_frames_to_bytes(pcm, pcm_offset);
     int src_offset_bytes = pcm_frames_to_bytes(pcm, src_offset);
 
-    /* interleaved only atm */
-    if (pcm->flags & PCM_IN)
+    if (pcm->flags & PCM_NONINTERLEAVED)
+        pcm_areas_copy_planar(pcm, pcm_offset, buf, src_offset, frames,
+                              buf_frames);
+    else if (pcm->flags & PCM_IN)
         memcpy(buf + src_offset_bytes,
                (char*)pcm->mmap_buffer + pcm_offset_bytes,
                size_bytes);
+    else if (pcm->gain && !gain_is_unity(pcm->gain))
+        gain_apply(pcm->gain, (char*)pcm->mmap_buffer + pcm_offset_bytes,
+                   buf + src_offset_bytes, frames);
     else
         memcpy((char*)pcm->mmap_buffer + pcm_offset_bytes,
                buf + src_offset_bytes,
@@ -328,7 +618,8 @@ static int pcm_areas_copy(struct pcm *pcm, unsigned int pcm_offset,
 }
 
 static int pcm_mmap_transfer_areas(struct pcm *pcm, char *buf,
-                                unsigned int offset, unsigned int size)
+                                unsigned int offset, unsigned int size,
+                                unsigned int buf_frames)
 {
     void *pcm_areas;
     int commit;
@@ -337,7 +628,7 @@ static int pcm_mmap_transfer_areas(struct pcm *pcm, char *buf,
     while (size > 0) {
         frames = size;
         pcm_mmap_begin(pcm, &pcm_areas, &pcm_offset, &frames);
-        pcm_areas_copy(pcm, pcm_offset, buf, offset, frames);
+        pcm_areas_copy(pcm, pcm_offset, buf, offset, frames, buf_frames);
         commit = pcm_mmap_commit(pcm, pcm_offset, frames);
         if (commit < 0) {
             oops(pcm, commit, "failed to commit %d frames\n", frames);
@@ -389,27 +680,39 @@ int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail,
     return 0;
 }
 
-int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+static int pcm_writei(struct pcm *pcm, const void *data, unsigned int count)
 {
     struct snd_xferi x;
 
-    if (pcm->flags & PCM_IN)
+    if (pcm->flags & (PCM_IN | PCM_NONINTERLEAVED))
         return -EINVAL;
 
     x.buf = (void*)data;
     x.frames = count / (pcm->config.channels *
                         pcm_format_to_bits(pcm->config.format) / 8);
 
+    if (pcm->gain && !gain_is_unity(pcm->gain)) {
+        if (count > pcm->gain_buf_size) {
+            void *buf = realloc(pcm->gain_buf, count);
+            if (!buf)
+                return oops(pcm, ENOMEM, "cannot allocate gain buffer");
+            pcm->gain_buf = buf;
+            pcm->gain_buf_size = count;
+        }
+        gain_apply(pcm->gain, pcm->gain_buf, data, x.frames);
+        x.buf = pcm->gain_buf;
+    }
+
     for (;;) {
         if (!pcm->running) {
-            if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_PREPARE))
+            if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_PREPARE, NULL))
                 return oops(pcm, errno, "cannot prepare channel");
-            if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &x))
+            if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &x))
                 return oops(pcm, errno, "cannot write initial data");
             pcm->running = 1;
             return 0;
         }
-        if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &x)) {
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &x)) {
             pcm->running = 0;
             if (errno == EPIPE) {
                 /* we failed to make our window -- try to restart if we are
@@ -426,11 +729,11 @@ int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
     }
 }
 
-int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+static int pcm_readi(struct pcm *pcm, void *data, unsigned int count)
 {
     struct snd_xferi x;
 
-    if (!(pcm->flags & PCM_IN))
+    if ((pcm->flags & (PCM_IN | PCM_NONINTERLEAVED)) != PCM_IN)
         return -EINVAL;
 
     x.buf = data;
@@ -444,7 +747,7 @@ int pcm_read(struct pcm *pcm, void *data, unsigned int count)
                 return -errno;
             }
         }
-        if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_READI_FRAMES, &x)) {
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_READI_FRAMES, &x)) {
             pcm->running = 0;
             if (errno == EPIPE) {
                     /* we failed to make our window -- try to restart */
@@ -457,6 +760,86 @@ int pcm_read(struct pcm *pcm, void *data, unsigned int count)
     }
 }
 
+int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    int rc;
+
+    TRACE_PROBE2(pcm_write_entry, pcm, pcm_bytes_to_frames(pcm, count));
+    rc = pcm_writei(pcm, data, count);
+    TRACE_PROBE2(pcm_write_exit, pcm, rc);
+    return rc;
+}
+
+int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    int rc;
+
+    TRACE_PROBE2(pcm_read_entry, pcm, pcm_bytes_to_frames(pcm, count));
+    rc = pcm_readi(pcm, data, count);
+    TRACE_PROBE2(pcm_read_exit, pcm, rc);
+    return rc;
+}
+
+int pcm_writen(struct pcm *pcm, void **data, unsigned int count)
+{
+    struct snd_xfern x;
+
+    if ((pcm->flags & (PCM_IN | PCM_NONINTERLEAVED)) != PCM_NONINTERLEAVED)
+        return -EINVAL;
+
+    x.bufs = data;
+    x.frames = count;
+
+    for (;;) {
+        if (!pcm->running) {
+            if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_PREPARE, NULL))
+                return oops(pcm, errno, "cannot prepare channel");
+            if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &x))
+                return oops(pcm, errno, "cannot write initial data");
+            pcm->running = 1;
+            return 0;
+        }
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &x)) {
+            pcm->running = 0;
+            if (errno == EPIPE) {
+                pcm->underruns++;
+                if (pcm->flags & PCM_NORESTART)
+                    return -EPIPE;
+                continue;
+            }
+            return oops(pcm, errno, "cannot write stream data");
+        }
+        return 0;
+    }
+}
+
+int pcm_readn(struct pcm *pcm, void **data, unsigned int count)
+{
+    struct snd_xfern x;
+
+    if ((~pcm->flags) & (PCM_IN | PCM_NONINTERLEAVED))
+        return -EINVAL;
+
+    x.bufs = data;
+    x.frames = count;
+
+    for (;;) {
+        if (!pcm->running) {
+            if (pcm_start(pcm) < 0)
+                return -errno;
+        }
+        if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_READN_FRAMES, &x)) {
+            pcm->running = 0;
+            if (errno == EPIPE) {
+                pcm->underruns++;
+                continue;
+            }
+            return oops(pcm, errno, "cannot read stream data");
+        }
+        return 0;
+    }
+}
+
 static struct pcm bad_pcm = {
     .fd = -1,
 };
@@ -499,6 +882,495 @@ err_open:
     return NULL;
 }
 
+static uint32_t pcm_hash(uint32_t h, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+
+    while (size--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+/* Identifies a card and one of its pcms from the control device alone, so
+ * a cache hit never opens the pcm node. Leaves out what changes while the
+ * pcm is in use (subdevices_avail). */
+static int pcm_fingerprint(unsigned int card, unsigned int device,
+                           unsigned int flags, char *card_id, uint32_t *fingerprint)
+{
+    struct snd_ctl_card_info card_info;
+    struct snd_pcm_info info;
+    char fn[256];
+    uint32_t h = 2166136261u;
+    int fd;
+
+    snprintf(fn, sizeof(fn), "/dev/snd/controlC%u", card);
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+        return -errno;
+
+    memset(&info, 0, sizeof(info));
+    info.device = device;
+    info.stream = flags & PCM_IN ? SNDRV_PCM_STREAM_CAPTURE : SNDRV_PCM_STREAM_PLAYBACK;
+    if (ioctl(fd, SNDRV_CTL_IOCTL_CARD_INFO, &card_info) ||
+        ioctl(fd, SNDRV_CTL_IOCTL_PCM_INFO, &info)) {
+        close(fd);
+        return -errno;
+    }
+    close(fd);
+
+    h = pcm_hash(h, card_info.id, sizeof(card_info.id));
+    h = pcm_hash(h, card_info.driver, sizeof(card_info.driver));
+    h = pcm_hash(h, card_info.longname, sizeof(card_info.longname));
+    h = pcm_hash(h, card_info.components, sizeof(card_info.components));
+    h = pcm_hash(h, info.id, sizeof(info.id));
+    h = pcm_hash(h, info.name, sizeof(info.name));
+    h = pcm_hash(h, &info.dev_class, sizeof(info.dev_class));
+    h = pcm_hash(h, &info.dev_subclass, sizeof(info.dev_subclass));
+    h = pcm_hash(h, &info.subdevices_count, sizeof(info.subdevices_count));
+
+    memcpy(card_id, card_info.id, sizeof(card_info.id));
+    card_id[sizeof(card_info.id) - 1] = '\0';
+    *fingerprint = h;
+    return 0;
+}
+
+/* path, or the default cache file in buf; NULL if there is none */
+static const char *pcm_cache_path(const char *path, char *buf, size_t size)
+{
+#ifdef PCM_CACHE_PATH
+    return path ? path : PCM_CACHE_PATH;
+#else
+    const char *dir;
+    int n;
+
+    if (path)
+        return path;
+
+    dir = getenv("XDG_CACHE_HOME");
+    if (dir && dir[0] == '/') {
+        n = snprintf(buf, size, "%s/" PCM_CACHE_NAME, dir);
+    } else {
+        dir = getenv("HOME");
+        if (!dir || dir[0] != '/')
+            return NULL;
+        n = snprintf(buf, size, "%s/.cache", dir);
+        if (n < 0 || n >= (int)size)
+            return NULL;
+        mkdir(buf, 0700);
+        n = snprintf(buf, size, "%s/.cache/" PCM_CACHE_NAME, dir);
+    }
+    if (n < 0 || n >= (int)size)
+        return NULL;
+    return buf;
+#endif
+}
+
+/* the whole cache file, up to PCM_CACHE_ENTRIES; 0 if missing or stale.
+ * Entries steer how pcms are set up, so only a file that nobody but us
+ * could have written is trusted. */
+static unsigned int pcm_cache_load(const char *path, struct pcm_cache_entry *entries)
+{
+    struct pcm_cache_header header;
+    unsigned int count = 0;
+    struct stat st;
+    FILE *file;
+
+    if (!path)
+        return 0;
+
+    file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    if (fstat(fileno(file), &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        fclose(file);
+        return 0;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == PCM_CACHE_MAGIC && header.version == PCM_CACHE_VERSION &&
+        header.entry_size == sizeof(*entries) && header.count <= PCM_CACHE_ENTRIES)
+        count = fread(entries, sizeof(*entries), header.count, file);
+
+    fclose(file);
+    return count;
+}
+
+/* rewrites the file through a temporary one so readers never see half */
+static void pcm_cache_store(const char *path, const struct pcm_cache_entry *entries,
+                            unsigned int count)
+{
+    struct pcm_cache_header header;
+    char tmp[PATH_MAX];
+    FILE *file;
+    int fd;
+
+    if (!path)
+        return;
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+        return;
+    fd = mkstemp(tmp);
+    if (fd < 0)
+        return;
+    /* other users of the card may read it */
+    fchmod(fd, 0644);
+    file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(tmp);
+        return;
+    }
+
+    header.magic = PCM_CACHE_MAGIC;
+    header.version = PCM_CACHE_VERSION;
+    header.entry_size = sizeof(*entries);
+    header.count = count;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(entries, sizeof(*entries), count, file) != count) {
+        fclose(file);
+        unlink(tmp);
+        return;
+    }
+    if (fclose(file) || rename(tmp, path))
+        unlink(tmp);
+}
+
+/* Looks up the entry with key's card, device, flags and request. A hit
+ * needs the fingerprint to match too and copies the params out. */
+static int pcm_cache_get(const char *path, const struct pcm_cache_entry *key,
+                         struct snd_pcm_hw_params *params)
+{
+    struct pcm_cache_entry *entries;
+    unsigned int count, i;
+    int hit = 0;
+
+    entries = calloc(PCM_CACHE_ENTRIES, sizeof(*entries));
+    if (!entries)
+        return 0;
+
+    count = pcm_cache_load(path, entries);
+    for (i = 0; i < count; i++) {
+        if (!strcmp(entries[i].card_id, key->card_id) && entries[i].device == key->device &&
+            entries[i].flags == key->flags && entries[i].request == key->request) {
+            hit = entries[i].fingerprint == key->fingerprint;
+            if (hit)
+                *params = entries[i].params;
+            break;
+        }
+    }
+
+    free(entries);
+    return hit;
+}
+
+/* replaces the stale entry for entry's key, or makes room by dropping the
+ * oldest */
+static void pcm_cache_put(const char *path, const struct pcm_cache_entry *entry)
+{
+    struct pcm_cache_entry *entries;
+    unsigned int count, i;
+
+    entries = calloc(PCM_CACHE_ENTRIES, sizeof(*entries));
+    if (!entries)
+        return;
+
+    count = pcm_cache_load(path, entries);
+    for (i = 0; i < count; i++) {
+        if (!strcmp(entries[i].card_id, entry->card_id) && entries[i].device == entry->device &&
+            entries[i].flags == entry->flags && entries[i].request == entry->request)
+            break;
+    }
+    if (i == count) {
+        if (count == PCM_CACHE_ENTRIES) {
+            memmove(entries, entries + 1, (count - 1) * sizeof(*entries));
+            i = count - 1;
+        } else {
+            count++;
+        }
+    }
+    entries[i] = *entry;
+    pcm_cache_store(path, entries, count);
+
+    free(entries);
+}
+
+/* the cache key of a pcm, 0 if its control device can't vouch for it */
+static int pcm_cache_key(unsigned int card, unsigned int device, unsigned int flags,
+                         struct pcm_cache_entry *key)
+{
+    memset(key, 0, sizeof(*key));
+    if (pcm_fingerprint(card, device, flags, key->card_id, &key->fingerprint) < 0)
+        return 0;
+
+    key->device = device;
+    key->flags = flags & PCM_IN;
+    return 1;
+}
+
+struct pcm_params *pcm_params_get_cached(unsigned int card, unsigned int device,
+                                         unsigned int flags, const char *cache_path)
+{
+    struct pcm_cache_entry key;
+    struct snd_pcm_hw_params *params;
+    char buf[PATH_MAX];
+
+    /* no control device to check against, nothing to trust the cache with */
+    if (!pcm_cache_key(card, device, flags, &key))
+        return pcm_params_get(card, device, flags);
+
+    cache_path = pcm_cache_path(cache_path, buf, sizeof(buf));
+
+    params = malloc(sizeof(*params));
+    if (params && pcm_cache_get(cache_path, &key, params))
+        return (struct pcm_params *)params;
+    free(params);
+
+    params = (struct snd_pcm_hw_params *)pcm_params_get(card, device, flags);
+    if (params) {
+        key.params = *params;
+        pcm_cache_put(cache_path, &key);
+    }
+    return (struct pcm_params *)params;
+}
+
+static int param_refine(int fd, struct snd_pcm_hw_params *p)
+{
+    p->rmask = ~0U;
+    p->cmask = 0;
+    return ioctl(fd, SNDRV_PCM_IOCTL_HW_REFINE, p) ? -errno : 0;
+}
+
+/* Narrows interval n of p to the supported value nearest to want, ties
+ * going up, and returns it; p is left alone on failure. */
+static int param_refine_near(int fd, struct snd_pcm_hw_params *p, int n,
+                             unsigned int want, unsigned int *got)
+{
+    struct snd_pcm_hw_params below = *p, above = *p;
+    unsigned int lo = 0, hi = 0;
+    int have_lo, have_hi;
+
+    param_set_int(&above, n, want);
+    if (param_refine(fd, &above) == 0) {
+        *p = above;
+        *got = want;
+        return 0;
+    }
+
+    above = *p;
+    param_set_max(&below, n, want);
+    param_set_min(&above, n, want);
+    have_lo = param_refine(fd, &below) == 0;
+    have_hi = param_refine(fd, &above) == 0;
+    if (have_lo)
+        lo = param_get_max(&below, n);
+    if (have_hi)
+        hi = param_get_min(&above, n);
+    if (!have_lo && !have_hi)
+        return -EINVAL;
+
+    *got = (have_hi && (!have_lo || hi - want <= want - lo)) ? hi : lo;
+    param_set_int(p, n, *got);
+    return param_refine(fd, p);
+}
+
+static int pcm_format_supported(struct pcm_mask *mask, enum pcm_format format)
+{
+    unsigned int bit = pcm_format_to_alsa(format);
+
+    return (mask->bits[bit >> 5] >> (bit & 31)) & 1;
+}
+
+/* the period size and count that make up latency_ms, or the ones asked for */
+static void pcm_latency_periods(const struct pcm_config *config, unsigned int latency_ms,
+                                unsigned int *period_size, unsigned int *period_count)
+{
+    *period_count = config->period_count ? config->period_count : 4;
+    if (*period_count < 2)
+        *period_count = 2;
+
+    if (latency_ms)
+        *period_size = (unsigned long long)config->rate * latency_ms /
+            (1000 * *period_count);
+    else
+        *period_size = config->period_size;
+    if (!*period_size)
+        *period_size = 1;
+}
+
+static enum pcm_format pcm_format_from_alsa(unsigned int format)
+{
+    switch (format) {
+    case SNDRV_PCM_FORMAT_S32_LE:
+        return PCM_FORMAT_S32_LE;
+    case SNDRV_PCM_FORMAT_S8:
+        return PCM_FORMAT_S8;
+    case SNDRV_PCM_FORMAT_S24_LE:
+        return PCM_FORMAT_S24_LE;
+    default:
+    case SNDRV_PCM_FORMAT_S16_LE:
+        return PCM_FORMAT_S16_LE;
+    };
+}
+
+/* the negotiated config, read back from fully refined params */
+static void pcm_config_from_params(struct snd_pcm_hw_params *params,
+                                   struct pcm_config *config)
+{
+    struct snd_mask *m = param_to_mask(params, SNDRV_PCM_HW_PARAM_FORMAT);
+    unsigned int bit;
+
+    for (bit = 0; bit < 64 && !(m->bits[bit >> 5] & (1U << (bit & 31))); bit++)
+        ;
+    config->format = pcm_format_from_alsa(bit);
+    config->channels = param_get_min(params, SNDRV_PCM_HW_PARAM_CHANNELS);
+    config->rate = param_get_min(params, SNDRV_PCM_HW_PARAM_RATE);
+    config->period_size = param_get_min(params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE);
+    config->period_count = param_get_min(params, SNDRV_PCM_HW_PARAM_PERIODS);
+}
+
+int pcm_negotiate_config(unsigned int card, unsigned int device, unsigned int flags,
+                         struct pcm_config *config, unsigned int latency_ms,
+                         const char *cache_path)
+{
+    static const enum pcm_format formats[] = {
+        PCM_FORMAT_S16_LE, PCM_FORMAT_S32_LE, PCM_FORMAT_S24_LE,
+    };
+    struct snd_pcm_hw_params params;
+    struct pcm_cache_entry key;
+    struct pcm_config want = *config;
+    unsigned int i, period_size, period_count, request[7];
+    char fn[256], buf[PATH_MAX];
+    int fd, rc, cache;
+
+    pcm_latency_periods(&want, latency_ms, &want.period_size, &want.period_count);
+
+    /* The same request on the same hardware settles the same way, so the
+     * outcome is cached and a hit never opens the pcm. */
+    cache_path = pcm_cache_path(cache_path, buf, sizeof(buf));
+    cache = cache_path && pcm_cache_key(card, device, flags, &key);
+    if (cache) {
+        request[0] = want.channels;
+        request[1] = want.rate;
+        request[2] = want.format;
+        request[3] = want.period_size;
+        request[4] = want.period_count;
+        request[5] = latency_ms;
+        request[6] = flags & (PCM_MMAP | PCM_NONINTERLEAVED);
+        key.request = pcm_hash(2166136261u, request, sizeof(request)) | 1;
+        if (pcm_cache_get(cache_path, &key, &params)) {
+            pcm_config_from_params(&params, config);
+            return 0;
+        }
+    }
+
+    snprintf(fn, sizeof(fn), "/dev/snd/pcmC%uD%u%c", card, device,
+             flags & PCM_IN ? 'c' : 'p');
+    fd = open(fn, O_RDWR | O_NONBLOCK);
+    if (fd < 0)
+        return -errno;
+
+    param_init(&params);
+    param_set_mask(&params, SNDRV_PCM_HW_PARAM_ACCESS, pcm_access(flags));
+    param_set_mask(&params, SNDRV_PCM_HW_PARAM_SUBFORMAT, SNDRV_PCM_SUBFORMAT_STD);
+    rc = param_refine(fd, &params);
+    if (rc < 0)
+        goto done;
+
+    /* the format asked for, else the first one we can convert to */
+    if (!pcm_format_supported((struct pcm_mask *)param_to_mask(&params,
+                              SNDRV_PCM_HW_PARAM_FORMAT), want.format)) {
+        for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+            if (pcm_format_supported((struct pcm_mask *)param_to_mask(&params,
+                                     SNDRV_PCM_HW_PARAM_FORMAT), formats[i]))
+                break;
+        }
+        if (i == sizeof(formats) / sizeof(formats[0])) {
+            rc = -EINVAL;
+            goto done;
+        }
+        want.format = formats[i];
+    }
+    param_set_mask(&params, SNDRV_PCM_HW_PARAM_FORMAT, pcm_format_to_alsa(want.format));
+    rc = param_refine(fd, &params);
+    if (rc < 0)
+        goto done;
+
+    rc = param_refine_near(fd, &params, SNDRV_PCM_HW_PARAM_CHANNELS,
+                           want.channels, &want.channels);
+    if (rc < 0)
+        goto done;
+    rc = param_refine_near(fd, &params, SNDRV_PCM_HW_PARAM_RATE, want.rate, &want.rate);
+    if (rc < 0)
+        goto done;
+
+    /* the latency budget is in time, so size periods at the rate we got */
+    pcm_latency_periods(&want, latency_ms, &period_size, &period_count);
+    rc = param_refine_near(fd, &params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE, period_size,
+                           &want.period_size);
+    if (rc < 0)
+        goto done;
+    rc = param_refine_near(fd, &params, SNDRV_PCM_HW_PARAM_PERIODS, period_count,
+                           &want.period_count);
+    if (rc < 0)
+        goto done;
+
+    pcm_config_from_params(&params, config);
+    if (cache) {
+        key.params = params;
+        pcm_cache_put(cache_path, &key);
+    }
+
+done:
+    close(fd);
+    return rc;
+}
+
+int pcm_get_devices(struct pcm_device_info *devs, unsigned int max)
+{
+    struct snd_ctl_card_info card_info;
+    struct snd_pcm_info info;
+    unsigned int card, n = 0;
+    char fn[256];
+    int fd, device, stream;
+
+    for (card = 0; card < PCM_MAX_CARDS; card++) {
+        snprintf(fn, sizeof(fn), "/dev/snd/controlC%u", card);
+        fd = open(fn, O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        if (ioctl(fd, SNDRV_CTL_IOCTL_CARD_INFO, &card_info)) {
+            close(fd);
+            continue;
+        }
+
+        device = -1;
+        while (!ioctl(fd, SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE, &device) && device >= 0) {
+            for (stream = SNDRV_PCM_STREAM_PLAYBACK; stream <= SNDRV_PCM_STREAM_CAPTURE; stream++) {
+                memset(&info, 0, sizeof(info));
+                info.device = device;
+                info.stream = stream;
+                if (ioctl(fd, SNDRV_CTL_IOCTL_PCM_INFO, &info))
+                    continue;
+
+                if (n < max) {
+                    devs[n].card = card;
+                    devs[n].device = device;
+                    devs[n].flags = stream == SNDRV_PCM_STREAM_CAPTURE ? PCM_IN : PCM_OUT;
+                    snprintf(devs[n].card_id, sizeof(devs[n].card_id), "%s",
+                             (char *)card_info.id);
+                    snprintf(devs[n].name, sizeof(devs[n].name), "%s", (char *)info.name);
+                }
+                n++;
+            }
+        }
+        close(fd);
+    }
+
+    return n;
+}
+
 void pcm_params_free(struct pcm_params *pcm_params)
 {
     struct snd_pcm_hw_params *params = (struct snd_pcm_hw_params *)pcm_params;
@@ -546,6 +1418,15 @@ static int pcm_param_to_alsa(enum pcm_param param)
     case PCM_PARAM_TICK_TIME:
         return SNDRV_PCM_HW_PARAM_TICK_TIME;
         break;
+    case PCM_PARAM_ACCESS:
+        return SNDRV_PCM_HW_PARAM_ACCESS;
+        break;
+    case PCM_PARAM_FORMAT:
+        return SNDRV_PCM_HW_PARAM_FORMAT;
+        break;
+    case PCM_PARAM_SUBFORMAT:
+        return SNDRV_PCM_HW_PARAM_SUBFORMAT;
+        break;
 
     default:
         return -1;
@@ -584,6 +1465,22 @@ unsigned int pcm_params_get_max(struct pcm_params *pcm_params,
     return param_get_max(params, p);
 }
 
+struct pcm_mask *pcm_params_get_mask(struct pcm_params *pcm_params,
+                                     enum pcm_param param)
+{
+    struct snd_pcm_hw_params *params = (struct snd_pcm_hw_params *)pcm_params;
+    int p;
+
+    if (!params)
+        return NULL;
+
+    p = pcm_param_to_alsa(param);
+    if (p < 0 || !param_is_mask(p))
+        return NULL;
+
+    return (struct pcm_mask *)param_to_mask(params, p);
+}
+
 int pcm_close(struct pcm *pcm)
 {
     if (pcm == &bad_pcm)
@@ -598,6 +1495,10 @@ int pcm_close(struct pcm *pcm)
 
     if (pcm->fd >= 0)
         close(pcm->fd);
+    gain_free(pcm->gain);
+    free(pcm->gain_buf);
+    free(pcm->areas);
+    free(pcm->stats);
     pcm->running = 0;
     pcm->buffer_size = 0;
     pcm->fd = -1;
@@ -631,7 +1532,15 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
         return pcm;
     }
 
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_INFO, &info)) {
+    if (flags & PCM_STATS) {
+        pcm->stats = calloc(1, sizeof(*pcm->stats));
+        if (!pcm->stats) {
+            oops(pcm, ENOMEM, "cannot allocate stats");
+            goto fail_close;
+        }
+    }
+
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_INFO, &info)) {
         oops(pcm, errno, "cannot get info");
         goto fail_close;
     }
@@ -662,14 +1571,9 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
         pcm->noirq_frames_per_msec = config->rate / 1000;
     }
 
-    if (flags & PCM_MMAP)
-        param_set_mask(&params, SNDRV_PCM_HW_PARAM_ACCESS,
-                   SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
-    else
-        param_set_mask(&params, SNDRV_PCM_HW_PARAM_ACCESS,
-                   SNDRV_PCM_ACCESS_RW_INTERLEAVED);
+    param_set_mask(&params, SNDRV_PCM_HW_PARAM_ACCESS, pcm_access(flags));
 
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_HW_PARAMS, &params)) {
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_HW_PARAMS, &params)) {
         oops(pcm, errno, "cannot set hw params");
         goto fail_close;
     }
@@ -687,6 +1591,11 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
                  pcm_frames_to_bytes(pcm, pcm->buffer_size));
             goto fail_close;
         }
+        rc = pcm_mmap_areas(pcm);
+        if (rc < 0) {
+            oops(pcm, rc, "cannot allocate channel areas");
+            goto fail;
+        }
     }
 
 
@@ -731,7 +1640,7 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
     while (pcm->boundary * 2 <= INT_MAX - pcm->buffer_size)
 		pcm->boundary *= 2;
 
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_SW_PARAMS, &sparams)) {
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_SW_PARAMS, &sparams)) {
         oops(pcm, errno, "cannot set sw params");
         goto fail;
     }
@@ -745,7 +1654,7 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
 #ifdef SNDRV_PCM_IOCTL_TTSTAMP
     if (pcm->flags & PCM_MONOTONIC) {
         int arg = SNDRV_PCM_TSTAMP_TYPE_MONOTONIC;
-        rc = ioctl(pcm->fd, SNDRV_PCM_IOCTL_TTSTAMP, &arg);
+        rc = pcm_ioctl(pcm, SNDRV_PCM_IOCTL_TTSTAMP, &arg);
         if (rc < 0) {
             oops(pcm, rc, "cannot set timestamp type");
             goto fail;
@@ -759,6 +1668,8 @@ struct pcm *pcm_open(unsigned int card, unsigned int device,
 fail:
     if (flags & PCM_MMAP)
         munmap(pcm->mmap_buffer, pcm_frames_to_bytes(pcm, pcm->buffer_size));
+    free(pcm->areas);
+    pcm->areas = NULL;
 fail_close:
     close(pcm->fd);
     pcm->fd = -1;
@@ -772,13 +1683,13 @@ int pcm_is_ready(struct pcm *pcm)
 
 int pcm_start(struct pcm *pcm)
 {
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_PREPARE) < 0)
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_PREPARE, NULL) < 0)
         return oops(pcm, errno, "cannot prepare channel");
 
     if (pcm->flags & PCM_MMAP)
 	    pcm_sync_ptr(pcm, 0);
 
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_START) < 0)
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_START, NULL) < 0)
         return oops(pcm, errno, "cannot start channel");
 
     pcm->running = 1;
@@ -787,7 +1698,7 @@ int pcm_start(struct pcm *pcm)
 
 int pcm_stop(struct pcm *pcm)
 {
-    if (ioctl(pcm->fd, SNDRV_PCM_IOCTL_DROP) < 0)
+    if (pcm_ioctl(pcm, SNDRV_PCM_IOCTL_DROP, NULL) < 0)
         return oops(pcm, errno, "cannot stop channel");
 
     pcm->running = 0;
@@ -841,8 +1752,11 @@ int pcm_mmap_begin(struct pcm *pcm, void **areas, unsigned int *offset,
 {
     unsigned int continuous, copy_frames, avail;
 
-    /* return the mmap buffer */
-    *areas = pcm->mmap_buffer;
+    /* return the mmap buffer, or where each channel is in it */
+    if (pcm->flags & PCM_NONINTERLEAVED)
+        *areas = pcm->areas;
+    else
+        *areas = pcm->mmap_buffer;
 
     /* and the application offset in frames */
     *offset = pcm->mmap_control->appl_ptr % pcm->buffer_size;
@@ -860,11 +1774,15 @@ int pcm_mmap_begin(struct pcm *pcm, void **areas, unsigned int *offset,
         copy_frames = continuous;
     *frames = copy_frames;
 
+    TRACE_PROBE3(pcm_mmap_begin, pcm, *offset, *frames);
+
     return 0;
 }
 
 int pcm_mmap_commit(struct pcm *pcm, unsigned int offset, unsigned int frames)
 {
+    TRACE_PROBE3(pcm_mmap_commit, pcm, offset, frames);
+
     /* update the application pointer in userspace and kernel */
     pcm_mmap_appl_forward(pcm, frames);
     pcm_sync_ptr(pcm, 0);
@@ -899,6 +1817,7 @@ int pcm_set_avail_min(struct pcm *pcm, int avail_min)
 int pcm_wait(struct pcm *pcm, int timeout)
 {
     struct pollfd pfd;
+    uint64_t start = 0;
     int err;
 
     pfd.fd = pcm->fd;
@@ -906,6 +1825,8 @@ int pcm_wait(struct pcm *pcm, int timeout)
 
     do {
         /* let's wait for avail or timeout */
+        if (pcm->stats)
+            start = pcm_stats_now();
         err = poll(&pfd, 1, timeout);
         if (err < 0)
             return -errno;
@@ -922,6 +1843,9 @@ int pcm_wait(struct pcm *pcm, int timeout)
         if (pfd.revents & (POLLERR | POLLNVAL)) {
             switch (pcm_state(pcm)) {
             case PCM_STATE_XRUN:
+                pcm_xrun(pcm);
+                if (pcm->stats)
+                    pcm_stats_xrun(pcm);
                 return -EPIPE;
             case PCM_STATE_SUSPENDED:
                 return -ESTRPIPE;
@@ -934,18 +1858,20 @@ int pcm_wait(struct pcm *pcm, int timeout)
     /* poll again if fd not ready for IO */
     } while (!(pfd.revents & (POLLIN | POLLOUT)));
 
+    if (pcm->stats)
+        pcm_stats_wakeup(pcm, start, pcm->config.avail_min);
     return 1;
 }
 
 int pcm_mmap_transfer(struct pcm *pcm, const void *buffer, unsigned int bytes)
 {
     int err = 0, frames, avail;
-    unsigned int offset = 0, count;
+    unsigned int offset = 0, count, total;
 
     if (bytes == 0)
         return 0;
 
-    count = pcm_bytes_to_frames(pcm, bytes);
+    count = total = pcm_bytes_to_frames(pcm, bytes);
 
     while (count > 0) {
 
@@ -1008,7 +1934,8 @@ int pcm_mmap_transfer(struct pcm *pcm, const void *buffer, unsigned int bytes)
             break;
 
         /* copy frames from buffer */
-        frames = pcm_mmap_transfer_areas(pcm, (void *)buffer, offset, frames);
+        frames = pcm_mmap_transfer_areas(pcm, (void *)buffer, offset, frames,
+                                         total);
         if (frames < 0) {
             fprintf(stderr, "write error: hw 0x%x app 0x%x avail 0x%x\n",
                     (unsigned int)pcm->mmap_status->hw_ptr,
@@ -1024,6 +1951,75 @@ int pcm_mmap_transfer(struct pcm *pcm, const void *buffer, unsigned int bytes)
     return 0;
 }
 
+static int pcm_gain_init(struct pcm *pcm)
+{
+    unsigned int bits;
+
+    if (pcm->flags & (PCM_IN | PCM_NONINTERLEAVED))
+        return -EINVAL;
+    if (pcm->gain)
+        return 0;
+
+    switch (pcm->config.format) {
+    case PCM_FORMAT_S16_LE:
+        bits = 16;
+        break;
+    case PCM_FORMAT_S24_LE:
+        bits = 24;
+        break;
+    case PCM_FORMAT_S32_LE:
+        bits = 32;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    pcm->gain = gain_init(pcm->config.channels, bits);
+    return pcm->gain ? 0 : -ENOMEM;
+}
+
+int pcm_set_gain(struct pcm *pcm, int db, unsigned int ramp_frames,
+                 enum pcm_ramp ramp)
+{
+    int rc;
+
+    if (db > 0)
+        return -EINVAL;
+    rc = pcm_gain_init(pcm);
+    if (rc < 0)
+        return rc;
+
+    pcm->gain_db = db;
+    pcm->gain_ramp = ramp;
+    if (!pcm->gain_muted)
+        gain_set(pcm->gain, db, ramp_frames, (enum gain_curve)ramp);
+    return 0;
+}
+
+int pcm_get_gain(struct pcm *pcm)
+{
+    return pcm->gain_db;
+}
+
+int pcm_set_mute(struct pcm *pcm, int mute, unsigned int ramp_frames)
+{
+    int rc;
+
+    rc = pcm_gain_init(pcm);
+    if (rc < 0)
+        return rc;
+
+    pcm->gain_muted = mute;
+    gain_set(pcm->gain, mute ? GAIN_MUTE : pcm->gain_db, ramp_frames,
+             (enum gain_curve)pcm->gain_ramp);
+    return 0;
+}
+
+unsigned int pcm_get_ramp_frames(struct pcm *pcm)
+{
+    return pcm->gain ? gain_get_ramp_frames(pcm->gain) : 0;
+}
+
 int pcm_mmap_write(struct pcm *pcm, const void *data, unsigned int count)
 {
     if ((~pcm->flags) & (PCM_OUT | PCM_MMAP))
@@ -1039,3 +2035,107 @@ int pcm_mmap_read(struct pcm *pcm, void *data, unsigned int count)
 
     return pcm_mmap_transfer(pcm, data, count);
 }
+
+int pcm_get_stats(struct pcm *pcm, struct pcm_stats *stats)
+{
+    const struct pcm_histogram *src[4];
+    struct pcm_histogram *dst[4];
+    unsigned int i, k;
+
+    if (!pcm->stats)
+        return -EINVAL;
+
+    for (i = 0; i < PCM_STATS_IOCTL_MAX; i++)
+        stats->ioctls[i] = PCM_STATS_GET(&pcm->stats->ioctls[i]);
+    stats->xruns = PCM_STATS_GET(&pcm->stats->xruns);
+
+    src[0] = &pcm->stats->blocked;
+    src[1] = &pcm->stats->jitter;
+    src[2] = &pcm->stats->avail;
+    src[3] = &pcm->stats->recovery;
+    dst[0] = &stats->blocked;
+    dst[1] = &stats->jitter;
+    dst[2] = &stats->avail;
+    dst[3] = &stats->recovery;
+    for (i = 0; i < 4; i++) {
+        for (k = 0; k < PCM_STATS_BUCKETS; k++)
+            dst[i]->count[k] = PCM_STATS_GET(&src[i]->count[k]);
+        dst[i]->samples = PCM_STATS_GET(&src[i]->samples);
+        dst[i]->max = PCM_STATS_GET(&src[i]->max);
+        dst[i]->sum = PCM_STATS_GET(&src[i]->sum);
+    }
+    return 0;
+}
+
+unsigned int pcm_histogram_percentile(const struct pcm_histogram *hist,
+                                      double percentile)
+{
+    unsigned long long total = 0, want;
+    unsigned int k, top;
+
+    for (k = 0; k < PCM_STATS_BUCKETS; k++)
+        total += hist->count[k];
+    if (!total)
+        return 0;
+
+    want = (unsigned long long)(total * percentile / 100.0 + 0.5);
+    if (!want)
+        want = 1;
+    for (k = 0, total = 0; k < PCM_STATS_BUCKETS - 1; k++) {
+        total += hist->count[k];
+        if (total >= want)
+            break;
+    }
+
+    /* the highest value the bucket holds */
+    if (k < 8)
+        top = k;
+    else
+        top = ((9 + k % 8) << (k / 8 - 1)) - 1;
+    return top < hist->max ? top : hist->max;
+}
+
+int pcm_dump_stats(struct pcm *pcm, int fd)
+{
+    static const char *ioctl_names[PCM_STATS_IOCTL_MAX] = {
+        "transfer", "sync_ptr", "prepare", "start", "drop", "other",
+    };
+    static const char *hist_names[4] = {
+        "blocked us", "jitter us", "avail frames", "recovery us",
+    };
+    struct pcm_stats *stats;
+    const struct pcm_histogram *hist[4];
+    unsigned int i;
+    int rc;
+
+    stats = malloc(sizeof(*stats));
+    if (!stats)
+        return -ENOMEM;
+
+    rc = pcm_get_stats(pcm, stats);
+    if (rc < 0)
+        goto done;
+
+    dprintf(fd, "pcm: %u xruns, ioctls", stats->xruns);
+    for (i = 0; i < PCM_STATS_IOCTL_MAX; i++)
+        dprintf(fd, " %s %u", ioctl_names[i], stats->ioctls[i]);
+    dprintf(fd, "\n");
+
+    hist[0] = &stats->blocked;
+    hist[1] = &stats->jitter;
+    hist[2] = &stats->avail;
+    hist[3] = &stats->recovery;
+    for (i = 0; i < 4; i++) {
+        const struct pcm_histogram *h = hist[i];
+
+        dprintf(fd, "  %-12s n %u mean %llu p50 %u p90 %u p99 %u p99.9 %u max %u\n",
+                hist_names[i], h->samples, h->samples ? h->sum / h->samples : 0,
+                pcm_histogram_percentile(h, 50), pcm_histogram_percentile(h, 90),
+                pcm_histogram_percentile(h, 99), pcm_histogram_percentile(h, 99.9),
+                h->max);
+    }
+
+done:
+    free(stats);
+    return rc;
+}
@@ -0,0 +1,319 @@
+/* planar.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdint.h>
+#include <math.h>
+
+#if !defined(PLANAR_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define PLANAR_SSE2
+#endif
+
+#include "cpu.h"
+#include "planar_impl.h"
+
+unsigned int planar_level_peak(const struct planar_level *level)
+{
+    int max = level->max, min = level->min;
+
+    return -min > max ? -min : max;
+}
+
+double planar_level_rms(const struct planar_level *level)
+{
+    if (!level->frames)
+        return 0.0;
+    return sqrt((double)level->energy / level->frames) / 32768.0;
+}
+
+/* the scalar rounding, which the SIMD paths repeat step for step */
+static inline int16_t planar_clip_s16(float x, float scale)
+{
+    float v = x * scale;
+
+    v = v < 0 ? v - 0.5f : v + 0.5f;
+    if (v > 32767.0f)
+        v = 32767.0f;
+    else if (v < -32768.0f)
+        v = -32768.0f;
+    return (int16_t)v;
+}
+
+#if defined(PLANAR_SSE2)
+static unsigned int planar_s16_to_float_sse2(float *const *dst, const int16_t *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    __m128 vs = _mm_set1_ps(scale);
+    unsigned int i = 0;
+
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+            _mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vs));
+            _mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vs));
+        }
+    } else if (channels == 2) {
+        for (; i + 8 <= frames; i += 8) {
+            /* each 32 bit lane is one frame: left low, right high */
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 8));
+
+            _mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(
+                          _mm_srai_epi32(_mm_slli_epi32(a, 16), 16)), vs));
+            _mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(
+                          _mm_srai_epi32(_mm_slli_epi32(b, 16), 16)), vs));
+            _mm_storeu_ps(dst[1] + i, _mm_mul_ps(_mm_cvtepi32_ps(
+                          _mm_srai_epi32(a, 16)), vs));
+            _mm_storeu_ps(dst[1] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(
+                          _mm_srai_epi32(b, 16)), vs));
+        }
+    }
+    return i;
+}
+
+static unsigned int planar_s32_to_float_sse2(float *const *dst, const int32_t *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    __m128 vs = _mm_set1_ps(scale);
+    unsigned int i = 0;
+
+    if (channels == 1) {
+        for (; i + 4 <= frames; i += 4)
+            _mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(
+                          _mm_loadu_si128((const __m128i *)(src + i))), vs));
+    } else if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+            __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i + 4)));
+
+            _mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), vs));
+            _mm_storeu_ps(dst[1] + i, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), vs));
+        }
+    }
+    return i;
+}
+
+static inline void planar_level_sse2(struct planar_level *level, __m128i max,
+                                     __m128i min, __m128i energy)
+{
+    int16_t m[8], n[8];
+    uint64_t e[2];
+    unsigned int k;
+
+    _mm_storeu_si128((__m128i *)m, max);
+    _mm_storeu_si128((__m128i *)n, min);
+    _mm_storeu_si128((__m128i *)e, energy);
+    for (k = 0; k < 8; k++) {
+        if (m[k] > level->max)
+            level->max = m[k];
+        if (n[k] < level->min)
+            level->min = n[k];
+    }
+    level->energy += e[0] + e[1];
+}
+
+/* pmaddwd sums two squares, which only fits 32 bits unsigned */
+static inline __m128i planar_energy_sse2(__m128i acc, __m128i x)
+{
+    __m128i sq = _mm_madd_epi16(x, x), zero = _mm_setzero_si128();
+
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+    return _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+}
+
+static unsigned int planar_s16_split_sse2(int16_t *const *dst, const int16_t *src,
+                                          unsigned int channels, unsigned int frames,
+                                          struct planar_level *levels)
+{
+    __m128i max[2], min[2], energy[2], x[2];
+    unsigned int i = 0, c;
+
+    if (channels > 2 || frames < 8)
+        return 0;
+
+    for (c = 0; c < channels; c++) {
+        max[c] = _mm_set1_epi16(INT16_MIN);
+        min[c] = _mm_set1_epi16(INT16_MAX);
+        energy[c] = _mm_setzero_si128();
+    }
+    for (; i + 8 <= frames; i += 8) {
+        if (channels == 1) {
+            x[0] = _mm_loadu_si128((const __m128i *)(src + i));
+        } else {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 8));
+
+            x[0] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                   _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+            x[1] = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        }
+        for (c = 0; c < channels; c++) {
+            if (dst)
+                _mm_storeu_si128((__m128i *)(dst[c] + i), x[c]);
+            max[c] = _mm_max_epi16(max[c], x[c]);
+            min[c] = _mm_min_epi16(min[c], x[c]);
+            energy[c] = planar_energy_sse2(energy[c], x[c]);
+        }
+    }
+    for (c = 0; c < channels; c++)
+        planar_level_sse2(&levels[c], max[c], min[c], energy[c]);
+    return i;
+}
+
+static unsigned int planar_float_to_s16_sse2(int16_t *dst, const float *const *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    __m128 vs = _mm_set1_ps(scale);
+    __m128 top = _mm_set1_ps(32767.0f), bottom = _mm_set1_ps(-32768.0f);
+    __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x80000000)), half = _mm_set1_ps(0.5f);
+    unsigned int i = 0, c;
+
+    if (channels > 2)
+        return 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        __m128i out[2];
+
+        for (c = 0; c < channels; c++) {
+            __m128i q[2];
+            unsigned int k;
+
+            for (k = 0; k < 2; k++) {
+                __m128 v = _mm_mul_ps(_mm_loadu_ps(src[c] + i + 4 * k), vs);
+
+                v = _mm_add_ps(v, _mm_or_ps(_mm_and_ps(v, sign), half));
+                v = _mm_max_ps(_mm_min_ps(v, top), bottom);
+                q[k] = _mm_cvttps_epi32(v);
+            }
+            out[c] = _mm_packs_epi32(q[0], q[1]);
+        }
+        if (channels == 1) {
+            _mm_storeu_si128((__m128i *)(dst + i), out[0]);
+        } else {
+            _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi16(out[0], out[1]));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i + 8), _mm_unpackhi_epi16(out[0], out[1]));
+        }
+    }
+    return i;
+}
+
+static const struct planar_kernels planar_sse2_kernels = {
+    "sse2",
+    planar_s16_to_float_sse2,
+    planar_s32_to_float_sse2,
+    planar_s16_split_sse2,
+    planar_float_to_s16_sse2,
+};
+#endif
+
+static const struct planar_kernels planar_no_kernels = { "scalar", NULL, NULL, NULL, NULL };
+static const struct planar_kernels *planar_simd = &planar_no_kernels;
+
+/* picked once at load, before anything can call in */
+static void __attribute__((constructor)) planar_select(void)
+{
+#if defined(PLANAR_SSE2)
+    planar_simd = &planar_sse2_kernels;
+#elif !defined(PLANAR_NO_SIMD)
+    if (cpu_has_neon())
+        planar_simd = &planar_neon_kernels;
+#endif
+}
+
+const char *planar_kernel_name(void)
+{
+    return planar_simd->name;
+}
+
+void planar_s16_to_float(float *const *dst, const int16_t *src,
+                         unsigned int channels, unsigned int frames, float scale)
+{
+    unsigned int i = 0, c;
+
+    if (planar_simd->s16_to_float)
+        i = planar_simd->s16_to_float(dst, src, channels, frames, scale);
+    for (; i < frames; i++)
+        for (c = 0; c < channels; c++)
+            dst[c][i] = src[i * channels + c] * scale;
+}
+
+void planar_s32_to_float(float *const *dst, const int32_t *src,
+                         unsigned int channels, unsigned int frames, float scale)
+{
+    unsigned int i = 0, c;
+
+    if (planar_simd->s32_to_float)
+        i = planar_simd->s32_to_float(dst, src, channels, frames, scale);
+    for (; i < frames; i++)
+        for (c = 0; c < channels; c++)
+            dst[c][i] = (float)src[i * channels + c] * scale;
+}
+
+void planar_s16_split(int16_t *const *dst, const int16_t *src,
+                      unsigned int channels, unsigned int frames,
+                      struct planar_level *levels)
+{
+    unsigned int i = 0, c;
+
+    if (planar_simd->s16_split)
+        i = planar_simd->s16_split(dst, src, channels, frames, levels);
+    for (c = 0; c < channels; c++) {
+        struct planar_level *level = &levels[c];
+        const int16_t *s = src + i * channels + c;
+        unsigned int n;
+
+        for (n = i; n < frames; n++, s += channels) {
+            if (dst)
+                dst[c][n] = *s;
+            if (*s > level->max)
+                level->max = *s;
+            if (*s < level->min)
+                level->min = *s;
+            level->energy += (uint32_t)(*s * *s);
+        }
+        level->frames += frames;
+    }
+}
+
+void planar_float_to_s16(int16_t *dst, const float *const *src,
+                         unsigned int channels, unsigned int frames, float scale)
+{
+    unsigned int i = 0, c;
+
+    if (planar_simd->float_to_s16)
+        i = planar_simd->float_to_s16(dst, src, channels, frames, scale);
+    for (; i < frames; i++)
+        for (c = 0; c < channels; c++)
+            dst[i * channels + c] = planar_clip_s16(src[c][i], scale);
+}
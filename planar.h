@@ -0,0 +1,86 @@
+/* planar.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Fused kernels between interleaved pcm frames and one buffer per channel.
+ *
+ * Each call reads and writes every sample once: deinterleave and convert to
+ * float, deinterleave and measure levels, or convert, clip and interleave
+ * on the way back. Mono and stereo use SSE2 when the compiler targets it,
+ * or NEON from planar_neon.c when the cpu has it, checked once at load
+ * (define PLANAR_NO_SIMD to stop both); other channel counts are scalar.
+ * Results are the same with and without SIMD.
+ */
+
+/* Levels of one channel, accumulated over calls; zero it to start */
+struct planar_level {
+    int16_t max;
+    int16_t min;
+    uint64_t energy;        /* sum of squares */
+    uint64_t frames;
+};
+
+/* 0 to 32768 */
+unsigned int planar_level_peak(const struct planar_level *level);
+/* 0 to 1 of full scale */
+double planar_level_rms(const struct planar_level *level);
+
+/* "neon", "sse2" or "scalar": the kernels this process runs */
+const char *planar_kernel_name(void);
+
+/* dst[c][i] = src[i * channels + c] * scale */
+void planar_s16_to_float(float *const *dst, const int16_t *src,
+                         unsigned int channels, unsigned int frames, float scale);
+void planar_s32_to_float(float *const *dst, const int32_t *src,
+                         unsigned int channels, unsigned int frames, float scale);
+
+/* Deinterleave into dst, which may be NULL to only measure, and add each
+ * channel's samples to levels[channel] */
+void planar_s16_split(int16_t *const *dst, const int16_t *src,
+                      unsigned int channels, unsigned int frames,
+                      struct planar_level *levels);
+
+/* dst[i * channels + c] = src[c][i] * scale, rounded half away from zero
+ * and clipped */
+void planar_float_to_s16(int16_t *dst, const float *const *src,
+                         unsigned int channels, unsigned int frames, float scale);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
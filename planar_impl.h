@@ -0,0 +1,55 @@
+/* planar_impl.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef PLANAR_IMPL_H
+#define PLANAR_IMPL_H
+
+#include "planar.h"
+
+/*
+ * SIMD kernels behind the planar_* calls. Each does the mono or stereo
+ * frames it can in whole vectors and returns how many, leaving the rest to
+ * the scalar loop; a NULL entry does none.
+ */
+struct planar_kernels {
+    const char *name;
+    unsigned int (*s16_to_float)(float *const *dst, const int16_t *src,
+                                 unsigned int channels, unsigned int frames, float scale);
+    unsigned int (*s32_to_float)(float *const *dst, const int32_t *src,
+                                 unsigned int channels, unsigned int frames, float scale);
+    unsigned int (*s16_split)(int16_t *const *dst, const int16_t *src,
+                              unsigned int channels, unsigned int frames,
+                              struct planar_level *levels);
+    unsigned int (*float_to_s16)(int16_t *dst, const float *const *src,
+                                 unsigned int channels, unsigned int frames, float scale);
+};
+
+/* planar_neon.c, all NULL unless it was built with NEON enabled */
+extern const struct planar_kernels planar_neon_kernels;
+
+#endif
@@ -0,0 +1,195 @@
+/* planar_neon.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdint.h>
+
+#include "planar_impl.h"
+
+/*
+ * NEON kernels for planar.c, built with -mfpu=neon and called only when
+ * the cpu has NEON (see cpu.h). Without NEON to build for, the table is
+ * empty and planar.c stays scalar.
+ */
+
+#if !defined(PLANAR_NO_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+
+static unsigned int planar_s16_to_float_neon(float *const *dst, const int16_t *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    float32x4_t vs = vdupq_n_f32(scale);
+    unsigned int i = 0, c;
+
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            int16x8_t x = vld1q_s16(src + i);
+            vst1q_f32(dst[0] + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), vs));
+            vst1q_f32(dst[0] + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), vs));
+        }
+    } else if (channels == 2) {
+        for (; i + 8 <= frames; i += 8) {
+            int16x8x2_t x = vld2q_s16(src + 2 * i);
+            for (c = 0; c < 2; c++) {
+                vst1q_f32(dst[c] + i,
+                          vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x.val[c]))), vs));
+                vst1q_f32(dst[c] + i + 4,
+                          vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x.val[c]))), vs));
+            }
+        }
+    }
+    return i;
+}
+
+static unsigned int planar_s32_to_float_neon(float *const *dst, const int32_t *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    float32x4_t vs = vdupq_n_f32(scale);
+    unsigned int i = 0;
+
+    if (channels == 1) {
+        for (; i + 4 <= frames; i += 4)
+            vst1q_f32(dst[0] + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src + i)), vs));
+    } else if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            int32x4x2_t x = vld2q_s32(src + 2 * i);
+            vst1q_f32(dst[0] + i, vmulq_f32(vcvtq_f32_s32(x.val[0]), vs));
+            vst1q_f32(dst[1] + i, vmulq_f32(vcvtq_f32_s32(x.val[1]), vs));
+        }
+    }
+    return i;
+}
+
+static inline void planar_level_neon(struct planar_level *level, int16x8_t max,
+                                     int16x8_t min, uint64x2_t energy)
+{
+    int16x4_t m = vmax_s16(vget_low_s16(max), vget_high_s16(max));
+    int16x4_t n = vmin_s16(vget_low_s16(min), vget_high_s16(min));
+
+    m = vpmax_s16(m, m);
+    m = vpmax_s16(m, m);
+    n = vpmin_s16(n, n);
+    n = vpmin_s16(n, n);
+    if (vget_lane_s16(m, 0) > level->max)
+        level->max = vget_lane_s16(m, 0);
+    if (vget_lane_s16(n, 0) < level->min)
+        level->min = vget_lane_s16(n, 0);
+    level->energy += vgetq_lane_u64(energy, 0) + vgetq_lane_u64(energy, 1);
+}
+
+/* squares of a full scale sample fit 31 bits, so pairs of them sum unsigned */
+static inline uint64x2_t planar_energy_neon(uint64x2_t acc, int16x8_t x)
+{
+    acc = vpadalq_u32(acc, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(x), vget_low_s16(x))));
+    return vpadalq_u32(acc, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(x), vget_high_s16(x))));
+}
+
+static unsigned int planar_s16_split_neon(int16_t *const *dst, const int16_t *src,
+                                          unsigned int channels, unsigned int frames,
+                                          struct planar_level *levels)
+{
+    int16x8_t max[2], min[2];
+    uint64x2_t energy[2];
+    unsigned int i = 0, c;
+
+    if (channels > 2 || frames < 8)
+        return 0;
+
+    for (c = 0; c < channels; c++) {
+        max[c] = vdupq_n_s16(INT16_MIN);
+        min[c] = vdupq_n_s16(INT16_MAX);
+        energy[c] = vdupq_n_u64(0);
+    }
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t x;
+
+        if (channels == 1)
+            x.val[0] = vld1q_s16(src + i);
+        else
+            x = vld2q_s16(src + 2 * i);
+        for (c = 0; c < channels; c++) {
+            if (dst)
+                vst1q_s16(dst[c] + i, x.val[c]);
+            max[c] = vmaxq_s16(max[c], x.val[c]);
+            min[c] = vminq_s16(min[c], x.val[c]);
+            energy[c] = planar_energy_neon(energy[c], x.val[c]);
+        }
+    }
+    for (c = 0; c < channels; c++)
+        planar_level_neon(&levels[c], max[c], min[c], energy[c]);
+    return i;
+}
+
+static unsigned int planar_float_to_s16_neon(int16_t *dst, const float *const *src,
+                                             unsigned int channels, unsigned int frames,
+                                             float scale)
+{
+    float32x4_t vs = vdupq_n_f32(scale);
+    float32x4_t top = vdupq_n_f32(32767.0f), bottom = vdupq_n_f32(-32768.0f);
+    uint32x4_t sign = vdupq_n_u32(0x80000000), half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    unsigned int i = 0, c;
+
+    if (channels > 2)
+        return 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t out;
+
+        for (c = 0; c < channels; c++) {
+            int32x4_t q[2];
+            unsigned int k;
+
+            for (k = 0; k < 2; k++) {
+                float32x4_t v = vmulq_f32(vld1q_f32(src[c] + i + 4 * k), vs);
+                uint32x4_t h = vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v), sign), half);
+
+                v = vaddq_f32(v, vreinterpretq_f32_u32(h));
+                v = vmaxq_f32(vminq_f32(v, top), bottom);
+                q[k] = vcvtq_s32_f32(v);
+            }
+            out.val[c] = vcombine_s16(vmovn_s32(q[0]), vmovn_s32(q[1]));
+        }
+        if (channels == 1)
+            vst1q_s16(dst + i, out.val[0]);
+        else
+            vst2q_s16(dst + 2 * i, out);
+    }
+    return i;
+}
+
+const struct planar_kernels planar_neon_kernels = {
+    "neon",
+    planar_s16_to_float_neon,
+    planar_s32_to_float_neon,
+    planar_s16_split_neon,
+    planar_float_to_s16_neon,
+};
+#else
+const struct planar_kernels planar_neon_kernels;
+#endif
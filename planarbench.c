@@ -0,0 +1,327 @@
+/* planarbench.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "planar.h"
+
+#define MAX_CHANNELS        8
+
+/*
+ * Times the planar.c kernels against the chained scalar loops they
+ * replace: one pass to deinterleave, then one per conversion or
+ * measurement. Both have to give the same result before a time is shown.
+ */
+
+struct bench {
+    unsigned int channels;
+    unsigned int frames;
+    int16_t *s16;                       /* interleaved input */
+    int32_t *s32;
+    int16_t *out;                       /* interleaved output */
+    int16_t *split[MAX_CHANNELS];       /* planes written by the kernels */
+    float *fplane[MAX_CHANNELS];
+    int16_t *tmp16[MAX_CHANNELS];       /* scratch of the chained loops */
+    int32_t *tmp32[MAX_CHANNELS];
+    struct planar_level levels[MAX_CHANNELS];
+};
+
+static void deinterleave_s16(struct bench *b)
+{
+    unsigned int i, c;
+
+    for (i = 0; i < b->frames; i++)
+        for (c = 0; c < b->channels; c++)
+            b->tmp16[c][i] = b->s16[i * b->channels + c];
+}
+
+static void chained_s16_to_float(struct bench *b)
+{
+    unsigned int i, c;
+
+    deinterleave_s16(b);
+    for (c = 0; c < b->channels; c++)
+        for (i = 0; i < b->frames; i++)
+            b->fplane[c][i] = b->tmp16[c][i] * (1.0f / 32768.0f);
+}
+
+static void fused_s16_to_float(struct bench *b)
+{
+    planar_s16_to_float(b->fplane, b->s16, b->channels, b->frames, 1.0f / 32768.0f);
+}
+
+static void chained_s32_to_float(struct bench *b)
+{
+    unsigned int i, c;
+
+    for (i = 0; i < b->frames; i++)
+        for (c = 0; c < b->channels; c++)
+            b->tmp32[c][i] = b->s32[i * b->channels + c];
+    for (c = 0; c < b->channels; c++)
+        for (i = 0; i < b->frames; i++)
+            b->fplane[c][i] = (float)b->tmp32[c][i] * (1.0f / 2147483648.0f);
+}
+
+static void fused_s32_to_float(struct bench *b)
+{
+    planar_s32_to_float(b->fplane, b->s32, b->channels, b->frames, 1.0f / 2147483648.0f);
+}
+
+static void chained_split(struct bench *b)
+{
+    unsigned int i, c;
+
+    deinterleave_s16(b);
+    for (c = 0; c < b->channels; c++) {
+        struct planar_level *level = &b->levels[c];
+
+        memcpy(b->split[c], b->tmp16[c], b->frames * sizeof(int16_t));
+        for (i = 0; i < b->frames; i++) {
+            if (b->split[c][i] > level->max)
+                level->max = b->split[c][i];
+            if (b->split[c][i] < level->min)
+                level->min = b->split[c][i];
+        }
+        for (i = 0; i < b->frames; i++)
+            level->energy += (uint32_t)(b->split[c][i] * b->split[c][i]);
+        level->frames += b->frames;
+    }
+}
+
+static void fused_split(struct bench *b)
+{
+    planar_s16_split(b->split, b->s16, b->channels, b->frames, b->levels);
+}
+
+static void chained_float_to_s16(struct bench *b)
+{
+    unsigned int i, c;
+
+    for (c = 0; c < b->channels; c++) {
+        for (i = 0; i < b->frames; i++) {
+            float v = b->fplane[c][i] * 32768.0f;
+
+            v = v < 0 ? v - 0.5f : v + 0.5f;
+            if (v > 32767.0f)
+                v = 32767.0f;
+            else if (v < -32768.0f)
+                v = -32768.0f;
+            b->tmp16[c][i] = (int16_t)v;
+        }
+    }
+    for (i = 0; i < b->frames; i++)
+        for (c = 0; c < b->channels; c++)
+            b->out[i * b->channels + c] = b->tmp16[c][i];
+}
+
+static void fused_float_to_s16(struct bench *b)
+{
+    planar_float_to_s16(b->out, (const float *const *)b->fplane, b->channels,
+                        b->frames, 32768.0f);
+}
+
+struct bench_case {
+    const char *name;
+    void (*chained)(struct bench *b);
+    void (*fused)(struct bench *b);
+};
+
+static const struct bench_case cases[] = {
+    { "s16_to_float", chained_s16_to_float, fused_s16_to_float },
+    { "s32_to_float", chained_s32_to_float, fused_s32_to_float },
+    { "s16_split", chained_split, fused_split },
+    { "float_to_s16", chained_float_to_s16, fused_float_to_s16 },
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* float and split planes, levels and the interleaved output */
+static size_t snapshot_size(struct bench *b)
+{
+    return b->channels * (b->frames * (sizeof(float) + 2 * sizeof(int16_t)) +
+                          sizeof(struct planar_level));
+}
+
+/* copy of everything a case writes, to compare the two ways */
+static void *snapshot(struct bench *b)
+{
+    size_t plane = b->frames * sizeof(float);
+    char *p = malloc(snapshot_size(b)), *q = p;
+    unsigned int c;
+
+    if (!p)
+        return NULL;
+    for (c = 0; c < b->channels; c++) {
+        memcpy(q, b->fplane[c], plane);
+        q += plane;
+        memcpy(q, b->split[c], b->frames * sizeof(int16_t));
+        q += b->frames * sizeof(int16_t);
+        memcpy(q, &b->levels[c], sizeof(struct planar_level));
+        q += sizeof(struct planar_level);
+    }
+    memcpy(q, b->out, b->frames * b->channels * sizeof(int16_t));
+    return p;
+}
+
+static int same_result(struct bench *b, const struct bench_case *bc)
+{
+    void *chained, *fused;
+    int same;
+
+    memset(b->levels, 0, sizeof(b->levels));
+    bc->chained(b);
+    chained = snapshot(b);
+    memset(b->levels, 0, sizeof(b->levels));
+    bc->fused(b);
+    fused = snapshot(b);
+    same = chained && fused && !memcmp(chained, fused, snapshot_size(b));
+    free(chained);
+    free(fused);
+    return same;
+}
+
+static double time_ns(struct bench *b, void (*run)(struct bench *b), unsigned int iterations)
+{
+    uint64_t start;
+    unsigned int n;
+
+    memset(b->levels, 0, sizeof(b->levels));
+    start = now_ns();
+    for (n = 0; n < iterations; n++)
+        run(b);
+    return (double)(now_ns() - start) / iterations / b->frames;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    unsigned int iterations = 20000;
+    unsigned int i, c;
+    int ret = 0;
+
+    memset(&b, 0, sizeof(b));
+    b.channels = 2;
+    b.frames = 1024;
+
+    /* parse command line arguments */
+    argv += 1;
+    while (*argv) {
+        if (strcmp(*argv, "-c") == 0) {
+            argv++;
+            if (*argv)
+                b.channels = atoi(*argv);
+        } else if (strcmp(*argv, "-p") == 0) {
+            argv++;
+            if (*argv)
+                b.frames = atoi(*argv);
+        } else if (strcmp(*argv, "-n") == 0) {
+            argv++;
+            if (*argv)
+                iterations = atoi(*argv);
+        } else {
+            fprintf(stderr, "Usage: planarbench [-c channels] [-p period_size] "
+                    "[-n iterations]\n");
+            return 1;
+        }
+        if (*argv)
+            argv++;
+    }
+
+    if (!b.channels || b.channels > MAX_CHANNELS || !b.frames || !iterations) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    b.s16 = malloc(b.frames * b.channels * sizeof(int16_t));
+    b.s32 = malloc(b.frames * b.channels * sizeof(int32_t));
+    b.out = malloc(b.frames * b.channels * sizeof(int16_t));
+    if (!b.s16 || !b.s32 || !b.out)
+        goto nomem;
+    for (c = 0; c < b.channels; c++) {
+        b.split[c] = calloc(b.frames, sizeof(int16_t));
+        b.fplane[c] = calloc(b.frames, sizeof(float));
+        b.tmp16[c] = calloc(b.frames, sizeof(int16_t));
+        b.tmp32[c] = calloc(b.frames, sizeof(int32_t));
+        if (!b.split[c] || !b.fplane[c] || !b.tmp16[c] || !b.tmp32[c])
+            goto nomem;
+    }
+
+    srand(1);
+    for (i = 0; i < b.frames * b.channels; i++) {
+        b.s16[i] = (int16_t)rand();
+        b.s32[i] = (int32_t)((unsigned int)rand() << 1);
+    }
+
+    printf("%s kernels, %u channels, %u frames per call, %u calls\n",
+           planar_kernel_name(), b.channels, b.frames, iterations);
+    printf("%-14s %12s %12s %8s\n", "kernel", "chained", "fused", "speedup");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double chained, fused;
+
+        /* float_to_s16 reads what s16_to_float wrote, with some clipping */
+        if (cases[i].fused == fused_float_to_s16)
+            for (c = 0; c < b.channels; c++)
+                b.fplane[c][0] = 1.5f;
+        if (!same_result(&b, &cases[i])) {
+            fprintf(stderr, "%s: fused and chained results differ\n", cases[i].name);
+            ret = 1;
+            continue;
+        }
+        chained = time_ns(&b, cases[i].chained, iterations);
+        fused = time_ns(&b, cases[i].fused, iterations);
+        printf("%-14s %9.3f ns %9.3f ns %7.2fx\n", cases[i].name, chained, fused,
+               chained / fused);
+    }
+    printf("(ns per frame)\n");
+    goto done;
+
+nomem:
+    fprintf(stderr, "Unable to allocate buffers\n");
+    ret = 1;
+done:
+    for (c = 0; c < b.channels; c++) {
+        free(b.split[c]);
+        free(b.fplane[c]);
+        free(b.tmp16[c]);
+        free(b.tmp32[c]);
+    }
+    free(b.out);
+    free(b.s32);
+    free(b.s16);
+    return ret;
+}
@@ -0,0 +1,283 @@
+/* preproc.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+
+#include "preproc.h"
+#include "planar.h"
+#include "fft.h"
+
+#define NS_FRAME_MS     16      /* STFT frame, hop is half of it */
+#define NS_SMOOTH       0.8f    /* power smoothing for the noise tracker */
+#define NS_NOISE_RISE   1.002f  /* noise floor creep per frame, ~1 dB/s at 8 ms hops */
+#define NS_NOISE_BIAS   2.0f    /* the minimum of a smoothed periodogram sits below its mean */
+#define NS_DD_ALPHA     0.98f   /* decision directed a priori SNR weight */
+#define NS_GAIN_FLOOR   0.1f    /* -20 dB, keeps some ambience, no musical noise */
+#define NS_MIN_NOISE    1.0f    /* lowest noise power per sample, 1 LSB rms of int16 */
+
+#define PREPROC_BLOCK   256     /* frames deinterleaved at a time */
+
+struct biquad {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+};
+
+struct denoise {
+    struct stft *stft;
+    float *in;          /* hop of input being collected */
+    float *out;         /* hop of finished output being played out */
+    float *smooth;      /* smoothed power per bin */
+    float *noise;       /* noise power per bin */
+    float *prev;        /* previous clean power per bin */
+    unsigned int pos;
+    unsigned int frames;
+};
+
+struct preproc_channel {
+    unsigned int mode;
+    struct biquad hp;
+    struct denoise ns;
+};
+
+struct preproc {
+    unsigned int channels;
+    unsigned int frame;     /* STFT frame length */
+    unsigned int hop;
+    float *spec;            /* scratch */
+    float **plane;          /* PREPROC_BLOCK frames per channel */
+    struct preproc_channel *ch;
+};
+
+static void biquad_highpass(struct biquad *bq, unsigned int rate, float hz)
+{
+    /* bilinear transform of a second order Butterworth, Q = 1 / sqrt(2) */
+    float w = tanf(M_PI * hz / rate);
+    float n = 1 / (1 + M_SQRT2 * w + w * w);
+
+    bq->b0 = n;
+    bq->b1 = -2 * n;
+    bq->b2 = n;
+    bq->a1 = 2 * (w * w - 1) * n;
+    bq->a2 = (1 - M_SQRT2 * w + w * w) * n;
+    bq->z1 = bq->z2 = 0;
+}
+
+static inline float biquad_run(struct biquad *bq, float x)
+{
+    /* transposed direct form II */
+    float y = bq->b0 * x + bq->z1;
+
+    bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+    bq->z2 = bq->b2 * x - bq->a2 * y;
+    return y;
+}
+
+static int denoise_init(struct denoise *ns, unsigned int frame, unsigned int hop)
+{
+    unsigned int bins = frame / 2 + 1;
+
+    ns->stft = stft_init(frame, hop);
+    ns->in = calloc(hop, sizeof(float));
+    ns->out = calloc(hop, sizeof(float));
+    ns->smooth = calloc(bins, sizeof(float));
+    ns->noise = calloc(bins, sizeof(float));
+    ns->prev = calloc(bins, sizeof(float));
+    if (!ns->stft || !ns->in || !ns->out || !ns->smooth || !ns->noise || !ns->prev)
+        return -ENOMEM;
+    return 0;
+}
+
+static void denoise_free(struct denoise *ns)
+{
+    stft_free(ns->stft);
+    free(ns->in);
+    free(ns->out);
+    free(ns->smooth);
+    free(ns->noise);
+    free(ns->prev);
+}
+
+struct preproc *preproc_init(unsigned int channels, unsigned int rate)
+{
+    struct preproc *pp;
+    unsigned int i;
+
+    pp = calloc(1, sizeof(*pp));
+    if (!pp)
+        return NULL;
+
+    /* power of two frame closest to NS_FRAME_MS */
+    for (pp->frame = 64; pp->frame * 1000 / rate < NS_FRAME_MS &&
+         pp->frame < FFT_MAX_SIZE; pp->frame <<= 1)
+        ;
+    pp->hop = pp->frame / 2;
+    pp->channels = channels;
+
+    pp->spec = calloc(pp->frame + 2, sizeof(float));
+    pp->ch = calloc(channels, sizeof(*pp->ch));
+    pp->plane = calloc(channels, sizeof(*pp->plane));
+    if (!pp->spec || !pp->ch || !pp->plane)
+        goto fail;
+
+    for (i = 0; i < channels; i++) {
+        pp->plane[i] = malloc(PREPROC_BLOCK * sizeof(float));
+        if (!pp->plane[i])
+            goto fail;
+        biquad_highpass(&pp->ch[i].hp, rate, PREPROC_HIGHPASS_HZ);
+        if (denoise_init(&pp->ch[i].ns, pp->frame, pp->hop) < 0)
+            goto fail;
+    }
+
+    return pp;
+
+fail:
+    preproc_free(pp);
+    return NULL;
+}
+
+void preproc_free(struct preproc *pp)
+{
+    unsigned int i;
+
+    if (!pp)
+        return;
+
+    if (pp->ch)
+        for (i = 0; i < pp->channels; i++)
+            denoise_free(&pp->ch[i].ns);
+    if (pp->plane)
+        for (i = 0; i < pp->channels; i++)
+            free(pp->plane[i]);
+    free(pp->plane);
+    free(pp->spec);
+    free(pp->ch);
+    free(pp);
+}
+
+int preproc_set_mode(struct preproc *pp, unsigned int channel, unsigned int mode)
+{
+    if (!pp || channel >= pp->channels)
+        return -EINVAL;
+
+    pp->ch[channel].mode = mode;
+    return 0;
+}
+
+/* One STFT frame: analyse the collected hop, apply the Wiener gain, resynthesise */
+static void denoise_frame(struct preproc *pp, struct denoise *ns)
+{
+    unsigned int bins = pp->frame / 2 + 1;
+    /* NS_MIN_NOISE as it comes out of the sqrt Hann windowed FFT */
+    float min_noise = NS_MIN_NOISE * pp->frame / 2;
+    float *spec = pp->spec;
+    float energy = 0;
+    unsigned int k;
+
+    stft_analyze(ns->stft, ns->in, spec);
+
+    for (k = 0; k < bins; k++)
+        energy += spec[2 * k] * spec[2 * k] + spec[2 * k + 1] * spec[2 * k + 1];
+
+    for (k = 0; k < bins; k++) {
+        float power = spec[2 * k] * spec[2 * k] + spec[2 * k + 1] * spec[2 * k + 1];
+        float noise, post, prio, gain;
+
+        /* minimum tracking: follow the smoothed power down at once, creep
+         * up slowly so speech does not leak into the estimate */
+        if (!ns->frames)
+            ns->smooth[k] = power;
+        ns->smooth[k] = NS_SMOOTH * ns->smooth[k] + (1 - NS_SMOOTH) * power;
+        if (!ns->frames || ns->smooth[k] < ns->noise[k])
+            ns->noise[k] = ns->smooth[k];
+        else
+            ns->noise[k] *= NS_NOISE_RISE;
+        if (ns->noise[k] < min_noise)
+            ns->noise[k] = min_noise;
+
+        noise = NS_NOISE_BIAS * ns->noise[k];
+        post = power / noise;
+        prio = NS_DD_ALPHA * ns->prev[k] / noise +
+            (1 - NS_DD_ALPHA) * (post > 1 ? post - 1 : 0);
+        gain = prio / (1 + prio);
+        if (gain < NS_GAIN_FLOOR)
+            gain = NS_GAIN_FLOOR;
+
+        ns->prev[k] = gain * gain * power;
+        spec[2 * k] *= gain;
+        spec[2 * k + 1] *= gain;
+    }
+    /* digital silence, as right after the PCM starts, would start the
+     * floor so low that the creep takes minutes to reach the real noise:
+     * keep starting over until a frame has some signal in it */
+    if (energy >= bins * min_noise)
+        ns->frames++;
+
+    stft_synthesize(ns->stft, spec, ns->out);
+}
+
+static inline float denoise_run(struct preproc *pp, struct denoise *ns, float x)
+{
+    float y = ns->out[ns->pos];
+
+    ns->in[ns->pos] = x;
+    if (++ns->pos == pp->hop) {
+        denoise_frame(pp, ns);
+        ns->pos = 0;
+    }
+    return y;
+}
+
+void preproc_process(struct preproc *pp, int16_t *data, unsigned int frames)
+{
+    unsigned int c, i, n;
+
+    /* out to one block per channel and back, touching the interleaved data
+     * once each way */
+    for (; frames; frames -= n, data += n * pp->channels) {
+        n = frames < PREPROC_BLOCK ? frames : PREPROC_BLOCK;
+        planar_s16_to_float(pp->plane, data, pp->channels, n, 1.0f);
+
+        for (c = 0; c < pp->channels; c++) {
+            struct preproc_channel *ch = &pp->ch[c];
+            float *x = pp->plane[c];
+
+            if (ch->mode & PREPROC_HIGHPASS)
+                for (i = 0; i < n; i++)
+                    x[i] = biquad_run(&ch->hp, x[i]);
+            if (ch->mode & PREPROC_DENOISE)
+                for (i = 0; i < n; i++)
+                    x[i] = denoise_run(pp, &ch->ns, x[i]);
+        }
+
+        planar_float_to_s16(data, (const float *const *)pp->plane, pp->channels,
+                            n, 1.0f);
+    }
+}
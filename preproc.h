@@ -0,0 +1,66 @@
+/* preproc.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef PREPROC_H
+#define PREPROC_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Capture pre-processing ahead of voice detection.
+ *
+ * PREPROC_HIGHPASS removes DC and rumble below PREPROC_HIGHPASS_HZ with a
+ * second order Butterworth biquad. PREPROC_DENOISE is a decision directed
+ * Wiener noise suppressor on a 50% overlap-add STFT; it delays the channel by
+ * one STFT frame. Each channel of the interleaved S16 stream selects its own
+ * stages; all state is allocated up front.
+ */
+
+#define PREPROC_HIGHPASS    0x1
+#define PREPROC_DENOISE     0x2
+
+#define PREPROC_HIGHPASS_HZ 100
+
+struct preproc;
+
+struct preproc *preproc_init(unsigned int channels, unsigned int rate);
+void preproc_free(struct preproc *pp);
+int preproc_set_mode(struct preproc *pp, unsigned int channel, unsigned int mode);
+
+/* process frames of interleaved S16 in place */
+void preproc_process(struct preproc *pp, int16_t *data, unsigned int frames);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+# Generates fft_tables.h: a quarter wave sine table in Q31 from which fft.c
+# derives every twiddle factor (float, Q15 and Q31) for sizes up to
+# FFT_MAX_SIZE without calling sin()/cos() at run time.
+#
+#   python scripts/gen_fft_tables.py 4096 > fft_tables.h
+
+import math
+import sys
+
+size = int(sys.argv[1]) if len(sys.argv) > 1 else 4096
+entries = size // 4 + 1
+
+print("/* fft_tables.h")
+print("**")
+print("** Generated by scripts/gen_fft_tables.py %d, do not edit." % size)
+print("*/")
+print("")
+print("#ifndef FFT_TABLES_H")
+print("#define FFT_TABLES_H")
+print("")
+print("#include <stdint.h>")
+print("")
+print("#define FFT_TABLE_SIZE %d" % size)
+print("")
+print("/* fft_sin_q31[i] = sin(2 * pi * i / FFT_TABLE_SIZE) in Q31, first quadrant */")
+print("static const int32_t fft_sin_q31[%d] = {" % entries)
+vals = []
+for i in range(entries):
+    v = int(round(math.sin(2 * math.pi * i / size) * 2147483648.0))
+    vals.append(min(v, 2147483647))
+for i in range(0, entries, 6):
+    print("    " + " ".join("%d," % v for v in vals[i:i + 6]))
+print("};")
+print("")
+print("#endif")
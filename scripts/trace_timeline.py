@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+# Turns a perf recording of the tinyalsa probes (see trace.h) into a per
+# period timeline: how long each pcm_read()/pcm_write() blocked, how far
+# the gap to the previous one was off the audio it moved, how long the
+# thread was off cpu and waiting for a cpu after its wakeup, and the xruns,
+# VAD transitions and segments in between.
+#
+#   (build pcm.c and tinycap.c with -DTINYALSA_TRACE)
+#   perf buildid-cache --add ./tinycap
+#   perf record -e 'sdt_tinyalsa:*' -e sched:sched_switch -e sched:sched_wakeup \
+#       -- ./tinycap
+#   perf script | python scripts/trace_timeline.py --rate 16000
+
+from __future__ import print_function
+
+import argparse
+import re
+import sys
+
+EVENT = re.compile(r'^\s*(.+?)\s+(\d+)(?:/\d+)?\s+\[(\d+)\]\s+([\d.]+):\s+'
+                   r'(?:sdt_)?(\w+):(\w+):\s*(.*)$')
+ARG = re.compile(r'(\w+)=(\S+)')
+
+
+def parse(lines):
+    for line in lines:
+        m = EVENT.match(line)
+        if not m:
+            continue
+        comm, tid, cpu, ts, provider, name, rest = m.groups()
+        args = dict(ARG.findall(rest))
+        yield provider, name, int(tid), int(cpu), float(ts), args
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--rate', type=int, default=16000,
+                    help='sample rate of the stream, to turn frames into time')
+    ap.add_argument('--tid', type=int, help='only this thread')
+    ap.add_argument('input', nargs='?', help='perf script output, else stdin')
+    opts = ap.parse_args()
+
+    src = open(opts.input) if opts.input else sys.stdin
+
+    start = None
+    entry = {}          # tid -> (time, frames) of the transfer in progress
+    last_exit = {}      # tid -> time the previous transfer returned
+    off_cpu = {}        # tid -> time switched out, while in a transfer
+    woken = {}          # tid -> time of the wakeup, until it runs
+    period = {}         # tid -> [off cpu ms, run delay ms] of this transfer
+    notes = []
+    offsets = []
+    blocked = []
+    xruns = 0
+
+    print('%10s %6s %4s %9s %9s %9s %9s %9s  %s' %
+          ('time ms', 'tid', 'cpu', 'frames', 'blocked', 'gap', 'gap-exp',
+           'off cpu', 'notes'))
+
+    for provider, name, tid, cpu, ts, args in parse(src):
+        if start is None:
+            start = ts
+        ms = (ts - start) * 1000.0
+
+        if provider == 'sched':
+            if name == 'sched_switch':
+                prev = int(args.get('prev_pid', -1))
+                nxt = int(args.get('next_pid', -1))
+                if prev in entry:
+                    off_cpu[prev] = ts
+                if nxt in off_cpu:
+                    period[nxt][0] += (ts - off_cpu.pop(nxt)) * 1000.0
+                if nxt in woken:
+                    if nxt in period:
+                        period[nxt][1] += (ts - woken[nxt]) * 1000.0
+                    del woken[nxt]
+            elif name == 'sched_wakeup':
+                pid = int(args.get('pid', -1))
+                if pid in entry:
+                    woken[pid] = ts
+            continue
+
+        if provider != 'tinyalsa' or (opts.tid and tid != opts.tid):
+            continue
+
+        if name in ('pcm_read_entry', 'pcm_write_entry'):
+            entry[tid] = (ts, int(args.get('arg2', '0'), 0))
+            period[tid] = [0.0, 0.0]
+        elif name in ('pcm_read_exit', 'pcm_write_exit') and tid in entry:
+            t0, frames = entry.pop(tid)
+            held = (ts - t0) * 1000.0
+            expected = frames * 1000.0 / opts.rate
+            gap = off = ''
+            if tid in last_exit:
+                g = (ts - last_exit[tid]) * 1000.0
+                offsets.append(g - expected)
+                gap, off = '%9.3f' % g, '%9.3f' % (g - expected)
+            last_exit[tid] = ts
+            blocked.append(held)
+            away, delay = period.pop(tid, [0.0, 0.0])
+            if int(args.get('arg2', '0'), 0) != 0:
+                notes.append('error')
+            print('%10.3f %6d %4d %9d %9.3f %9s %9s %9.3f  %s' %
+                  (ms, tid, cpu, frames, held, gap, off, away,
+                   ' '.join(notes + (['wakeup delay %.3f' % delay] if delay else []))))
+            notes = []
+        elif name == 'pcm_xrun':
+            xruns += 1
+            notes.append('XRUN')
+        elif name == 'pcm_xrun_recovered':
+            notes.append('recovered')
+        elif name == 'pcm_mmap_commit':
+            print('%10.3f %6d %4d %9d %9s %9s %9s %9s  mmap commit at %d' %
+                  (ms, tid, cpu, int(args.get('arg3', '0'), 0), '', '', '', '',
+                   int(args.get('arg2', '0'), 0)))
+        elif name in ('vad_start', 'vad_stop'):
+            notes.append('%s %d' % (name, int(args.get('arg1', '0'), 0)))
+        elif name == 'segment_open':
+            notes.append('segment %d open' % int(args.get('arg1', '0'), 0))
+        elif name == 'segment_close':
+            notes.append('segment %d closed, %d frames%s' %
+                         (int(args.get('arg1', '0'), 0), int(args.get('arg2', '0'), 0),
+                          '' if int(args.get('arg3', '0'), 0) else ', dropped'))
+
+    if notes:
+        print('%10s %6s %4s %9s %9s %9s %9s %9s  %s' %
+              ('', '', '', '', '', '', '', '', ' '.join(notes)))
+    print()
+    print('%d transfers, %d xruns' % (len(blocked), xruns))
+    for label, values in (('blocked ms', blocked), ('gap-exp ms', offsets)):
+        print('%-11s p50 %8.3f p90 %8.3f p99 %8.3f max %8.3f' %
+              (label, percentile(values, 50), percentile(values, 90),
+               percentile(values, 99), max(values) if values else 0.0))
+
+
+if __name__ == '__main__':
+    main()
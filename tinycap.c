@@ -27,18 +27,26 @@
 */
 
 #include "asoundlib.h"
+#include "capmux.h"
+#include "duplex.h"
+#include "aec.h"
+#include "preproc.h"
+#include "mfcc.h"
+#include "trace.h"
+#include "wav.h"
+#include "blackbox.h"
+#include "archive.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <signal.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
 
-#define ID_RIFF 0x46464952
-#define ID_WAVE 0x45564157
-#define ID_FMT  0x20746d66 
-#define ID_DATA 0x61746164 
-
-#define FORMAT_PCM 1
+#include <sys/stat.h>
 
 #define SAMPLE_RATE_SET 16000
 #define THRESHOLD_AUDIO 256//at least 256 sample datas is not voice.
@@ -50,23 +58,79 @@
 /* To realease this code,just undefine this macro! */
 //#define DEBUG_FLAG
 
-struct wav_header {
-    uint32_t riff_id;
-    uint32_t riff_sz;
-    uint32_t riff_fmt;
-    uint32_t fmt_id;
-    uint32_t fmt_sz;
-    uint16_t audio_format;
-    uint16_t num_channels;
-    uint32_t sample_rate;
-    uint32_t byte_rate;
-    uint16_t block_align;
-    uint16_t bits_per_sample;
-    uint32_t data_id;
-    uint32_t data_sz;
+int capturing = 1;
+/* set by SIGUSR1 to print the capture PCM statistics */
+static int dump_stats;
+
+/* when set, read from this capture mux (see tinycapmux) instead of the PCM */
+static const char *capture_mux;
+/* when set, play this wav on play_device while capturing and cancel its echo */
+static const char *prompt_file;
+static unsigned int play_device;
+/* channel masks of the pre-processing stages run ahead of the VAD */
+static unsigned int highpass_mask;
+static unsigned int denoise_mask;
+/* when set, write log-mel/MFCC features of each segment to a .mfc sidecar */
+static int mfcc_sidecar;
+/* when set, keep the last seconds of capture and save them on SIGUSR2 or a
+ * "save" sent to blackbox_socket */
+static unsigned int blackbox_seconds;
+static const char *blackbox_socket;
+static unsigned int blackbox_flags = BLACKBOX_MEMFD;
+static struct blackbox *blackbox;
+/* when set, archive all of the capture to files rotated every archive_seconds
+ * or archive_mb, alongside the segments */
+static const char *archive_prefix;
+static unsigned int archive_seconds;
+static unsigned int archive_mb;
+/* the open segment's header is rewritten every checkpoint_ms of audio so it
+ * stays playable, and synced to storage every fsync_checkpoints of those */
+static unsigned int checkpoint_ms = 1000;
+static unsigned int fsync_checkpoints;
+/* when set, append the frame range and times of every kept segment here */
+static const char *segment_index;
+/* when set, time the segment write path on this many seconds of synthetic
+ * audio instead of capturing */
+static unsigned int bench_seconds;
+
+#define AEC_BLOCK_SIZE  256  //16ms at 16kHz
+#define AEC_PARTITIONS  8    //echo tail of 8 blocks
+#define MUX_SILENCE_MS  2000 //a mux quiet this long has lost its producer
+
+/* where capture_sample() gets its audio from */
+struct capture_source {
+    struct pcm *pcm;
+    struct capmux_reader *mux;
+    struct duplex *duplex;
+    struct aec *aec;
+    struct preproc *pre;
+    unsigned int frame_bytes;
+    unsigned int rate;
+    /* frames read so far, and the time of frame anchor_frame */
+    unsigned long long frames;
+    unsigned long long anchor_frame;
+    struct timespec anchor;
+    FILE *prompt;
+    uint8_t *play;
+    uint8_t *ref;
+    unsigned int period_bytes;
 };
 
-int capturing = 1;
+/* where a segment lies in the stream, for the index */
+struct segment_times {
+    unsigned long long start;
+    unsigned long long end;
+    struct timespec start_mono;
+    struct timespec end_mono;
+    struct timespec start_wall;
+};
+
+/* the .mfc file written next to the segment being captured */
+struct segment_features {
+    struct mfcc *mfcc;
+    FILE *file;
+    struct mfcc_header header;
+};
 
 #ifdef DEBUG_FLAG
 unsigned int capture_sample(FILE *file, unsigned int card, unsigned int device,
@@ -82,11 +146,45 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
 int capture_audio();
 #endif
 
+int capture_open(struct capture_source *src, unsigned int card, unsigned int device,
+                 struct pcm_config *config, unsigned int *size);
+void capture_close(struct capture_source *src);
+int capture_read(struct capture_source *src, void *data, unsigned int count);
+void capture_stamp(struct capture_source *src);
+void capture_frame_time(struct capture_source *src, unsigned long long frame,
+                        struct timespec *ts);
+void segment_index_write(const char *name, int index, const char *file_name,
+                         const struct segment_times *times);
+int features_open(struct segment_features *sf, const char *name);
+void features_close(struct segment_features *sf, const char *name, int keep);
+void features_write(void *arg, const int16_t *vec, unsigned int dims);
+void segment_checkpoint(FILE *file, struct wav_header *header, unsigned int frames,
+                        struct segment_features *sf, unsigned int *checkpoints);
+unsigned int segment_recover(const char *name, const char *features_name,
+                             const struct wav_header *format);
+int segment_keep_recovered(const char *name, const char *features_name,
+                           unsigned int frames, unsigned int rate);
+int segment_bench(struct wav_header *header, unsigned int period_size,
+                  unsigned int seconds);
+
 void sigint_handler(int sig)
 {
     capturing = 0;
 }
 
+void sigusr1_handler(int sig)
+{
+    dump_stats = 1;
+}
+
+void sigusr2_handler(int sig)
+{
+    struct blackbox *bb = blackbox;
+
+    if (bb)
+        blackbox_trigger(bb);
+}
+
 #ifdef DEBUG_FLAG
 int main(int argc, char **argv)
 {
@@ -104,7 +202,12 @@ int main(int argc, char **argv)
 
     if (argc < 2) {
         fprintf(stderr, "Usage: %s file.wav [-D card] [-d device] [-c channels] "
-                "[-r rate] [-b bits] [-p period_size] [-n n_periods]\n", argv[0]);
+                "[-r rate] [-b bits] [-p period_size] [-n n_periods] [-M mux] "
+                "[-P prompt.wav] [-o play_device] [-H hp_channel_mask] "
+                "[-N ns_channel_mask] [-F] [-B blackbox_seconds] [-U blackbox_socket] "
+                "[-G] [-A archive_prefix] [-T rotate_seconds] [-L rotate_mb] "
+                "[-C checkpoint_ms] [-S fsync_checkpoints] [-I index_file] "
+                "[-K bench_seconds]\n", argv[0]);
         return 1;
     }
 
@@ -145,20 +248,71 @@ int main(int argc, char **argv)
             argv++;
             if (*argv)
                 period_count = atoi(*argv);
+        } else if (strcmp(*argv, "-M") == 0) {
+            argv++;
+            if (*argv)
+                capture_mux = *argv;
+        } else if (strcmp(*argv, "-P") == 0) {
+            argv++;
+            if (*argv)
+                prompt_file = *argv;
+        } else if (strcmp(*argv, "-o") == 0) {
+            argv++;
+            if (*argv)
+                play_device = atoi(*argv);
+        } else if (strcmp(*argv, "-H") == 0) {
+            argv++;
+            if (*argv)
+                highpass_mask = strtoul(*argv, NULL, 0);
+        } else if (strcmp(*argv, "-N") == 0) {
+            argv++;
+            if (*argv)
+                denoise_mask = strtoul(*argv, NULL, 0);
+        } else if (strcmp(*argv, "-F") == 0) {
+            mfcc_sidecar = 1;
+        } else if (strcmp(*argv, "-B") == 0) {
+            argv++;
+            if (*argv)
+                blackbox_seconds = atoi(*argv);
+        } else if (strcmp(*argv, "-U") == 0) {
+            argv++;
+            if (*argv)
+                blackbox_socket = *argv;
+        } else if (strcmp(*argv, "-G") == 0) {
+            blackbox_flags |= BLACKBOX_HUGEPAGE;
+        } else if (strcmp(*argv, "-A") == 0) {
+            argv++;
+            if (*argv)
+                archive_prefix = *argv;
+        } else if (strcmp(*argv, "-T") == 0) {
+            argv++;
+            if (*argv)
+                archive_seconds = atoi(*argv);
+        } else if (strcmp(*argv, "-L") == 0) {
+            argv++;
+            if (*argv)
+                archive_mb = atoi(*argv);
+        } else if (strcmp(*argv, "-C") == 0) {
+            argv++;
+            if (*argv)
+                checkpoint_ms = atoi(*argv);
+        } else if (strcmp(*argv, "-S") == 0) {
+            argv++;
+            if (*argv)
+                fsync_checkpoints = atoi(*argv);
+        } else if (strcmp(*argv, "-I") == 0) {
+            argv++;
+            if (*argv)
+                segment_index = *argv;
+        } else if (strcmp(*argv, "-K") == 0) {
+            argv++;
+            if (*argv)
+                bench_seconds = atoi(*argv);
         }
         if (*argv)
             argv++;
     }
 
-    header.riff_id = ID_RIFF;
-    header.riff_sz = 0;
-    header.riff_fmt = ID_WAVE;
-    header.fmt_id = ID_FMT;
-    header.fmt_sz = 16;
-    header.audio_format = FORMAT_PCM;
-    header.num_channels = channels;
-    header.sample_rate = rate;
-
     switch (bits) {
     case 32:
         format = PCM_FORMAT_S32_LE;
@@ -174,24 +328,27 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    header.bits_per_sample = pcm_format_to_bits(format);
-    header.byte_rate = (header.bits_per_sample / 8) * header.num_channels * header.sample_rate;
-    header.block_align = channels * (header.bits_per_sample / 8);
-    header.data_id = ID_DATA;
+    wav_header_init(&header, channels, rate, pcm_format_to_bits(format));
+
+    if (bench_seconds) {
+        fclose(file);
+        return segment_bench(&header, period_size, bench_seconds);
+    }
 
     /* leave enough room for header */
     fseek(file, sizeof(struct wav_header), SEEK_SET);
 
     /* install signal handler and begin capturing */
     signal(SIGINT, sigint_handler);
+    signal(SIGUSR1, sigusr1_handler);
+    signal(SIGUSR2, sigusr2_handler);
     frames = capture_sample(file, card, device, &header,header.num_channels,
                             header.sample_rate, format,
                             period_size, period_count);
     printf("Captured %d frames\n", frames);
 
     /* write wav header to file now,all information of header is known */
-    header.data_sz = frames * header.block_align;
-    header.riff_sz = header.data_sz + sizeof(header) - 8;
+    wav_header_set_frames(&header, frames);
     fseek(file, 0, SEEK_SET);
     fwrite(&header, sizeof(struct wav_header), 1, file);
 
@@ -200,8 +357,85 @@ int main(int argc, char **argv)
     return 0;
 }
 #else
-int main()
+int main(int argc, char **argv)
 {
+    /* parse command line arguments */
+    argv += 1;
+    while (*argv) {
+        if (strcmp(*argv, "-M") == 0) {
+            argv++;
+            if (*argv)
+                capture_mux = *argv;
+        } else if (strcmp(*argv, "-P") == 0) {
+            argv++;
+            if (*argv)
+                prompt_file = *argv;
+        } else if (strcmp(*argv, "-o") == 0) {
+            argv++;
+            if (*argv)
+                play_device = atoi(*argv);
+        } else if (strcmp(*argv, "-H") == 0) {
+            argv++;
+            if (*argv)
+                highpass_mask = strtoul(*argv, NULL, 0);
+        } else if (strcmp(*argv, "-N") == 0) {
+            argv++;
+            if (*argv)
+                denoise_mask = strtoul(*argv, NULL, 0);
+        } else if (strcmp(*argv, "-F") == 0) {
+            mfcc_sidecar = 1;
+        } else if (strcmp(*argv, "-B") == 0) {
+            argv++;
+            if (*argv)
+                blackbox_seconds = atoi(*argv);
+        } else if (strcmp(*argv, "-U") == 0) {
+            argv++;
+            if (*argv)
+                blackbox_socket = *argv;
+        } else if (strcmp(*argv, "-G") == 0) {
+            blackbox_flags |= BLACKBOX_HUGEPAGE;
+        } else if (strcmp(*argv, "-A") == 0) {
+            argv++;
+            if (*argv)
+                archive_prefix = *argv;
+        } else if (strcmp(*argv, "-T") == 0) {
+            argv++;
+            if (*argv)
+                archive_seconds = atoi(*argv);
+        } else if (strcmp(*argv, "-L") == 0) {
+            argv++;
+            if (*argv)
+                archive_mb = atoi(*argv);
+        } else if (strcmp(*argv, "-C") == 0) {
+            argv++;
+            if (*argv)
+                checkpoint_ms = atoi(*argv);
+        } else if (strcmp(*argv, "-S") == 0) {
+            argv++;
+            if (*argv)
+                fsync_checkpoints = atoi(*argv);
+        } else if (strcmp(*argv, "-I") == 0) {
+            argv++;
+            if (*argv)
+                segment_index = *argv;
+        } else if (strcmp(*argv, "-K") == 0) {
+            argv++;
+            if (*argv)
+                bench_seconds = atoi(*argv);
+        }
+        if (*argv)
+            argv++;
+    }
+
+    if (bench_seconds) {
+        struct wav_header header;
+
+        wav_header_init(&header, 1, SAMPLE_RATE_SET, pcm_format_to_bits(PCM_FORMAT_S16_LE));
+        return segment_bench(&header, 1024, bench_seconds);
+    }
+
+    signal(SIGUSR1, sigusr1_handler);
+    signal(SIGUSR2, sigusr2_handler);
     capture_audio();
     return 0;
 }
@@ -220,19 +454,7 @@ int capture_audio()
     struct wav_header header;
     unsigned int frames;
 
-    header.riff_id = ID_RIFF;
-    header.riff_sz = 0;
-    header.riff_fmt = ID_WAVE;
-    header.fmt_id = ID_FMT;
-    header.fmt_sz = 16;
-    header.audio_format = FORMAT_PCM;
-    header.num_channels = 1;
-    header.sample_rate = SAMPLE_RATE_SET;
-
-    header.bits_per_sample = pcm_format_to_bits(PCM_FORMAT_S16_LE);
-    header.byte_rate = (header.bits_per_sample / 8) * header.num_channels * header.sample_rate;
-    header.block_align = header.num_channels * (header.bits_per_sample / 8);
-    header.data_id = ID_DATA;
+    wav_header_init(&header, 1, SAMPLE_RATE_SET, pcm_format_to_bits(PCM_FORMAT_S16_LE));
 
     frames = capture_sample(0, 0,&header,1,SAMPLE_RATE_SET,PCM_FORMAT_S16_LE,1024,4);
 
@@ -255,7 +477,9 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
 #endif
 {
     struct pcm_config config;
-    struct pcm *pcm;
+    struct capture_source src;
+    struct segment_features features;
+    struct archive *archive = NULL;
     uint8_t *buffer;
     unsigned int size;
     unsigned int bytes_read = 0;
@@ -269,24 +493,54 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
     config.stop_threshold = 0;
     config.silence_threshold = 0;
 
-    pcm = pcm_open(card, device, PCM_IN, &config);
-    if (!pcm || !pcm_is_ready(pcm)) {
-        fprintf(stderr, "Unable to open PCM device (%s)\n",
-                pcm_get_error(pcm));
+    if (capture_open(&src, card, device, &config, &size) < 0)
         return 0;
-    }
-
-    size = pcm_frames_to_bytes(pcm, pcm_get_buffer_size(pcm));
 
+    memset(&features, 0, sizeof(features));
+    if (mfcc_sidecar) {
+        features.mfcc = mfcc_init(rate, MFCC_MEL_BANDS, MFCC_NUM_CEPS);
+        if (!features.mfcc || format != PCM_FORMAT_S16_LE) {
+            fprintf(stderr, "Unable to set up feature extraction\n");
+            mfcc_free(features.mfcc);
+            capture_close(&src);
+            return 0;
+        }
+    }
 
     buffer = (uint8_t *)malloc(size);
     if (!buffer) {
         fprintf(stderr, "Unable to allocate %d bytes\n", size);
         free(buffer);
-        pcm_close(pcm);
+        capture_close(&src);
         return 0;
     }
 
+    if (blackbox_seconds) {
+        blackbox = blackbox_open(&config, blackbox_seconds, "blackbox",
+                                 blackbox_socket, blackbox_flags);
+        if (!blackbox) {
+            fprintf(stderr, "Unable to set up the black box recorder\n");
+            free(buffer);
+            mfcc_free(features.mfcc);
+            capture_close(&src);
+            return 0;
+        }
+    }
+
+    if (archive_prefix) {
+        archive = archive_open(&config, archive_prefix, archive_seconds,
+                               archive_mb * 1024ULL * 1024);
+        if (!archive) {
+            fprintf(stderr, "Unable to start the archive '%s'\n", archive_prefix);
+            blackbox_close(blackbox);
+            blackbox = NULL;
+            free(buffer);
+            mfcc_free(features.mfcc);
+            capture_close(&src);
+            return 0;
+        }
+    }
+
     printf("Capturing sample: %u ch, %u hz, %u bit\n", channels, rate,pcm_format_to_bits(format));
     
     int i=0,j=0;
@@ -298,13 +552,39 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
     int frames_temp=0;
     int index=0;
     char *file_name = (char *)malloc(20);
-    FILE *file_temp;
+    const char *features_name = "0.mfc";
+    FILE *file_temp = NULL;
     int file_bytes_read=0;
+    unsigned int checkpoint_bytes = (unsigned long long)checkpoint_ms * rate / 1000 *
+        header->block_align;
+    unsigned int next_checkpoint = 0;
+    unsigned int checkpoints = 0;
+    struct segment_times times;
+    unsigned long long read_start;
+    struct timespec now_mono, now_wall;
 
+    /* make good what a crash or power loss left of the last segment, and
+     * move it out of the way of the first new one */
+    frames_temp = segment_recover("0.wav", features_name, header);
+    if (frames_temp && (index = segment_keep_recovered("0.wav", features_name,
+                                                       frames_temp, rate)) > 0) {
+        /*****the recovered segment is now index.wav, handle it like the others****/
+        //coding start
+
+        //coding end
+    }
+    index = 0;
 
     printf("%d\n",size);
-    while (capturing && !pcm_read(pcm, buffer, size)) 
+    while (capturing && !capture_read(&src, buffer, size)) 
     {
+        read_start = src.frames - size / header->block_align;
+        if (blackbox)
+            blackbox_write(blackbox, buffer, size / header->block_align);
+        if (archive && archive_write(archive, buffer, size / header->block_align) < 0) {
+            fprintf(stderr, "Error archiving sample\n");
+            break;
+        }
 
         for(j=0;j<=16-1;j++)//(1024*16 bytes)
         {
@@ -325,6 +605,7 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
             {//if it's a audio period,open the file_temp
                 start_write=1;
                 file_temp_open=1;
+                TRACE_PROBE1(vad_start, index);
                 sprintf(file_name,"0.wav");
                 //sprintf(file_name,"%d.wav",index);
                 file_temp = fopen(file_name, "wb");
@@ -333,6 +614,32 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                     fprintf(stderr, "Unable to create temp_file '%s'\n", file_name);
                     return 1;
                 }
+                /* leave enough room for header */
+                fseek(file_temp, sizeof(struct wav_header), SEEK_SET);
+                next_checkpoint = checkpoint_bytes;
+                if (features.mfcc && features_open(&features, features_name) < 0)
+                    fprintf(stderr, "Unable to create features file '%s'\n",
+                            features_name);
+                TRACE_PROBE1(segment_open, index);
+
+                /* the start time comes from the last anchor, the wall
+                 * clock is read once per segment */
+                times.start = read_start + j * 1024 / header->block_align;
+                capture_frame_time(&src, times.start, &times.start_mono);
+                clock_gettime(CLOCK_MONOTONIC, &now_mono);
+                clock_gettime(CLOCK_REALTIME, &now_wall);
+                times.start_wall.tv_sec = now_wall.tv_sec -
+                    (now_mono.tv_sec - times.start_mono.tv_sec);
+                times.start_wall.tv_nsec = now_wall.tv_nsec -
+                    (now_mono.tv_nsec - times.start_mono.tv_nsec);
+                while (times.start_wall.tv_nsec < 0) {
+                    times.start_wall.tv_nsec += 1000000000;
+                    times.start_wall.tv_sec--;
+                }
+                while (times.start_wall.tv_nsec >= 1000000000) {
+                    times.start_wall.tv_nsec -= 1000000000;
+                    times.start_wall.tv_sec++;
+                }
             }
 
             if (ignore_size > THRESHOLD_AUDIO) 
@@ -346,7 +653,11 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                 ignore_count = 0;
             }
 
-            if(ignore_count>COUNT_THRESHOLD)start_write=0;//set flag of ending to capture voice 
+            if(ignore_count>COUNT_THRESHOLD && start_write)
+            {//set flag of ending to capture voice
+                start_write=0;
+                TRACE_PROBE1(vad_stop, index);
+            }
 
             if(start_write)
             {//write to file_temp
@@ -356,6 +667,15 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                     break;
                 }
                 bytes_read += size/16;
+                if (features.file)
+                    mfcc_process(features.mfcc, (int16_t *)(buffer + j * 1024),
+                                 size / 16 / header->block_align, header->num_channels,
+                                 features_write, &features);
+                if (checkpoint_bytes && bytes_read >= next_checkpoint) {
+                    segment_checkpoint(file_temp, header, bytes_read / header->block_align,
+                                       &features, &checkpoints);
+                    next_checkpoint = bytes_read + checkpoint_bytes;
+                }
             }  
 
             else if(file_temp_open)
@@ -368,8 +688,7 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                 printf("Captured %d frames\n", frames_temp);
                 #endif
                 //write header now all information is known 
-                header->data_sz = frames_temp * header->block_align;
-                header->riff_sz = header->data_sz + sizeof(struct wav_header) - 8;
+                wav_header_set_frames(header, frames_temp);
                 fseek(file_temp, 0, SEEK_SET);
                 fwrite(header, sizeof(struct wav_header), 1, file_temp);
 
@@ -377,9 +696,16 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                 printf("%d\n",index);
                 #endif
 
+                TRACE_PROBE3(segment_close, index, frames_temp, 1);
+                if (segment_index) {
+                    times.end = times.start + bytes_read / header->block_align;
+                    capture_frame_time(&src, times.end, &times.end_mono);
+                    segment_index_write(segment_index, index, file_name, &times);
+                }
                 index++;
                 bytes_read=0;
                 fclose(file_temp);
+                features_close(&features, features_name, 1);
                 file_temp_open=0;
 
                 /*****generate a serial audio file, you can add code to handle this audio file!****/
@@ -390,8 +716,10 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
                 //coding end
                 }
                 else {
+                    TRACE_PROBE3(segment_close, index, frames_temp, 0);
                     bytes_read = 0;
                     fclose(file_temp);
+                    features_close(&features, features_name, 0);
                     file_temp_open = 0;
                     continue;
                 }
@@ -412,20 +740,26 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
     }
 
     if(file_temp_open){
-        frames_temp=pcm_bytes_to_frames(pcm, bytes_read);
+        frames_temp=bytes_read / header->block_align;
         if (frames_temp >= HIGH_THRESHOLD_FRAMES) {
         #ifdef DEBUG_FLAG
         printf("Captured %d frames\n", frames_temp);
         #endif
         //write header now all information is known 
-        header->data_sz = frames_temp * header->block_align;
-        header->riff_sz = header->data_sz + sizeof(struct wav_header) - 8;
+        wav_header_set_frames(header, frames_temp);
         fseek(file_temp, 0, SEEK_SET);
         fwrite(header, sizeof(struct wav_header), 1, file_temp);
         #ifdef DEBUG_FLAG
         printf("%d\n",index);
         #endif
+        TRACE_PROBE3(segment_close, index, frames_temp, 1);
+        if (segment_index) {
+            times.end = times.start + frames_temp;
+            capture_frame_time(&src, times.end, &times.end_mono);
+            segment_index_write(segment_index, index, file_name, &times);
+        }
         fclose(file_temp);
+        features_close(&features, features_name, 1);
         /*****generate a serial audio file, you can add code to handle this audio file!****/
         /*****************filename: index.wav(index is a incremental number)***************/
         //coding start
@@ -433,16 +767,718 @@ unsigned int capture_sample(unsigned int card, unsigned int device,
         //coding end
         }
         else {
+             TRACE_PROBE3(segment_close, index, frames_temp, 0);
              bytes_read = 0;
              fclose(file_temp);
              if(remove(file_name))fprintf(stderr, "Error remove error file!\n");
+             features_close(&features, features_name, 0);
              file_temp_open = 0;
         }
     }
 
+    archive_close(archive);
+    if (blackbox) {
+        struct blackbox *bb = blackbox;
+
+        blackbox = NULL;
+        blackbox_close(bb);
+    }
     free(buffer);
     free(file_name);
-    pcm_close(pcm);
+    mfcc_free(features.mfcc);
+    capture_close(&src);
     return file_bytes_read/2;
 }
 
+/*
+  brief:  make the open segment valid as it stands: rewrite\
+          its wav header, and the sidecar's, with what has\
+          been written so far, and every fsync_checkpoints\
+          calls push both to storage.
+**/
+void segment_checkpoint(FILE *file, struct wav_header *header, unsigned int frames,
+                        struct segment_features *sf, unsigned int *checkpoints)
+{
+    int sync = fsync_checkpoints && ++*checkpoints % fsync_checkpoints == 0;
+
+    fflush(file);
+    wav_header_set_frames(header, frames);
+    if (pwrite(fileno(file), header, sizeof(*header), 0) != sizeof(*header))
+        fprintf(stderr, "Error checkpointing segment\n");
+    if (sync)
+        fdatasync(fileno(file));
+
+    if (sf->file) {
+        fflush(sf->file);
+        if (pwrite(fileno(sf->file), &sf->header, sizeof(sf->header), 0) !=
+            sizeof(sf->header))
+            fprintf(stderr, "Error checkpointing features file\n");
+        if (sync)
+            fdatasync(fileno(sf->file));
+    }
+}
+
+/*
+  brief:  time the segment write path (tinycap -K): write\
+          seconds of synthetic audio to bench.wav the way\
+          capture_sample() writes a segment, checkpointing\
+          per -C and -S, as fast as storage takes it, print\
+          the throughput and the time spent checkpointing,\
+          and remove the file.
+  return: 0 on success, 1 otherwise
+**/
+int segment_bench(struct wav_header *header, unsigned int period_size,
+                  unsigned int seconds)
+{
+    const char *name = "bench.wav";
+    unsigned int period = period_size * header->block_align;
+    unsigned int chunk = period / 16;
+    unsigned long long total = (unsigned long long)seconds * header->sample_rate *
+        header->block_align;
+    unsigned int checkpoint_bytes = (unsigned long long)checkpoint_ms *
+        header->sample_rate / 1000 * header->block_align;
+    unsigned long long bytes = 0, next_checkpoint = checkpoint_bytes;
+    unsigned int checkpoints = 0, calls = 0;
+    double elapsed, spent = 0, longest = 0;
+    struct segment_features features;
+    struct timespec start, end, t0, t1;
+    uint8_t *buffer;
+    FILE *file;
+    unsigned int i, j;
+    int ret = 1;
+
+    if (!chunk) {
+        fprintf(stderr, "Period of %u frames is too short to bench\n", period_size);
+        return 1;
+    }
+
+    buffer = malloc(period);
+    if (!buffer) {
+        fprintf(stderr, "Unable to allocate %u bytes\n", period);
+        return 1;
+    }
+    /* noise, so no layer below can make light of it */
+    srand(1);
+    for (i = 0; i < period; i++)
+        buffer[i] = rand();
+
+    file = fopen(name, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to create '%s'\n", name);
+        free(buffer);
+        return 1;
+    }
+    memset(&features, 0, sizeof(features));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fseek(file, sizeof(struct wav_header), SEEK_SET);
+    while (bytes < total) {
+        for (j = 0; j < 16; j++) {
+            if (fwrite(buffer + j * chunk, 1, chunk, file) != chunk) {
+                fprintf(stderr, "Error writing '%s'\n", name);
+                goto done;
+            }
+            bytes += chunk;
+            if (checkpoint_bytes && bytes >= next_checkpoint) {
+                double t;
+
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                segment_checkpoint(file, header, bytes / header->block_align,
+                                   &features, &checkpoints);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+                spent += t;
+                if (t > longest)
+                    longest = t;
+                calls++;
+                next_checkpoint = bytes + checkpoint_bytes;
+            }
+        }
+    }
+    wav_header_set_frames(header, bytes / header->block_align);
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, sizeof(struct wav_header), 1, file);
+    fclose(file);
+    file = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%llu bytes, %u s of audio, in %.3f s: %.1f MB/s, %.0f times real time\n",
+           bytes, seconds, elapsed, bytes / elapsed / 1e6, seconds / elapsed);
+    if (calls)
+        printf("%u checkpoints every %u ms, fdatasync every %u: %.1f us mean, "
+               "%.1f us longest, %.1f%% of the time\n", calls, checkpoint_ms,
+               fsync_checkpoints, spent / calls * 1e6, longest * 1e6,
+               100 * spent / elapsed);
+    else
+        printf("no checkpoints\n");
+    ret = 0;
+
+done:
+    if (file)
+        fclose(file);
+    remove(name);
+    free(buffer);
+    return ret;
+}
+
+/*
+  brief:  repair a segment left open by a crash or power\
+          loss. The header is sized to the whole frames that\
+          made it to storage and a torn last frame is cut\
+          off; a segment too short to have been kept is\
+          removed, as are the sidecars of both. A sidecar\
+          whose header is torn or not of this MFCC setup is\
+          removed too.
+  para:   format is the header to use if the segment never\
+          got one
+  return: frames recovered, 0 if there was nothing to\
+          repair or keep
+**/
+unsigned int segment_recover(const char *name, const char *features_name,
+                             const struct wav_header *format)
+{
+    struct wav_header header;
+    struct mfcc_header mfh;
+    struct stat st;
+    unsigned int frames, vec_bytes;
+    int fd;
+
+    fd = open(name, O_RDWR);
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(header) ||
+        read(fd, &header, sizeof(header)) != sizeof(header) ||
+        header.riff_id != ID_RIFF || header.riff_fmt != ID_WAVE ||
+        header.data_id != ID_DATA || !header.block_align)
+        header = *format;
+
+    frames = 0;
+    if (st.st_size >= (off_t)sizeof(header)) {
+        frames = (st.st_size - sizeof(header)) / header.block_align;
+        if (header.data_sz == st.st_size - sizeof(header)) {
+            /* closed properly, and already handed on */
+            close(fd);
+            return 0;
+        }
+    }
+
+    if (frames < HIGH_THRESHOLD_FRAMES) {
+        close(fd);
+        fprintf(stderr, "Removing partial segment '%s'\n", name);
+        if (remove(name))
+            fprintf(stderr, "Error remove error file!\n");
+        remove(features_name);
+        return 0;
+    }
+
+    wav_header_set_frames(&header, frames);
+    if (ftruncate(fd, sizeof(header) + header.data_sz) < 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header) || fsync(fd) < 0) {
+        fprintf(stderr, "Unable to repair segment '%s'\n", name);
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    fprintf(stderr, "Recovered %u frames of segment '%s'\n", frames, name);
+
+    fd = open(features_name, O_RDWR);
+    if (fd < 0)
+        return frames;
+    if (fstat(fd, &st) < 0 || read(fd, &mfh, sizeof(mfh)) != sizeof(mfh) ||
+        mfh.magic != MFCC_MAGIC || mfh.mel_bands != MFCC_MEL_BANDS ||
+        mfh.num_ceps != MFCC_NUM_CEPS) {
+        close(fd);
+        fprintf(stderr, "Removing unusable features file '%s'\n", features_name);
+        if (remove(features_name))
+            fprintf(stderr, "Error remove features file!\n");
+        return frames;
+    }
+    vec_bytes = (mfh.mel_bands + mfh.num_ceps) * sizeof(int16_t);
+    mfh.count = (st.st_size - sizeof(mfh)) / vec_bytes;
+    if (ftruncate(fd, sizeof(mfh) + mfh.count * vec_bytes) < 0 ||
+        pwrite(fd, &mfh, sizeof(mfh), 0) != sizeof(mfh) || fsync(fd) < 0)
+        fprintf(stderr, "Unable to repair features file '%s'\n", features_name);
+    close(fd);
+    return frames;
+}
+
+/*
+  brief:  move a recovered segment and its sidecar to the first\
+          free n.wav and n.mfc, n > 0, which capture_sample()\
+          never reopens, and add it to the segment index. Its\
+          frames count from 0 and its monotonic times are lost\
+          with the old run, so they are written as 0; its wall\
+          clock start is worked back from its last write.
+  return: n, or -1 if it could not be moved
+**/
+int segment_keep_recovered(const char *name, const char *features_name,
+                           unsigned int frames, unsigned int rate)
+{
+    struct segment_times times;
+    struct stat st;
+    char kept[32], kept_features[32];
+    int n;
+
+    if (stat(name, &st) < 0)
+        return -1;
+
+    for (n = 1; n < 100000; n++) {
+        snprintf(kept, sizeof(kept), "%d.wav", n);
+        snprintf(kept_features, sizeof(kept_features), "%d.mfc", n);
+        if (access(kept, F_OK) < 0 && access(kept_features, F_OK) < 0)
+            break;
+    }
+    if (n == 100000 || rename(name, kept) < 0) {
+        fprintf(stderr, "Unable to move recovered segment '%s'\n", name);
+        return -1;
+    }
+    if (rename(features_name, kept_features) < 0 && errno != ENOENT)
+        fprintf(stderr, "Unable to move features file '%s'\n", features_name);
+    fprintf(stderr, "Kept recovered segment as '%s'\n", kept);
+
+    if (segment_index) {
+        memset(&times, 0, sizeof(times));
+        times.end = frames;
+        times.start_wall = st.st_mtim;
+        times.start_wall.tv_sec -= frames / rate;
+        times.start_wall.tv_nsec -= (long)(frames % rate) * 1000000000 / rate;
+        if (times.start_wall.tv_nsec < 0) {
+            times.start_wall.tv_nsec += 1000000000;
+            times.start_wall.tv_sec--;
+        }
+        segment_index_write(segment_index, n, kept, &times);
+    }
+    return n;
+}
+
+/*
+  brief:  append a kept segment to the index: its number,\
+          file, first and one past last frame in the stream,\
+          monotonic times of both and the wall clock time of\
+          its start. The file starts with a comment naming\
+          the columns.
+**/
+void segment_index_write(const char *name, int index, const char *file_name,
+                         const struct segment_times *times)
+{
+    FILE *file;
+
+    file = fopen(name, "a");
+    if (!file) {
+        fprintf(stderr, "Unable to open segment index '%s'\n", name);
+        return;
+    }
+    if (ftell(file) == 0)
+        fprintf(file, "# segment\tfile\tstart_frame\tend_frame\tstart_monotonic\t"
+                "end_monotonic\tstart_realtime\n");
+    fprintf(file, "%d\t%s\t%llu\t%llu\t%ld.%09ld\t%ld.%09ld\t%ld.%09ld\n", index,
+            file_name, times->start, times->end,
+            (long)times->start_mono.tv_sec, times->start_mono.tv_nsec,
+            (long)times->end_mono.tv_sec, times->end_mono.tv_nsec,
+            (long)times->start_wall.tv_sec, times->start_wall.tv_nsec);
+    fclose(file);
+}
+
+/*
+  brief:  start the feature sidecar of a new segment. The\
+          header is rewritten with the vector count when\
+          the segment is closed, like the wav header.
+  return: 0 on success, -1 otherwise
+**/
+int features_open(struct segment_features *sf, const char *name)
+{
+    sf->file = fopen(name, "wb");
+    if (!sf->file)
+        return -1;
+
+    mfcc_reset(sf->mfcc);
+    mfcc_get_header(sf->mfcc, &sf->header);
+    fwrite(&sf->header, sizeof(sf->header), 1, sf->file);
+    return 0;
+}
+
+/*
+  brief:  finish the sidecar of a segment, or drop it along\
+          with a segment too short to keep.
+**/
+void features_close(struct segment_features *sf, const char *name, int keep)
+{
+    if (!sf->file)
+        return;
+
+    if (keep) {
+        fseek(sf->file, 0, SEEK_SET);
+        fwrite(&sf->header, sizeof(sf->header), 1, sf->file);
+    }
+    fclose(sf->file);
+    sf->file = NULL;
+    if (!keep && remove(name))
+        fprintf(stderr, "Error remove features file!\n");
+}
+
+/* mfcc_process() callback, appends one vector to the sidecar */
+void features_write(void *arg, const int16_t *vec, unsigned int dims)
+{
+    struct segment_features *sf = arg;
+
+    if (fwrite(vec, sizeof(*vec), dims, sf->file) == dims)
+        sf->header.count++;
+}
+
+/*
+  brief:  open the wav file to play while capturing and\
+          leave it at the start of the samples. It has to\
+          match the capture format, the same config is used\
+          on both sides of the duplex engine.
+  return: the file, or NULL
+**/
+FILE *open_prompt(const char *name, struct pcm_config *config)
+{
+    struct {
+        uint32_t id;
+        uint32_t sz;
+    } chunk;
+    struct {
+        uint16_t audio_format;
+        uint16_t num_channels;
+        uint32_t sample_rate;
+        uint32_t byte_rate;
+        uint16_t block_align;
+        uint16_t bits_per_sample;
+    } fmt;
+    uint32_t riff[3];
+    int have_fmt = 0;
+    FILE *file;
+
+    file = fopen(name, "rb");
+    if (!file) {
+        fprintf(stderr, "Unable to open prompt '%s'\n", name);
+        return NULL;
+    }
+
+    if (fread(riff, sizeof(riff), 1, file) != 1 ||
+        riff[0] != ID_RIFF || riff[2] != ID_WAVE) {
+        fprintf(stderr, "Error: '%s' is not a riff/wave file\n", name);
+        goto fail;
+    }
+
+    for (;;) {
+        if (fread(&chunk, sizeof(chunk), 1, file) != 1) {
+            fprintf(stderr, "Error: '%s' has no data\n", name);
+            goto fail;
+        }
+        if (chunk.id == ID_DATA)
+            break;
+        if (chunk.id == ID_FMT && chunk.sz >= sizeof(fmt)) {
+            if (fread(&fmt, sizeof(fmt), 1, file) != 1)
+                goto fail;
+            have_fmt = 1;
+            chunk.sz -= sizeof(fmt);
+        }
+        fseek(file, chunk.sz, SEEK_CUR);
+    }
+
+    if (!have_fmt || fmt.num_channels != config->channels ||
+        fmt.sample_rate != config->rate ||
+        fmt.bits_per_sample != pcm_format_to_bits(config->format)) {
+        fprintf(stderr, "Error: prompt '%s' must be %u ch, %u hz, %u bit\n", name,
+                config->channels, config->rate, pcm_format_to_bits(config->format));
+        goto fail;
+    }
+
+    return file;
+
+fail:
+    fclose(file);
+    return NULL;
+}
+
+/*
+  brief:  open the audio source: the capture mux, the duplex\
+          engine with echo cancellation when a prompt is to\
+          be played, or else the capture PCM itself.
+  para:   size returns the bytes to read per loop
+  return: 0 on success, -1 otherwise
+**/
+int capture_open(struct capture_source *src, unsigned int card, unsigned int device,
+                 struct pcm_config *config, unsigned int *size)
+{
+    unsigned int block, c;
+
+    memset(src, 0, sizeof(*src));
+    src->frame_bytes = config->channels * (pcm_format_to_bits(config->format) / 8);
+    src->rate = config->rate;
+
+    if (highpass_mask || denoise_mask) {
+        if (config->format != PCM_FORMAT_S16_LE) {
+            fprintf(stderr, "Pre-processing needs 16 bit capture\n");
+            return -1;
+        }
+        src->pre = preproc_init(config->channels, config->rate);
+        if (!src->pre) {
+            fprintf(stderr, "Unable to set up pre-processing\n");
+            return -1;
+        }
+        for (c = 0; c < config->channels; c++)
+            preproc_set_mode(src->pre, c,
+                             (highpass_mask & (1U << c) ? PREPROC_HIGHPASS : 0) |
+                             (denoise_mask & (1U << c) ? PREPROC_DENOISE : 0));
+    }
+
+    if (capture_mux) {
+        struct pcm_config mux_config;
+
+        src->mux = capmux_attach(capture_mux);
+        if (!src->mux) {
+            fprintf(stderr, "Unable to attach to capture mux '%s'\n", capture_mux);
+            goto fail;
+        }
+        capmux_get_config(src->mux, &mux_config);
+        if (mux_config.channels != config->channels || mux_config.rate != config->rate ||
+            mux_config.format != config->format) {
+            fprintf(stderr, "Capture mux '%s' is %u ch, %u hz, %u bit\n",
+                    capture_mux, mux_config.channels, mux_config.rate,
+                    pcm_format_to_bits(mux_config.format));
+            goto fail;
+        }
+        /* wait on the mux a period at a time, but keep reading the
+         * same amount per loop as from the PCM */
+        src->period_bytes = mux_config.period_size * src->frame_bytes;
+        *size = config->period_size * config->period_count * config->channels *
+            (pcm_format_to_bits(config->format) / 8);
+        return 0;
+    }
+
+    if (prompt_file) {
+        if (config->channels != 1 || config->format != PCM_FORMAT_S16_LE) {
+            fprintf(stderr, "Echo cancellation needs 1 ch, 16 bit capture\n");
+            goto fail;
+        }
+        src->prompt = open_prompt(prompt_file, config);
+        if (!src->prompt)
+            goto fail;
+
+        src->duplex = duplex_open(card, play_device, device, config);
+        if (!src->duplex || !duplex_is_ready(src->duplex)) {
+            fprintf(stderr, "Unable to open duplex PCM devices (%s)\n",
+                    src->duplex ? duplex_get_error(src->duplex) : "no memory");
+            goto fail;
+        }
+
+        /* the largest power of two block that tiles a period */
+        for (block = AEC_BLOCK_SIZE; block > 16 && config->period_size % block; block >>= 1)
+            ;
+        src->aec = aec_init(block, AEC_PARTITIONS * AEC_BLOCK_SIZE / block, 0);
+        src->period_bytes = config->period_size * 2;
+        src->play = malloc(src->period_bytes);
+        src->ref = malloc(src->period_bytes);
+        if (!src->aec || !src->play || !src->ref || config->period_size % block) {
+            fprintf(stderr, "Unable to set up echo cancellation for %u frame periods\n",
+                    config->period_size);
+            goto fail;
+        }
+
+        *size = src->period_bytes * config->period_count;
+        return 0;
+    }
+
+    src->pcm = pcm_open(card, device, PCM_IN | PCM_STATS | PCM_MONOTONIC, config);
+    if (!src->pcm || !pcm_is_ready(src->pcm)) {
+        fprintf(stderr, "Unable to open PCM device (%s)\n",
+                pcm_get_error(src->pcm));
+        goto fail;
+    }
+
+    *size = pcm_frames_to_bytes(src->pcm, pcm_get_buffer_size(src->pcm));
+    return 0;
+
+fail:
+    capture_close(src);
+    return -1;
+}
+
+void capture_close(struct capture_source *src)
+{
+    if (src->aec) {
+        struct aec_stats stats;
+
+        aec_get_stats(src->aec, &stats);
+        printf("AEC: ERLE %.1f dB, delay %d frames, %u blocks of %u frames, "
+               "cpu %u us avg %u us max per block\n", stats.erle_db,
+               duplex_get_delay(src->duplex), stats.blocks,
+               aec_get_block_size(src->aec), stats.cpu_us_avg, stats.cpu_us_max);
+        aec_free(src->aec);
+    }
+    if (src->duplex)
+        duplex_close(src->duplex);
+    if (src->pre)
+        preproc_free(src->pre);
+    if (src->prompt)
+        fclose(src->prompt);
+    if (src->mux)
+        capmux_detach(src->mux);
+    if (src->pcm)
+        pcm_close(src->pcm);
+    free(src->play);
+    free(src->ref);
+    memset(src, 0, sizeof(*src));
+}
+
+/*
+  brief:  run the duplex engine for one period: queue the\
+          next period of the prompt (silence once it ends),\
+          capture one period and cancel the prompt's echo\
+          from it before the VAD ever sees it.
+  return: 0 on success, negative error otherwise
+**/
+int capture_read_duplex(struct capture_source *src, uint8_t *data)
+{
+    unsigned int block = aec_get_block_size(src->aec);
+    unsigned int frames = src->period_bytes / 2;
+    const void *play = NULL;
+    unsigned int i;
+    int ret;
+
+    if (src->prompt) {
+        size_t n = fread(src->play, 1, src->period_bytes, src->prompt);
+
+        if (n < src->period_bytes) {
+            memset(src->play + n, 0, src->period_bytes - n);
+            fclose(src->prompt);
+            src->prompt = NULL;
+        }
+        play = src->play;
+    }
+
+    ret = duplex_transfer(src->duplex, play, data, src->ref);
+    if (ret < 0) {
+        fprintf(stderr, "%s\n", duplex_get_error(src->duplex));
+        return ret;
+    }
+
+    for (i = 0; i < frames; i += block)
+        aec_process(src->aec, (int16_t *)data + i, (int16_t *)src->ref + i,
+                    (int16_t *)data + i);
+
+    return 0;
+}
+
+/*
+  brief:  read from the capture mux a period at a time, waiting\
+          at most a period for each, so ctrl-c is seen within a\
+          period whether or not the wait restarts. A producer\
+          that was killed never marks the mux dead, so one that\
+          publishes nothing for MUX_SILENCE_MS counts as gone.
+  return: 0 on success, -EINTR once capturing stops, negative\
+          error otherwise
+**/
+int capture_read_mux(struct capture_source *src, uint8_t *data, unsigned int count)
+{
+    int timeout_ms = src->period_bytes / src->frame_bytes * 1000 / src->rate + 1;
+    unsigned int offset, n;
+    int silent_ms, ret;
+
+    for (offset = 0; offset < count; offset += n) {
+        n = count - offset < src->period_bytes ? count - offset : src->period_bytes;
+        silent_ms = 0;
+        /* a timeout or signal consumes nothing, so just read again */
+        while ((ret = capmux_read(src->mux, data + offset, n, timeout_ms)) < 0) {
+            if (ret == -EPIPE) {
+                fprintf(stderr, "capture mux overrun, %u periods lost\n",
+                        capmux_get_overruns(src->mux));
+            } else if (ret == -ETIMEDOUT) {
+                silent_ms += timeout_ms;
+                if (silent_ms >= MUX_SILENCE_MS) {
+                    fprintf(stderr, "capture mux silent for %d ms, producer gone\n",
+                            silent_ms);
+                    return -ENODEV;
+                }
+            } else if (ret != -EINTR) {
+                return ret;
+            }
+            if (!capturing)
+                return -EINTR;
+        }
+    }
+
+    return 0;
+}
+
+/*
+  brief:  read one buffer of audio from the capture source\
+          and run the pre-processing on it. An overrun on the\
+          mux only costs this reader some audio, so report\
+          it and carry on like pcm_read() does.
+  return: 0 on success, negative error otherwise
+**/
+int capture_read(struct capture_source *src, void *data, unsigned int count)
+{
+    unsigned int offset;
+    int ret;
+
+    if (src->duplex) {
+        for (offset = 0; offset < count; offset += src->period_bytes) {
+            ret = capture_read_duplex(src, (uint8_t *)data + offset);
+            if (ret < 0)
+                return ret;
+        }
+    } else if (!src->mux) {
+        ret = pcm_read(src->pcm, data, count);
+        if (ret < 0)
+            return ret;
+        if (dump_stats) {
+            dump_stats = 0;
+            pcm_dump_stats(src->pcm, fileno(stderr));
+        }
+    } else {
+        ret = capture_read_mux(src, data, count);
+        if (ret < 0)
+            return ret;
+    }
+
+    src->frames += count / src->frame_bytes;
+    capture_stamp(src);
+
+    if (src->pre)
+        preproc_process(src->pre, data, count / src->frame_bytes);
+
+    return 0;
+}
+
+/*
+  brief:  anchor the stream's frame count to the monotonic\
+          clock once per buffer: with the PCM's timestamp of\
+          its hardware position, which costs no syscall when\
+          the status page is mapped, else with the time the\
+          read returned. Frame times are extrapolated from it.
+**/
+void capture_stamp(struct capture_source *src)
+{
+    unsigned int avail;
+    struct timespec ts;
+
+    if (src->pcm && pcm_get_htimestamp(src->pcm, &avail, &ts) == 0) {
+        src->anchor = ts;
+        src->anchor_frame = src->frames + avail;
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &src->anchor);
+        src->anchor_frame = src->frames;
+    }
+}
+
+/* the monotonic time frame was (or will be) captured at */
+void capture_frame_time(struct capture_source *src, unsigned long long frame,
+                        struct timespec *ts)
+{
+    long long ns = (long long)(frame - src->anchor_frame) * 1000000000LL / src->rate;
+
+    ns += src->anchor.tv_nsec;
+    ts->tv_sec = src->anchor.tv_sec + ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+    if (ts->tv_nsec < 0) {
+        ts->tv_nsec += 1000000000;
+        ts->tv_sec--;
+    }
+}
@@ -0,0 +1,168 @@
+/* tinycapmux.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include "asoundlib.h"
+#include "capmux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <string.h>
+
+static int capturing = 1;
+
+void sigint_handler(int sig)
+{
+    capturing = 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct pcm_config config;
+    struct pcm *pcm;
+    struct capmux *mux;
+    uint8_t *buffer;
+    unsigned int card = 0;
+    unsigned int device = 0;
+    unsigned int bits = 16;
+    unsigned int ring_periods = 32;
+    unsigned int size;
+    unsigned int periods = 0;
+    const char *name;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s name [-D card] [-d device] [-c channels] "
+                "[-r rate] [-b bits] [-p period_size] [-n n_periods] "
+                "[-N ring_periods]\n", argv[0]);
+        return 1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.channels = 1;
+    config.rate = 16000;
+    config.period_size = 1024;
+    config.period_count = 4;
+
+    /* parse command line arguments */
+    name = argv[1];
+    argv += 2;
+    while (*argv) {
+        if (strcmp(*argv, "-d") == 0) {
+            argv++;
+            if (*argv)
+                device = atoi(*argv);
+        } else if (strcmp(*argv, "-c") == 0) {
+            argv++;
+            if (*argv)
+                config.channels = atoi(*argv);
+        } else if (strcmp(*argv, "-r") == 0) {
+            argv++;
+            if (*argv)
+                config.rate = atoi(*argv);
+        } else if (strcmp(*argv, "-b") == 0) {
+            argv++;
+            if (*argv)
+                bits = atoi(*argv);
+        } else if (strcmp(*argv, "-D") == 0) {
+            argv++;
+            if (*argv)
+                card = atoi(*argv);
+        } else if (strcmp(*argv, "-p") == 0) {
+            argv++;
+            if (*argv)
+                config.period_size = atoi(*argv);
+        } else if (strcmp(*argv, "-n") == 0) {
+            argv++;
+            if (*argv)
+                config.period_count = atoi(*argv);
+        } else if (strcmp(*argv, "-N") == 0) {
+            argv++;
+            if (*argv)
+                ring_periods = atoi(*argv);
+        }
+        if (*argv)
+            argv++;
+    }
+
+    switch (bits) {
+    case 32:
+        config.format = PCM_FORMAT_S32_LE;
+        break;
+    case 24:
+        config.format = PCM_FORMAT_S24_LE;
+        break;
+    case 16:
+        config.format = PCM_FORMAT_S16_LE;
+        break;
+    default:
+        fprintf(stderr, "%d bits is not supported.\n", bits);
+        return 1;
+    }
+
+    pcm = pcm_open(card, device, PCM_IN, &config);
+    if (!pcm || !pcm_is_ready(pcm)) {
+        fprintf(stderr, "Unable to open PCM device (%s)\n",
+                pcm_get_error(pcm));
+        return 1;
+    }
+
+    /* publish what the driver actually gave us */
+    mux = capmux_create(name, &config, ring_periods);
+    if (!mux) {
+        fprintf(stderr, "Unable to create capture mux '%s'\n", name);
+        pcm_close(pcm);
+        return 1;
+    }
+
+    size = capmux_get_period_bytes(mux);
+    buffer = malloc(size);
+    if (!buffer) {
+        fprintf(stderr, "Unable to allocate %d bytes\n", size);
+        capmux_destroy(mux);
+        pcm_close(pcm);
+        return 1;
+    }
+
+    printf("Publishing '%s': %u ch, %u hz, %u bit, %u frames x %u periods\n",
+           name, config.channels, config.rate, pcm_format_to_bits(config.format),
+           config.period_size, ring_periods);
+
+    signal(SIGINT, sigint_handler);
+    signal(SIGTERM, sigint_handler);
+    while (capturing && !pcm_read(pcm, buffer, size)) {
+        capmux_publish(mux, buffer);
+        periods++;
+    }
+
+    printf("Published %u periods\n", periods);
+
+    free(buffer);
+    capmux_destroy(mux);
+    pcm_close(pcm);
+    return 0;
+}
@@ -0,0 +1,309 @@
+/* tinylatency.c
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#include "asoundlib.h"
+#include "duplex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_CONFIGS         16
+#define CHIRP_MS            20      /* probe length */
+#define CHIRP_LOW_HZ        500
+#define CHIRP_AMPLITUDE     16384
+#define DETECT_THRESHOLD    0.5f    /* normalised correlation at the peak */
+
+static int measuring = 1;
+
+void sigint_handler(int sig)
+{
+    measuring = 0;
+}
+
+/* Hann windowed linear sweep, which correlates to a single sharp peak */
+static float *make_chirp(unsigned int rate, unsigned int frames)
+{
+    float *chirp;
+    double f0 = CHIRP_LOW_HZ, f1 = rate * 0.4, t, dur = (double)frames / rate;
+    unsigned int i;
+
+    chirp = malloc(frames * sizeof(float));
+    if (!chirp)
+        return NULL;
+
+    for (i = 0; i < frames; i++) {
+        t = (double)i / rate;
+        chirp[i] = sin(2 * M_PI * (f0 * t + (f1 - f0) * t * t / (2 * dur))) *
+            (0.5 - 0.5 * cos(2 * M_PI * i / (frames - 1)));
+    }
+    return chirp;
+}
+
+/* Where the chirp starts in window, to a fraction of a frame, or -1 if it
+ * is not there */
+static float detect(const float *window, unsigned int window_frames,
+                    const float *chirp, unsigned int chirp_frames)
+{
+    double best = 0, c, prev = 0, next = 0, echirp = 0, ewin = 0, d;
+    unsigned int lag, peak = 0, i;
+
+    for (lag = 0; lag + chirp_frames <= window_frames; lag++) {
+        for (i = 0, c = 0; i < chirp_frames; i++)
+            c += window[lag + i] * chirp[i];
+        if (fabs(c) > fabs(best)) {
+            best = c;
+            peak = lag;
+        }
+    }
+
+    for (i = 0; i < chirp_frames; i++) {
+        echirp += chirp[i] * chirp[i];
+        ewin += window[peak + i] * window[peak + i];
+    }
+    if (!ewin || fabs(best) / sqrt(echirp * ewin) < DETECT_THRESHOLD)
+        return -1;
+
+    /* parabola through the peak and its neighbours */
+    if (peak > 0 && peak + chirp_frames < window_frames) {
+        for (i = 0; i < chirp_frames; i++) {
+            prev += window[peak - 1 + i] * chirp[i];
+            next += window[peak + 1 + i] * chirp[i];
+        }
+        d = prev - 2 * best + next;
+        if (d)
+            return peak + 0.5 * (prev - next) / d;
+    }
+    return peak;
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Runs trials round trips on one config. Each trial plays the chirp and
+ * records from the capture position at the moment it was queued, so the
+ * lag found is the application to application round trip: frames between
+ * handing a frame to the playback stream and reading it back.
+ */
+static int measure(unsigned int card, unsigned int play_device,
+                   unsigned int cap_device, struct pcm_config *config,
+                   unsigned int trials, unsigned int max_ms)
+{
+    struct duplex *dx;
+    int16_t *play = NULL, *mic = NULL, *ref = NULL;
+    float *chirp = NULL, *window = NULL, *lags = NULL;
+    unsigned int chirp_frames, window_frames, period_bytes;
+    unsigned int t, i, c, got, sent, found = 0;
+    double sum = 0;
+    int ret = -1;
+
+    dx = duplex_open(card, play_device, cap_device, config);
+    if (!dx || !duplex_is_ready(dx)) {
+        fprintf(stderr, "Unable to open duplex PCM devices (%s)\n",
+                dx ? duplex_get_error(dx) : "no memory");
+        goto done;
+    }
+
+    chirp_frames = config->rate * CHIRP_MS / 1000;
+    window_frames = config->rate * max_ms / 1000 + chirp_frames;
+    period_bytes = config->period_size * config->channels * sizeof(int16_t);
+    chirp = make_chirp(config->rate, chirp_frames);
+    window = malloc(window_frames * sizeof(float));
+    lags = malloc(trials * sizeof(float));
+    play = malloc(period_bytes);
+    mic = malloc(period_bytes);
+    ref = malloc(period_bytes);
+    if (!chirp || !window || !lags || !play || !mic || !ref) {
+        fprintf(stderr, "Unable to allocate buffers\n");
+        goto done;
+    }
+
+    /* let both streams settle before the first probe */
+    for (i = 0; i < 2 * config->period_count; i++)
+        if (duplex_transfer(dx, NULL, mic, ref) < 0)
+            goto xfer_error;
+
+    for (t = 0; t < trials && measuring; t++) {
+        for (got = 0, sent = 0; got < window_frames && measuring; ) {
+            memset(play, 0, period_bytes);
+            for (i = 0; i < config->period_size && sent < chirp_frames; i++, sent++)
+                for (c = 0; c < config->channels; c++)
+                    play[i * config->channels + c] = chirp[sent] * CHIRP_AMPLITUDE;
+
+            if (duplex_transfer(dx, play, mic, ref) < 0)
+                goto xfer_error;
+
+            for (i = 0; i < config->period_size && got < window_frames; i++, got++)
+                window[got] = mic[i * config->channels] / 32768.0f;
+        }
+        if (got < window_frames)
+            break;
+
+        lags[found] = detect(window, window_frames, chirp, chirp_frames);
+        if (lags[found] < 0) {
+            fprintf(stderr, "trial %u: chirp not found\n", t);
+            continue;
+        }
+        sum += lags[found];
+        found++;
+    }
+
+    printf("period %u x %u, %u hz: ", config->period_size, config->period_count,
+           config->rate);
+    if (!found) {
+        printf("no round trip found in %u trials\n", t);
+        goto done;
+    }
+
+    qsort(lags, found, sizeof(float), compare_float);
+    printf("%u/%u trials, round trip ms min %.2f median %.2f p90 %.2f max %.2f "
+           "mean %.2f, path %.2f ms, nominal %.2f ms per stream\n", found, t,
+           lags[0] * 1000 / config->rate, lags[found / 2] * 1000 / config->rate,
+           lags[found * 9 / 10] * 1000 / config->rate,
+           lags[found - 1] * 1000 / config->rate, sum / found * 1000 / config->rate,
+           duplex_get_delay(dx) * 1000.0 / config->rate,
+           config->period_size * config->period_count * 1000.0 / config->rate);
+    ret = found == t ? 0 : -1;
+    goto done;
+
+xfer_error:
+    fprintf(stderr, "%s\n", duplex_get_error(dx));
+done:
+    duplex_close(dx);
+    free(chirp);
+    free(window);
+    free(lags);
+    free(play);
+    free(mic);
+    free(ref);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    struct pcm_config config;
+    unsigned int card = 0;
+    unsigned int play_device = 0;
+    unsigned int cap_device = 0;
+    unsigned int trials = 10;
+    unsigned int max_ms = 500;
+    unsigned int period_sizes[MAX_CONFIGS] = { 1024 };
+    unsigned int num_configs = 1;
+    unsigned int i;
+    char *p;
+    int ret = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.channels = 1;
+    config.rate = 48000;
+    config.period_count = 4;
+    config.format = PCM_FORMAT_S16_LE;
+
+    /* parse command line arguments */
+    argv += 1;
+    while (*argv) {
+        if (strcmp(*argv, "-D") == 0) {
+            argv++;
+            if (*argv)
+                card = atoi(*argv);
+        } else if (strcmp(*argv, "-d") == 0) {
+            argv++;
+            if (*argv)
+                play_device = atoi(*argv);
+        } else if (strcmp(*argv, "-i") == 0) {
+            argv++;
+            if (*argv)
+                cap_device = atoi(*argv);
+        } else if (strcmp(*argv, "-c") == 0) {
+            argv++;
+            if (*argv)
+                config.channels = atoi(*argv);
+        } else if (strcmp(*argv, "-r") == 0) {
+            argv++;
+            if (*argv)
+                config.rate = atoi(*argv);
+        } else if (strcmp(*argv, "-p") == 0) {
+            argv++;
+            if (*argv) {
+                /* a comma separated list, one config each */
+                for (num_configs = 0, p = *argv; *p && num_configs < MAX_CONFIGS; ) {
+                    period_sizes[num_configs++] = strtoul(p, &p, 0);
+                    if (*p == ',')
+                        p++;
+                    else
+                        break;
+                }
+            }
+        } else if (strcmp(*argv, "-n") == 0) {
+            argv++;
+            if (*argv)
+                config.period_count = atoi(*argv);
+        } else if (strcmp(*argv, "-t") == 0) {
+            argv++;
+            if (*argv)
+                trials = atoi(*argv);
+        } else if (strcmp(*argv, "-m") == 0) {
+            argv++;
+            if (*argv)
+                max_ms = atoi(*argv);
+        } else {
+            fprintf(stderr, "Usage: tinylatency [-D card] [-d play_device] "
+                    "[-i capture_device] [-c channels] [-r rate] "
+                    "[-p period_size[,period_size...]] [-n n_periods] "
+                    "[-t trials] [-m max_ms]\n");
+            return 1;
+        }
+        if (*argv)
+            argv++;
+    }
+
+    if (!config.channels || !config.rate || !trials || !max_ms) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    signal(SIGINT, sigint_handler);
+
+    for (i = 0; i < num_configs && measuring; i++) {
+        struct pcm_config cfg = config;
+
+        cfg.period_size = period_sizes[i];
+        if (!cfg.period_size || measure(card, play_device, cap_device, &cfg,
+                                        trials, max_ms) < 0)
+            ret = 1;
+    }
+
+    return ret;
+}
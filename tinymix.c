@@ -30,19 +30,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
 #include <string.h>
+#include <strings.h>
+
+#include "json.h"
 
 static void tinymix_list_controls(struct mixer *mixer);
 static void tinymix_detail_control(struct mixer *mixer, const char *control,
                                    int print_all);
+static void tinymix_print_control(struct mixer_ctl *ctl, int print_all);
 static void tinymix_set_value(struct mixer *mixer, const char *control,
                               char **values, unsigned int num_values);
-static void tinymix_print_enum(struct mixer_ctl *ctl, int print_all);
+static void tinymix_print_enum(struct mixer_ctl *ctl, int value, int print_all);
+static void tinymix_monitor(struct mixer *mixer);
+static void tinymix_list_json(struct mixer *mixer);
+static int tinymix_apply_scenario(struct mixer *mixer, const char *path);
+static int tinymix_parse_db(const char *value, int *db);
+static void tinymix_print_db(int db);
 
 int main(int argc, char **argv)
 {
     struct mixer *mixer;
     int card = 0;
+    int ret = 0;
 
     if ((argc > 2) && (strcmp(argv[1], "-D") == 0)) {
         argv++;
@@ -65,17 +76,23 @@ int main(int argc, char **argv)
     if (argc == 1) {
         printf("Mixer name: '%s'\n", mixer_get_name(mixer));
         tinymix_list_controls(mixer);
+    } else if (argc == 2 && strcmp(argv[1], "-m") == 0) {
+        tinymix_monitor(mixer);
+    } else if (argc == 2 && strcmp(argv[1], "-j") == 0) {
+        tinymix_list_json(mixer);
+    } else if (argc == 3 && strcmp(argv[1], "-s") == 0) {
+        ret = tinymix_apply_scenario(mixer, argv[2]);
     } else if (argc == 2) {
         tinymix_detail_control(mixer, argv[1], 1);
     } else if (argc >= 3) {
         tinymix_set_value(mixer, argv[1], &argv[2], argc - 2);
     } else {
-        printf("Usage: tinymix [-D card] [control id] [value to set]\n");
+        printf("Usage: tinymix [-D card] [-j | -m | -s scenario | control id] [value to set]\n");
     }
 
     mixer_close(mixer);
 
-    return 0;
+    return ret ? EXIT_FAILURE : 0;
 }
 
 static void tinymix_list_controls(struct mixer *mixer)
@@ -97,11 +114,11 @@ static void tinymix_list_controls(struct mixer *mixer)
         type = mixer_ctl_get_type_string(ctl);
         num_values = mixer_ctl_get_num_values(ctl);
         printf("%d\t%s\t%d\t%-40s", i, type, num_values, name);
-        tinymix_detail_control(mixer, name, 0);
+        tinymix_print_control(ctl, 0);
     }
 }
 
-static void tinymix_print_enum(struct mixer_ctl *ctl, int print_all)
+static void tinymix_print_enum(struct mixer_ctl *ctl, int value, int print_all)
 {
     unsigned int num_enums;
     unsigned int i;
@@ -112,9 +129,8 @@ static void tinymix_print_enum(struct mixer_ctl *ctl, int print_all)
     for (i = 0; i < num_enums; i++) {
         string = mixer_ctl_get_enum_string(ctl, i);
         if (print_all)
-            printf("\t%s%s", mixer_ctl_get_value(ctl, 0) == (int)i ? ">" : "",
-                   string);
-        else if (mixer_ctl_get_value(ctl, 0) == (int)i)
+            printf("\t%s%s", value == (int)i ? ">" : "", string);
+        else if (value == (int)i)
             printf(" %-s", string);
     }
 }
@@ -123,10 +139,6 @@ static void tinymix_detail_control(struct mixer *mixer, const char *control,
                                    int print_all)
 {
     struct mixer_ctl *ctl;
-    enum mixer_ctl_type type;
-    unsigned int num_values;
-    unsigned int i;
-    int min, max;
 
     if (isdigit(control[0]))
         ctl = mixer_get_ctl(mixer, atoi(control));
@@ -138,43 +150,92 @@ static void tinymix_detail_control(struct mixer *mixer, const char *control,
         return;
     }
 
+    tinymix_print_control(ctl, print_all);
+}
+
+static void tinymix_print_control(struct mixer_ctl *ctl, int print_all)
+{
+    enum mixer_ctl_type type;
+    unsigned int num_values;
+    unsigned int i;
+    int min, max;
+    int *values = NULL;
+
     type = mixer_ctl_get_type(ctl);
     num_values = mixer_ctl_get_num_values(ctl);
 
     if (print_all)
         printf("%s:", mixer_ctl_get_name(ctl));
 
+    /* one read for all the values */
+    if (num_values)
+        values = malloc(num_values * sizeof(*values));
+    if (values && mixer_ctl_get_values(ctl, values, num_values) < 0) {
+        free(values);
+        values = NULL;
+    }
+
     for (i = 0; i < num_values; i++) {
-        switch (type)
+        switch (values ? type : MIXER_CTL_TYPE_UNKNOWN)
         {
         case MIXER_CTL_TYPE_INT:
-            printf(" %d", mixer_ctl_get_value(ctl, i));
+            printf(" %d", values[i]);
             break;
         case MIXER_CTL_TYPE_BOOL:
-            printf(" %s", mixer_ctl_get_value(ctl, i) ? "On" : "Off");
+            printf(" %s", values[i] ? "On" : "Off");
             break;
         case MIXER_CTL_TYPE_ENUM:
-            tinymix_print_enum(ctl, print_all);
+            tinymix_print_enum(ctl, values[i], print_all);
             break;
          case MIXER_CTL_TYPE_BYTE:
-            printf(" 0x%02x", mixer_ctl_get_value(ctl, i));
+            printf(" 0x%02x", values[i]);
             break;
         default:
             printf(" unknown");
             break;
         };
     }
+    free(values);
 
     if (print_all) {
         if (type == MIXER_CTL_TYPE_INT) {
             min = mixer_ctl_get_range_min(ctl);
             max = mixer_ctl_get_range_max(ctl);
             printf(" (range %d->%d)", min, max);
+            if (mixer_ctl_get_db_range(ctl, &min, &max) == 0) {
+                printf(" (dB range ");
+                tinymix_print_db(min);
+                printf("->");
+                tinymix_print_db(max);
+                printf(")");
+            }
         }
     }
     printf("\n");
 }
 
+/* a value like "-10.5dB", in 1/100 dB */
+static int tinymix_parse_db(const char *value, int *db)
+{
+    char *end;
+    double v;
+
+    v = strtod(value, &end);
+    if (end == value || strcasecmp(end, "dB"))
+        return -1;
+
+    *db = (int)(v < 0 ? v * 100 - 0.5 : v * 100 + 0.5);
+    return 0;
+}
+
+static void tinymix_print_db(int db)
+{
+    if (db == MIXER_CTL_DB_MUTE)
+        printf("mute");
+    else
+        printf("%s%d.%02ddB", db < 0 ? "-" : "", abs(db) / 100, abs(db) % 100);
+}
+
 static void tinymix_set_value(struct mixer *mixer, const char *control,
                               char **values, unsigned int num_values)
 {
@@ -182,6 +243,7 @@ static void tinymix_set_value(struct mixer *mixer, const char *control,
     enum mixer_ctl_type type;
     unsigned int num_ctl_values;
     unsigned int i;
+    int db;
 
     if (isdigit(control[0]))
         ctl = mixer_get_ctl(mixer, atoi(control));
@@ -196,32 +258,37 @@ static void tinymix_set_value(struct mixer *mixer, const char *control,
     type = mixer_ctl_get_type(ctl);
     num_ctl_values = mixer_ctl_get_num_values(ctl);
 
-    if (isdigit(values[0][0])) {
+    if (num_values == 1 && tinymix_parse_db(values[0], &db) == 0) {
+        if (mixer_ctl_set_db(ctl, db))
+            fprintf(stderr, "Error: control has no dB scale\n");
+    } else if (isdigit(values[0][0])) {
+        int *ints;
+
+        if (num_values > num_ctl_values) {
+            fprintf(stderr,
+                    "Error: %d values given, but control only takes %d\n",
+                    num_values, num_ctl_values);
+            return;
+        }
+
+        ints = malloc(num_ctl_values * sizeof(*ints));
+        if (!ints) {
+            fprintf(stderr, "Error: out of memory\n");
+            return;
+        }
+
+        for (i = 0; i < num_values; i++)
+            ints[i] = atoi(values[i]);
+        /* a single value sets all of them the same */
         if (num_values == 1) {
-            /* Set all values the same */
-            int value = atoi(values[0]);
-
-            for (i = 0; i < num_ctl_values; i++) {
-                if (mixer_ctl_set_value(ctl, i, value)) {
-                    fprintf(stderr, "Error: invalid value\n");
-                    return;
-                }
-            }
-        } else {
-            /* Set multiple values */
-            if (num_values > num_ctl_values) {
-                fprintf(stderr,
-                        "Error: %d values given, but control only takes %d\n",
-                        num_values, num_ctl_values);
-                return;
-            }
-            for (i = 0; i < num_values; i++) {
-                if (mixer_ctl_set_value(ctl, i, atoi(values[i]))) {
-                    fprintf(stderr, "Error: invalid value for index %d\n", i);
-                    return;
-                }
-            }
+            for (i = 1; i < num_ctl_values; i++)
+                ints[i] = ints[0];
+            num_values = num_ctl_values;
         }
+
+        if (mixer_ctl_set_values(ctl, ints, num_values))
+            fprintf(stderr, "Error: invalid value\n");
+        free(ints);
     } else {
         if (type == MIXER_CTL_TYPE_ENUM) {
             if (num_values != 1) {
@@ -236,3 +303,119 @@ static void tinymix_set_value(struct mixer *mixer, const char *control,
     }
 }
 
+/* the mixer, then one JSON object per control per line */
+static void tinymix_list_json(struct mixer *mixer)
+{
+    struct mixer_ctl *ctl;
+    enum mixer_ctl_type type;
+    unsigned int num_ctls, num_values, num_enums;
+    unsigned int i, j;
+    int *values;
+    int min, max;
+
+    num_ctls = mixer_get_num_ctls(mixer);
+
+    printf("{\"mixer\":");
+    json_print_string(mixer_get_name(mixer));
+    printf(",\"controls\":%u}\n", num_ctls);
+
+    for (i = 0; i < num_ctls; i++) {
+        ctl = mixer_get_ctl(mixer, i);
+        type = mixer_ctl_get_type(ctl);
+        num_values = mixer_ctl_get_num_values(ctl);
+        num_enums = type == MIXER_CTL_TYPE_ENUM ? mixer_ctl_get_num_enums(ctl) : 0;
+
+        printf("{\"id\":%u,\"name\":", i);
+        json_print_string(mixer_ctl_get_name(ctl));
+        printf(",\"type\":\"%s\",\"num_values\":%u", mixer_ctl_get_type_string(ctl),
+               num_values);
+
+        values = num_values ? malloc(num_values * sizeof(*values)) : NULL;
+        if (values && mixer_ctl_get_values(ctl, values, num_values) == 0 &&
+            type != MIXER_CTL_TYPE_UNKNOWN && type != MIXER_CTL_TYPE_IEC958) {
+            printf(",\"values\":[");
+            for (j = 0; j < num_values; j++) {
+                if (j)
+                    putchar(',');
+                if (type == MIXER_CTL_TYPE_BOOL)
+                    printf("%s", values[j] ? "true" : "false");
+                else if (type == MIXER_CTL_TYPE_ENUM && values[j] >= 0 &&
+                         (unsigned int)values[j] < num_enums)
+                    json_print_string(mixer_ctl_get_enum_string(ctl, values[j]));
+                else
+                    printf("%d", values[j]);
+            }
+            putchar(']');
+        } else {
+            printf(",\"values\":null");
+        }
+        free(values);
+
+        if (type == MIXER_CTL_TYPE_INT) {
+            printf(",\"min\":%d,\"max\":%d", mixer_ctl_get_range_min(ctl),
+                   mixer_ctl_get_range_max(ctl));
+            if (mixer_ctl_get_db_range(ctl, &min, &max) == 0)
+                printf(",\"db_min\":%d,\"db_max\":%d", min, max);
+        } else if (type == MIXER_CTL_TYPE_ENUM) {
+            printf(",\"enums\":[");
+            for (j = 0; j < num_enums; j++) {
+                if (j)
+                    putchar(',');
+                json_print_string(mixer_ctl_get_enum_string(ctl, j));
+            }
+            putchar(']');
+        }
+        printf("}\n");
+    }
+}
+
+/* print every control change as it happens, until killed */
+static void tinymix_monitor(struct mixer *mixer)
+{
+    struct mixer_event event;
+
+    if (mixer_subscribe_events(mixer, 1) < 0) {
+        fprintf(stderr, "Failed to subscribe to mixer events\n");
+        return;
+    }
+
+    while (mixer_wait_event(mixer, -1) >= 0) {
+        while (mixer_read_event(mixer, &event) > 0) {
+            if (event.mask & MIXER_EVENT_LOST) {
+                printf("events lost\n");
+            } else if (event.mask & MIXER_EVENT_REMOVE) {
+                printf("removed: %s\n", event.name);
+            } else if (!event.ctl) {
+                printf("added: %s\n", event.name);
+            } else if (event.mask & (MIXER_EVENT_VALUE | MIXER_EVENT_INFO)) {
+                printf("%s:", mixer_ctl_get_name(event.ctl));
+                tinymix_print_control(event.ctl, 0);
+            }
+        }
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "Failed to wait for mixer events\n");
+}
+
+static int tinymix_apply_scenario(struct mixer *mixer, const char *path)
+{
+    struct mixer_scenario_stats stats;
+    int ret;
+
+    ret = mixer_apply_scenario(mixer, path, &stats);
+    if (ret < 0) {
+        if (stats.line)
+            fprintf(stderr, "%s:%u: %s\n", path, stats.line,
+                    ret == -E2BIG ? "line too long" : "invalid control or value");
+        else if (stats.failed)
+            fprintf(stderr, "Error setting '%s', changes rolled back\n", stats.failed);
+        else
+            fprintf(stderr, "Failed to apply '%s': %s\n", path, strerror(-ret));
+        return ret;
+    }
+
+    printf("%u controls, %u writes, %u us\n", stats.controls, stats.writes,
+           stats.elapsed_us);
+    return 0;
+}
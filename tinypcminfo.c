@@ -31,16 +31,144 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "json.h"
+
+#define MAX_PCM_DEVICES 256
+
+/* ALSA format and access names, by SNDRV_PCM_FORMAT_* / SNDRV_PCM_ACCESS_* */
+static const char *format_names[] = {
+    "S8", "U8", "S16_LE", "S16_BE", "U16_LE", "U16_BE", "S24_LE", "S24_BE",
+    "U24_LE", "U24_BE", "S32_LE", "S32_BE", "U32_LE", "U32_BE", "FLOAT_LE",
+    "FLOAT_BE", "FLOAT64_LE", "FLOAT64_BE", "IEC958_SUBFRAME_LE",
+    "IEC958_SUBFRAME_BE", "MU_LAW", "A_LAW", "IMA_ADPCM", "MPEG", "GSM",
+    "S20_LE", "S20_BE", "U20_LE", "U20_BE", NULL, NULL, "SPECIAL", "S24_3LE",
+    "S24_3BE", "U24_3LE", "U24_3BE", "S20_3LE", "S20_3BE", "U20_3LE",
+    "U20_3BE", "S18_3LE", "S18_3BE", "U18_3LE", "U18_3BE", "G723_24",
+    "G723_24_1B", "G723_40", "G723_40_1B", "DSD_U8", "DSD_U16_LE",
+    "DSD_U32_LE", "DSD_U16_BE", "DSD_U32_BE",
+};
+
+static const char *access_names[] = {
+    "MMAP_INTERLEAVED", "MMAP_NONINTERLEAVED", "MMAP_COMPLEX",
+    "RW_INTERLEAVED", "RW_NONINTERLEAVED",
+};
+
+/* the intervals, as named in the JSON output */
+static const struct {
+    enum pcm_param param;
+    const char *name;
+} json_params[] = {
+    { PCM_PARAM_RATE, "rate" },
+    { PCM_PARAM_CHANNELS, "channels" },
+    { PCM_PARAM_SAMPLE_BITS, "sample_bits" },
+    { PCM_PARAM_FRAME_BITS, "frame_bits" },
+    { PCM_PARAM_PERIOD_TIME, "period_time" },
+    { PCM_PARAM_PERIOD_SIZE, "period_size" },
+    { PCM_PARAM_PERIOD_BYTES, "period_bytes" },
+    { PCM_PARAM_PERIODS, "periods" },
+    { PCM_PARAM_BUFFER_TIME, "buffer_time" },
+    { PCM_PARAM_BUFFER_SIZE, "buffer_size" },
+    { PCM_PARAM_BUFFER_BYTES, "buffer_bytes" },
+    { PCM_PARAM_TICK_TIME, "tick_time" },
+};
+
+static void print_json_mask(const char *key, struct pcm_mask *mask,
+                            const char **names, unsigned int num_names)
+{
+    unsigned int i, n = 0;
+
+    printf(",\"%s\":[", key);
+    for (i = 0; i < 8 * sizeof(mask->bits); i++) {
+        if (!(mask->bits[i / 32] & (1U << (i % 32))))
+            continue;
+        if (i < num_names && names[i])
+            printf("%s\"%s\"", n++ ? "," : "", names[i]);
+        else
+            printf("%s%u", n++ ? "," : "", i);
+    }
+    printf("]");
+}
+
+/* one line per device and direction, info is NULL unless enumerated */
+static void print_json(unsigned int card, unsigned int device, unsigned int flags,
+                       const struct pcm_device_info *info)
+{
+    struct pcm_params *params;
+    struct pcm_mask *mask;
+    unsigned int i;
+
+    printf("{\"card\":%u,\"device\":%u,\"stream\":\"%s\"", card, device,
+           flags & PCM_IN ? "capture" : "playback");
+    if (info) {
+        printf(",\"card_id\":");
+        json_print_string(info->card_id);
+        printf(",\"name\":");
+        json_print_string(info->name);
+    }
+
+    params = pcm_params_get(card, device, flags);
+    if (!params) {
+        printf(",\"error\":\"cannot open\"}\n");
+        return;
+    }
+
+    for (i = 0; i < sizeof(json_params) / sizeof(json_params[0]); i++)
+        printf(",\"%s\":{\"min\":%u,\"max\":%u}", json_params[i].name,
+               pcm_params_get_min(params, json_params[i].param),
+               pcm_params_get_max(params, json_params[i].param));
+
+    mask = pcm_params_get_mask(params, PCM_PARAM_FORMAT);
+    printf(",\"format_mask\":\"0x%08x%08x\"", mask->bits[1], mask->bits[0]);
+    print_json_mask("formats", mask, format_names,
+                    sizeof(format_names) / sizeof(format_names[0]));
+    print_json_mask("access", pcm_params_get_mask(params, PCM_PARAM_ACCESS),
+                    access_names, sizeof(access_names) / sizeof(access_names[0]));
+    printf("}\n");
+
+    pcm_params_free(params);
+}
+
+static void print_text(unsigned int card, unsigned int device, unsigned int flags)
+{
+    struct pcm_params *params;
+    unsigned int min;
+    unsigned int max;
+
+    printf("\nPCM %s:\n", flags & PCM_IN ? "in" : "out");
+
+    params = pcm_params_get(card, device, flags);
+    if (params == NULL) {
+        printf("Device does not exist.\n");
+        return;
+    }
+
+    min = pcm_params_get_min(params, PCM_PARAM_RATE);
+    max = pcm_params_get_max(params, PCM_PARAM_RATE);
+    printf("        Rate:\tmin=%uHz\tmax=%uHz\n", min, max);
+    min = pcm_params_get_min(params, PCM_PARAM_CHANNELS);
+    max = pcm_params_get_max(params, PCM_PARAM_CHANNELS);
+    printf("    Channels:\tmin=%u\t\tmax=%u\n", min, max);
+    min = pcm_params_get_min(params, PCM_PARAM_SAMPLE_BITS);
+    max = pcm_params_get_max(params, PCM_PARAM_SAMPLE_BITS);
+    printf(" Sample bits:\tmin=%u\t\tmax=%u\n", min, max);
+    min = pcm_params_get_min(params, PCM_PARAM_PERIOD_SIZE);
+    max = pcm_params_get_max(params, PCM_PARAM_PERIOD_SIZE);
+    printf(" Period size:\tmin=%u\t\tmax=%u\n", min, max);
+    min = pcm_params_get_min(params, PCM_PARAM_PERIODS);
+    max = pcm_params_get_max(params, PCM_PARAM_PERIODS);
+    printf("Period count:\tmin=%u\t\tmax=%u\n", min, max);
+
+    pcm_params_free(params);
+}
+
 int main(int argc, char **argv)
 {
     unsigned int device = 0;
     unsigned int card = 0;
-    int i;
-
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s -D card -d device\n", argv[0]);
-        return 1;
-    }
+    int have_device = 0;
+    int json = 0;
+    struct pcm_device_info devs[MAX_PCM_DEVICES];
+    int num_devs, i;
 
     /* parse command line arguments */
     argv += 1;
@@ -49,48 +177,45 @@ int main(int argc, char **argv)
             argv++;
             if (*argv)
                 card = atoi(*argv);
+            have_device = 1;
         }
         if (strcmp(*argv, "-d") == 0) {
             argv++;
             if (*argv)
                 device = atoi(*argv);
+            have_device = 1;
         }
+        if (strcmp(*argv, "-j") == 0)
+            json = 1;
         if (*argv)
             argv++;
     }
 
-    printf("Info for card %d, device %d:\n", card, device);
-
-    for (i = 0; i < 2; i++) {
-        struct pcm_params *params;
-        unsigned int min;
-        unsigned int max;
-
-        printf("\nPCM %s:\n", i == 0 ? "out" : "in");
+    if (have_device) {
+        if (json) {
+            print_json(card, device, PCM_OUT, NULL);
+            print_json(card, device, PCM_IN, NULL);
+        } else {
+            printf("Info for card %u, device %u:\n", card, device);
+            print_text(card, device, PCM_OUT);
+            print_text(card, device, PCM_IN);
+        }
+        return 0;
+    }
 
-        params = pcm_params_get(card, device, i == 0 ? PCM_OUT : PCM_IN);
-        if (params == NULL) {
-            printf("Device does not exist.\n");
+    /* without a device, every stream of every card */
+    num_devs = pcm_get_devices(devs, MAX_PCM_DEVICES);
+    if (num_devs > MAX_PCM_DEVICES)
+        num_devs = MAX_PCM_DEVICES;
+    for (i = 0; i < num_devs; i++) {
+        if (json) {
+            print_json(devs[i].card, devs[i].device, devs[i].flags, &devs[i]);
             continue;
         }
-
-        min = pcm_params_get_min(params, PCM_PARAM_RATE);
-        max = pcm_params_get_max(params, PCM_PARAM_RATE);
-        printf("        Rate:\tmin=%uHz\tmax=%uHz\n", min, max);
-        min = pcm_params_get_min(params, PCM_PARAM_CHANNELS);
-        max = pcm_params_get_max(params, PCM_PARAM_CHANNELS);
-        printf("    Channels:\tmin=%u\t\tmax=%u\n", min, max);
-        min = pcm_params_get_min(params, PCM_PARAM_SAMPLE_BITS);
-        max = pcm_params_get_max(params, PCM_PARAM_SAMPLE_BITS);
-        printf(" Sample bits:\tmin=%u\t\tmax=%u\n", min, max);
-        min = pcm_params_get_min(params, PCM_PARAM_PERIOD_SIZE);
-        max = pcm_params_get_max(params, PCM_PARAM_PERIOD_SIZE);
-        printf(" Period size:\tmin=%u\t\tmax=%u\n", min, max);
-        min = pcm_params_get_min(params, PCM_PARAM_PERIODS);
-        max = pcm_params_get_max(params, PCM_PARAM_PERIODS);
-        printf("Period count:\tmin=%u\t\tmax=%u\n", min, max);
-
-        pcm_params_free(params);
+        if (!i || devs[i].card != devs[i - 1].card || devs[i].device != devs[i - 1].device)
+            printf("%sInfo for card %u (%s), device %u (%s):\n", i ? "\n" : "",
+                   devs[i].card, devs[i].card_id, devs[i].device, devs[i].name);
+        print_text(devs[i].card, devs[i].device, devs[i].flags);
     }
 
     return 0;
@@ -27,6 +27,7 @@
 */
 
 #include "asoundlib.h"
+#include "convert.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -59,10 +60,12 @@ struct chunk_fmt {
 };
 
 static int close = 0;
+static int dump_stats = 0;
 
 void play_sample(FILE *file, unsigned int card, unsigned int device, unsigned int channels,
                  unsigned int rate, unsigned int bits, unsigned int period_size,
-                 unsigned int period_count);
+                 unsigned int period_count, unsigned int latency_ms, int gain,
+                 unsigned int fade_ms);
 
 void stream_close(int sig)
 {
@@ -71,6 +74,11 @@ void stream_close(int sig)
     close = 1;
 }
 
+void stream_dump_stats(int sig)
+{
+    dump_stats = 1;
+}
+
 int main(int argc, char **argv)
 {
     FILE *file;
@@ -81,12 +89,15 @@ int main(int argc, char **argv)
     unsigned int card = 0;
     unsigned int period_size = 1024;
     unsigned int period_count = 4;
+    unsigned int latency_ms = 0;
+    int gain = 0;
+    unsigned int fade_ms = 0;
     char *filename;
     int more_chunks = 1;
 
     if (argc < 2) {
         fprintf(stderr, "Usage: %s file.wav [-D card] [-d device] [-p period_size]"
-                " [-n n_periods] \n", argv[0]);
+                " [-n n_periods] [-l latency_ms] [-g gain_dB] [-f fade_ms]\n", argv[0]);
         return 1;
     }
 
@@ -148,124 +159,181 @@ int main(int argc, char **argv)
             if (*argv)
                 card = atoi(*argv);
         }
+        if (strcmp(*argv, "-l") == 0) {
+            argv++;
+            if (*argv)
+                latency_ms = atoi(*argv);
+        }
+        if (strcmp(*argv, "-g") == 0) {
+            argv++;
+            if (*argv)
+                gain = (int)(atof(*argv) * 100 - 0.5);
+        }
+        if (strcmp(*argv, "-f") == 0) {
+            argv++;
+            if (*argv)
+                fade_ms = atoi(*argv);
+        }
         if (*argv)
             argv++;
     }
 
     play_sample(file, card, device, chunk_fmt.num_channels, chunk_fmt.sample_rate,
-                chunk_fmt.bits_per_sample, period_size, period_count);
+                chunk_fmt.bits_per_sample, period_size, period_count, latency_ms, gain,
+                fade_ms);
 
     fclose(file);
 
     return 0;
 }
 
-int check_param(struct pcm_params *params, unsigned int param, unsigned int value,
-                 char *param_name, char *param_unit)
+static enum convert_format convert_format_of(enum pcm_format format)
 {
-    unsigned int min;
-    unsigned int max;
-    int is_within_bounds = 1;
-
-    min = pcm_params_get_min(params, param);
-    if (value < min) {
-        fprintf(stderr, "%s is %u%s, device only supports >= %u%s\n", param_name, value,
-                param_unit, min, param_unit);
-        is_within_bounds = 0;
-    }
-
-    max = pcm_params_get_max(params, param);
-    if (value > max) {
-        fprintf(stderr, "%s is %u%s, device only supports <= %u%s\n", param_name, value,
-                param_unit, max, param_unit);
-        is_within_bounds = 0;
+    switch (format) {
+    case PCM_FORMAT_S32_LE:
+        return CONVERT_S32;
+    case PCM_FORMAT_S24_LE:
+        return CONVERT_S24;
+    default:
+        return CONVERT_S16;
     }
-
-    return is_within_bounds;
-}
-
-int sample_is_playable(unsigned int card, unsigned int device, unsigned int channels,
-                        unsigned int rate, unsigned int bits, unsigned int period_size,
-                        unsigned int period_count)
-{
-    struct pcm_params *params;
-    int can_play;
-
-    params = pcm_params_get(card, device, PCM_OUT);
-    if (params == NULL) {
-        fprintf(stderr, "Unable to open PCM device %u.\n", device);
-        return 0;
-    }
-
-    can_play = check_param(params, PCM_PARAM_RATE, rate, "Sample rate", "Hz");
-    can_play &= check_param(params, PCM_PARAM_CHANNELS, channels, "Sample", " channels");
-    can_play &= check_param(params, PCM_PARAM_SAMPLE_BITS, bits, "Bitrate", " bits");
-    can_play &= check_param(params, PCM_PARAM_PERIOD_SIZE, period_size, "Period size", "Hz");
-    can_play &= check_param(params, PCM_PARAM_PERIODS, period_count, "Period count", "Hz");
-
-    pcm_params_free(params);
-
-    return can_play;
 }
 
 void play_sample(FILE *file, unsigned int card, unsigned int device, unsigned int channels,
                  unsigned int rate, unsigned int bits, unsigned int period_size,
-                 unsigned int period_count)
+                 unsigned int period_count, unsigned int latency_ms, int gain,
+                 unsigned int fade_ms)
 {
     struct pcm_config config;
     struct pcm *pcm;
+    struct convert_side in, out;
+    struct convert *cv = NULL;
     char *buffer;
+    char *out_buffer = NULL;
+    unsigned int in_frames, frames;
+    unsigned int fade_frames;
     int size;
     int num_read;
+    int fading = 0;
+
+    in.channels = channels;
+    in.rate = rate;
+    if (bits == 32) {
+        in.format = CONVERT_S32;
+        config.format = PCM_FORMAT_S32_LE;
+    } else if (bits == 24) {
+        in.format = CONVERT_S24_PACKED;
+        config.format = PCM_FORMAT_S24_LE;
+    } else if (bits == 16) {
+        in.format = CONVERT_S16;
+        config.format = PCM_FORMAT_S16_LE;
+    } else {
+        fprintf(stderr, "Unsupported sample size %u bits\n", bits);
+        return;
+    }
 
     config.channels = channels;
     config.rate = rate;
     config.period_size = period_size;
     config.period_count = period_count;
-    if (bits == 32)
-        config.format = PCM_FORMAT_S32_LE;
-    else if (bits == 16)
-        config.format = PCM_FORMAT_S16_LE;
     config.start_threshold = 0;
     config.stop_threshold = 0;
     config.silence_threshold = 0;
 
-    if (!sample_is_playable(card, device, channels, rate, bits, period_size, period_count)) {
+    /* settle for the nearest the device does and convert to it */
+    if (pcm_negotiate_config(card, device, PCM_OUT, &config, latency_ms, NULL) < 0) {
+        fprintf(stderr, "Unable to find a configuration for PCM device %u\n", device);
         return;
     }
 
-    pcm = pcm_open(card, device, PCM_OUT, &config);
+    out.format = convert_format_of(config.format);
+    out.channels = config.channels;
+    out.rate = config.rate;
+    if (in.format != out.format || in.channels != out.channels || in.rate != out.rate) {
+        cv = convert_init(&in, &out);
+        if (!cv) {
+            fprintf(stderr, "Unable to convert to %u ch, %u hz\n", out.channels, out.rate);
+            return;
+        }
+    }
+
+    pcm = pcm_open(card, device, PCM_OUT | PCM_STATS, &config);
     if (!pcm || !pcm_is_ready(pcm)) {
         fprintf(stderr, "Unable to open PCM device %u (%s)\n",
                 device, pcm_get_error(pcm));
+        convert_free(cv);
         return;
     }
 
-    size = pcm_frames_to_bytes(pcm, pcm_get_buffer_size(pcm));
+    /* a buffer's worth of output per write */
+    in_frames = pcm_get_buffer_size(pcm);
+    if (cv) {
+        in_frames = (unsigned long long)in_frames * in.rate / out.rate;
+        if (!in_frames)
+            in_frames = 1;
+        out_buffer = malloc(convert_max_out_frames(cv, in_frames) * convert_frame_bytes(&out));
+    }
+    size = in_frames * convert_frame_bytes(&in);
     buffer = malloc(size);
-    if (!buffer) {
+    if (!buffer || (cv && !out_buffer)) {
         fprintf(stderr, "Unable to allocate %d bytes\n", size);
-        free(buffer);
-        pcm_close(pcm);
-        return;
+        goto done;
+    }
+
+    /* fade in from silence to the gain */
+    fade_frames = (unsigned long long)fade_ms * config.rate / 1000;
+    if ((gain || fade_frames) &&
+        (pcm_set_mute(pcm, fade_frames != 0, 0) ||
+         pcm_set_gain(pcm, gain > 0 ? 0 : gain, 0, PCM_RAMP_EXPONENTIAL) ||
+         pcm_set_mute(pcm, 0, fade_frames))) {
+        fprintf(stderr, "Software gain is not supported for %u bit samples\n", bits);
+        goto done;
     }
 
     printf("Playing sample: %u ch, %u hz, %u bit\n", channels, rate, bits);
+    if (cv)
+        printf("Converting to: %u ch, %u hz, %u bit\n", config.channels, config.rate,
+               config.format == PCM_FORMAT_S16_LE ? 16 :
+               config.format == PCM_FORMAT_S24_LE ? 24 : 32);
+    if (latency_ms)
+        printf("Latency: %u ms (%u periods of %u frames)\n",
+               config.period_size * config.period_count * 1000 / config.rate,
+               config.period_count, config.period_size);
 
     /* catch ctrl-c to shutdown cleanly */
     signal(SIGINT, stream_close);
+    /* and SIGUSR1 to print the stream statistics */
+    signal(SIGUSR1, stream_dump_stats);
 
     do {
         num_read = fread(buffer, 1, size, file);
         if (num_read > 0) {
-            if (pcm_write(pcm, buffer, num_read)) {
+            if (cv) {
+                frames = convert_process(cv, buffer, num_read / convert_frame_bytes(&in),
+                                         out_buffer);
+                num_read = frames * convert_frame_bytes(&out);
+            }
+            if (num_read > 0 && pcm_write(pcm, cv ? out_buffer : buffer, num_read)) {
                 fprintf(stderr, "Error playing sample\n");
                 break;
             }
         }
-    } while (!close && num_read > 0);
 
+        if (dump_stats) {
+            dump_stats = 0;
+            pcm_dump_stats(pcm, fileno(stderr));
+        }
+
+        /* on ctrl-c, fade out before stopping */
+        if (close && fade_frames && !fading) {
+            pcm_set_mute(pcm, 1, fade_frames);
+            fading = 1;
+        }
+    } while ((!close || (fading && pcm_get_ramp_frames(pcm))) && num_read > 0);
+
+done:
     free(buffer);
+    free(out_buffer);
+    convert_free(cv);
     pcm_close(pcm);
 }
-
@@ -0,0 +1,66 @@
+/* trace.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Static probes in the capture and playback paths, for perf, bpftrace or
+ * SystemTap to attach to. They are compiled out unless built with
+ * -DTINYALSA_TRACE, which needs <sys/sdt.h> (systemtap-sdt-dev); a probe
+ * nobody is attached to then costs a nop.
+ *
+ * Provider tinyalsa:
+ *   pcm_read_entry, pcm_write_entry     (pcm, frames)
+ *   pcm_read_exit, pcm_write_exit       (pcm, result)
+ *   pcm_xrun                            (pcm)
+ *   pcm_xrun_recovered                  (pcm)
+ *   pcm_mmap_begin, pcm_mmap_commit     (pcm, offset, frames)
+ *   vad_start, vad_stop                 (segment)
+ *   segment_open                        (segment)
+ *   segment_close                       (segment, frames, kept)
+ *
+ * scripts/trace_timeline.py turns a perf recording of them into a per
+ * period timeline.
+ */
+
+#ifdef TINYALSA_TRACE
+#include <sys/sdt.h>
+
+#define TRACE_PROBE(name)                   STAP_PROBE(tinyalsa, name)
+#define TRACE_PROBE1(name, a)               STAP_PROBE1(tinyalsa, name, a)
+#define TRACE_PROBE2(name, a, b)            STAP_PROBE2(tinyalsa, name, a, b)
+#define TRACE_PROBE3(name, a, b, c)         STAP_PROBE3(tinyalsa, name, a, b, c)
+#else
+#define TRACE_PROBE(name)                   do { } while (0)
+#define TRACE_PROBE1(name, a)               do { } while (0)
+#define TRACE_PROBE2(name, a, b)            do { } while (0)
+#define TRACE_PROBE3(name, a, b, c)         do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+/* wav.h
+**
+** Copyright 2011, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of The Android Open Source Project nor the names of
+**       its contributors may be used to endorse or promote products derived
+**       from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY The Android Open Source Project ``AS IS'' AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL The Android Open Source Project BE LIABLE
+** FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+** DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+** SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+** CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+** OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+** DAMAGE.
+*/
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The canonical 44 byte RIFF/WAVE header of the files tinycap and the
+ * recorders write: a fmt chunk followed directly by the data chunk.
+ */
+
+#define ID_RIFF 0x46464952
+#define ID_WAVE 0x45564157
+#define ID_FMT  0x20746d66
+#define ID_DATA 0x61746164
+#define ID_RF64 0x34364652
+#define ID_DS64 0x34367364
+#define ID_JUNK 0x4b4e554a
+
+#define FORMAT_PCM 1
+
+struct wav_header {
+    uint32_t riff_id;
+    uint32_t riff_sz;
+    uint32_t riff_fmt;
+    uint32_t fmt_id;
+    uint32_t fmt_sz;
+    uint16_t audio_format;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint32_t data_id;
+    uint32_t data_sz;
+};
+
+static inline void wav_header_init(struct wav_header *header, unsigned int channels,
+                                   unsigned int rate, unsigned int bits)
+{
+    header->riff_id = ID_RIFF;
+    header->riff_sz = 0;
+    header->riff_fmt = ID_WAVE;
+    header->fmt_id = ID_FMT;
+    header->fmt_sz = 16;
+    header->audio_format = FORMAT_PCM;
+    header->num_channels = channels;
+    header->sample_rate = rate;
+    header->bits_per_sample = bits;
+    header->byte_rate = (bits / 8) * channels * rate;
+    header->block_align = channels * (bits / 8);
+    header->data_id = ID_DATA;
+    header->data_sz = 0;
+}
+
+/* Fill in the sizes once the number of frames is known */
+static inline void wav_header_set_frames(struct wav_header *header, unsigned int frames)
+{
+    header->data_sz = frames * header->block_align;
+    header->riff_sz = header->data_sz + sizeof(struct wav_header) - 8;
+}
+
+/*
+ * Header of files that may outgrow the 32 bit sizes (EBU Tech 3306): a WAV
+ * with a JUNK chunk the size of a ds64 chunk ahead of fmt. Up to 4 GB it is
+ * a plain RIFF file; past that the JUNK becomes ds64 carrying the 64 bit
+ * sizes and the file turns into RF64, without moving any data.
+ */
+struct wav_rf64_header {
+    uint32_t riff_id;
+    uint32_t riff_sz;
+    uint32_t riff_fmt;
+    uint32_t ds64_id;
+    uint32_t ds64_sz;
+    uint32_t riff_sz_lo;
+    uint32_t riff_sz_hi;
+    uint32_t data_sz_lo;
+    uint32_t data_sz_hi;
+    uint32_t sample_count_lo;
+    uint32_t sample_count_hi;
+    uint32_t table_length;
+    uint32_t fmt_id;
+    uint32_t fmt_sz;
+    uint16_t audio_format;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint32_t data_id;
+    uint32_t data_sz;
+};
+
+static inline void wav_rf64_init(struct wav_rf64_header *header, unsigned int channels,
+                                 unsigned int rate, unsigned int bits)
+{
+    memset(header, 0, sizeof(*header));
+    header->riff_fmt = ID_WAVE;
+    header->ds64_sz = 28;
+    header->fmt_id = ID_FMT;
+    header->fmt_sz = 16;
+    header->audio_format = FORMAT_PCM;
+    header->num_channels = channels;
+    header->sample_rate = rate;
+    header->bits_per_sample = bits;
+    header->byte_rate = (bits / 8) * channels * rate;
+    header->block_align = channels * (bits / 8);
+    header->data_id = ID_DATA;
+}
+
+static inline void wav_rf64_set_frames(struct wav_rf64_header *header, uint64_t frames)
+{
+    uint64_t data_sz = frames * header->block_align;
+    uint64_t riff_sz = data_sz + sizeof(struct wav_rf64_header) - 8;
+
+    header->riff_sz_lo = (uint32_t)riff_sz;
+    header->riff_sz_hi = (uint32_t)(riff_sz >> 32);
+    header->data_sz_lo = (uint32_t)data_sz;
+    header->data_sz_hi = (uint32_t)(data_sz >> 32);
+    header->sample_count_lo = (uint32_t)frames;
+    header->sample_count_hi = (uint32_t)(frames >> 32);
+
+    if (riff_sz > 0xffffffff) {
+        header->riff_id = ID_RF64;
+        header->ds64_id = ID_DS64;
+        header->riff_sz = 0xffffffff;
+        header->data_sz = 0xffffffff;
+    } else {
+        header->riff_id = ID_RIFF;
+        header->ds64_id = ID_JUNK;
+        header->riff_sz = (uint32_t)riff_sz;
+        header->data_sz = (uint32_t)data_sz;
+    }
+}
+
+#endif